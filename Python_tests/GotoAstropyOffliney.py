@@ -121,6 +121,9 @@ def track_object(target_object):
     global LastAzimuth
     global CurrentAzimuth
 
+    # The firmware tracks on its own (START_TRACKING), the host only re-syncs
+    # (SET_TRACK_SYNC) now and then for the drift of planets and the moon
+    arduino.write(str.encode("63," + str(loc.lat.degree) + ";"))
     print ('Press Backspace to exit')
     while not keyboard.is_pressed('backspace'):
         
@@ -130,17 +133,11 @@ def track_object(target_object):
         
         LastAzimuth = coords[1]+OffsettAzimuth
         CurrentAzimuth = LastAzimuth
-        go_to(LastAltitude, LastAzimuth)
+        arduino.write(str.encode("65," + str(LastAltitude) + "," + str(LastAzimuth) + ";"))
         
-         #for seconds in range(60):
-        for secs in range(0,10):
-            time.sleep(1)
-            print('.')
-            if keyboard.is_pressed('backspace'):
-                print ('backspace detected. Exiting tracking...')
-            #arduino.write(str.encode("42;"))
-                break
-                return
+        if DelayAndCheckForBackspace(60):
+            break
+    arduino.write(str.encode("64;"))
 
 def BuildScanArray(MatrixSize, step_size):
     #Elevation 
@@ -0,0 +1,107 @@
+/***********************************************************************************************//**
+ * @file       EventDispatcher.cpp
+ * @details    See EventDispatcher.h
+ * @author      Miguel Silguero
+ * @copyright  Copyright (c) 2024-2025, Horizonless Embedded Solutions LLC
+ * @date       10.17.2026 (created)
+ *
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+#include "EventDispatcher.h"
+
+/***************************************************************************************************
+ * FUNCTION DEFINITIONS
+ **************************************************************************************************/
+
+EventDispatcher::EventDispatcher()
+{
+    pending_ = 0;
+    handlerCount_ = 0;
+    sourceCount_ = 0;
+}
+
+bool EventDispatcher::on(eventMask events, Handler handler)
+{
+    if (handlerCount_ == EVENT_MAX_HANDLERS)
+    {
+        return false;
+    }
+    handlers_[handlerCount_].events = events;
+    handlers_[handlerCount_].handler = handler;
+    handlerCount_++;
+    return true;
+}
+
+bool EventDispatcher::source(eventMask events, Probe probe)
+{
+    if (sourceCount_ == EVENT_MAX_SOURCES)
+    {
+        return false;
+    }
+    sources_[sourceCount_].events = events;
+    sources_[sourceCount_].probe = probe;
+    sourceCount_++;
+    return true;
+}
+
+/***********************************************************************************************//**
+ * @details     Takes every pending event in one go, so what the handlers post waits for the next
+ *              pass and cannot starve the others.
+ **************************************************************************************************/
+eventMask EventDispatcher::dispatch()
+{
+    pollSources();
+
+    noInterrupts();
+    eventMask events = pending_;
+    pending_ = 0;
+    interrupts();
+
+    for (uint8_t index = 0; index < handlerCount_; index++)
+    {
+        if (handlers_[index].events & events)
+        {
+            handlers_[index].handler();
+        }
+    }
+    return events;
+}
+
+/***********************************************************************************************//**
+ * @details     Tests the sources and goes to sleep with interrupts off. WFI still wakes on an
+ *              interrupt that is pending, which then runs once interrupts are back on, so an
+ *              event that comes in after the test is not slept through. Without WFI (native
+ *              build) it only tests the sources.
+ **************************************************************************************************/
+bool EventDispatcher::idle()
+{
+    bool slept = false;
+
+    noInterrupts();
+    pollSources();
+    if (pending_ == 0)
+    {
+#if defined(ARDUINO_ARCH_SAM)
+        __DSB();
+        __WFI();
+        slept = true;
+#endif
+    }
+    interrupts();
+
+    return slept;
+}
+
+void EventDispatcher::pollSources()
+{
+    for (uint8_t index = 0; index < sourceCount_; index++)
+    {
+        if (sources_[index].probe())
+        {
+            pending_ |= sources_[index].events;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+/***********************************************************************************************//**
+ * @file       EventDispatcher.h
+ * @details    Event flags for an event driven main loop. Interrupts post events, the main loop
+ *             takes them all at once and runs only the handlers of the events that fired, in the
+ *             order they were registered. With nothing pending it sleeps in WFI until the next
+ *             interrupt; SysTick still wakes it every ms.
+ *
+ *             What has no interrupt of its own to post from (the core's serial ports, the
+ *             scheduler's deadlines) is a source: a probe tested on every pass and before going to
+ *             sleep, with interrupts off, so an event cannot slip in between the test and WFI. A
+ *             handler that has work left posts its own event again and keeps the loop awake.
+ * @author      Miguel Silguero
+ * @copyright  Copyright (c) 2024-2025, Horizonless Embedded Solutions LLC
+ * @date       10.17.2026 (created)
+ *
+ **************************************************************************************************/
+#ifndef EVENT_DISPATCHER_H
+#define EVENT_DISPATCHER_H
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+#include "Arduino.h"
+
+/***************************************************************************************************
+ * CONSTANTS AND DEFINITIONS
+ **************************************************************************************************/
+#define EVENT_MAX_HANDLERS  (8)
+#define EVENT_MAX_SOURCES   (8)
+
+/***************************************************************************************************
+ * TYPEDEFS
+ **************************************************************************************************/
+typedef uint32_t eventMask;     /* one bit per event, the application names them */
+
+/***************************************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES
+ **************************************************************************************************/
+
+class EventDispatcher
+{
+    public:
+        using Handler = void (*)();
+        using Probe = bool (*)();
+
+        EventDispatcher();
+
+        bool on(eventMask events, Handler handler);     /* handler runs when any of events fired, false when full */
+        bool source(eventMask events, Probe probe);     /* events are posted while probe returns true, false when full */
+
+        /* Safe from interrupts and from handlers, a handler's post runs on the next pass */
+        inline void post(eventMask events)
+        {
+#if defined(ARDUINO_ARCH_SAM)
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            pending_ |= events;
+            __set_PRIMASK(primask);
+#else
+            pending_ |= events;
+#endif
+        }
+
+        eventMask dispatch();   /* runs the handlers of the pending events, returns the events taken */
+        bool idle();            /* sleeps until an interrupt if nothing is pending, true if it slept */
+
+    private:
+        struct HandlerEntry {
+            eventMask events;
+            Handler handler;
+        };
+        struct SourceEntry {
+            eventMask events;
+            Probe probe;
+        };
+
+        volatile eventMask pending_;
+        HandlerEntry handlers_[EVENT_MAX_HANDLERS];
+        SourceEntry sources_[EVENT_MAX_SOURCES];
+        uint8_t handlerCount_;
+        uint8_t sourceCount_;
+
+        void pollSources();
+};
+
+#endif
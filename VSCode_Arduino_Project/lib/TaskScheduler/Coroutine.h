@@ -0,0 +1,98 @@
+/***********************************************************************************************//**
+ * @file       Coroutine.h
+ * @details    Stackless coroutines (protothreads) run by TaskScheduler. A long command is written
+ *             as straight code in resume() that awaits a time or a condition instead of blocking
+ *             on it; every await returns to the main loop, which goes on serving USB, BLE and the
+ *             other tasks until the scheduler resumes the coroutine where it left off.
+ *
+ *             resume() runs between CO_BEGIN() and CO_END(), the awaits are macros that return to
+ *             the scheduler. Being stackless, locals do not survive an await: what has to is kept
+ *             in members of the derived class, and the awaits cannot sit inside a switch of its
+ *             own. Start one with TaskScheduler::start().
+ *
+ *             class Blink : public Coroutine
+ *             {
+ *                 uint8_t i_;
+ *                 unsigned long resume()
+ *                 {
+ *                     CO_BEGIN();
+ *                     for (i_ = 0; i_ < 3; i_++)
+ *                     {
+ *                         toggle();
+ *                         CO_SLEEP(500);
+ *                     }
+ *                     CO_END();
+ *                 }
+ *             };
+ * @author      Miguel Silguero
+ * @copyright  Copyright (c) 2024-2025, Horizonless Embedded Solutions LLC
+ * @date       10.17.2026 (created)
+ *
+ **************************************************************************************************/
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+#include "Arduino.h"
+
+/***************************************************************************************************
+ * CONSTANTS AND DEFINITIONS
+ **************************************************************************************************/
+#define CO_DONE         (0xFFFFFFFFUL)  /* resume() return, the coroutine ended */
+#define CO_POLL_MS      (1)             /* CO_AWAIT tests its condition once per ms */
+
+/* Marks the fall into the case label of an await as meant for -Wimplicit-fallthrough, a
+   fall through comment does not survive the macro expansion. Empty where unsupported. */
+#if defined(__has_attribute)
+#if __has_attribute(fallthrough)
+#define CO_FALLTHROUGH  __attribute__((fallthrough))
+#endif
+#endif
+#ifndef CO_FALLTHROUGH
+#define CO_FALLTHROUGH
+#endif
+
+/* Opens and closes the body of resume() */
+#define CO_BEGIN()      switch (line_) { case 0:
+#define CO_END()        } line_ = 0; return CO_DONE
+
+/* Resumes after ms, at least one scheduler pass later */
+#define CO_SLEEP(ms)    do { line_ = __LINE__; return ((ms) != 0) ? (ms) : 1; CO_FALLTHROUGH; case __LINE__:; } while (0)
+
+/* Gives the loop one pass */
+#define CO_YIELD()      CO_SLEEP(1)
+
+/* Resumes once cond holds, tested now and then every CO_POLL_MS */
+#define CO_AWAIT(cond)  do { line_ = __LINE__; CO_FALLTHROUGH; case __LINE__: if (!(cond)) return CO_POLL_MS; } while (0)
+
+/* CO_AWAIT that gives up ms after it started waiting, the member deadline_ keeps the time */
+#define CO_AWAIT_FOR(cond, ms) do { deadline_ = millis() + (ms); line_ = __LINE__; CO_FALLTHROUGH; case __LINE__: \
+                                    if (!(cond) && ((long)(millis() - deadline_) < 0)) return CO_POLL_MS; } while (0)
+
+/* Ends the coroutine early */
+#define CO_EXIT()       do { line_ = 0; return CO_DONE; } while (0)
+
+/***************************************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES
+ **************************************************************************************************/
+
+class Coroutine
+{
+    public:
+        Coroutine() : line_(0), deadline_(0) {}
+        virtual ~Coroutine() {}
+
+        /* Runs up to the next await. Returns the ms until it wants to go on, CO_DONE at the end. */
+        virtual unsigned long resume() = 0;
+
+        /* The next resume() starts from CO_BEGIN() */
+        void restart() { line_ = 0; }
+
+    protected:
+        uint16_t line_;                 /* where resume() goes on, 0 at the start */
+        unsigned long deadline_;        /* of CO_AWAIT_FOR */
+};
+
+#endif
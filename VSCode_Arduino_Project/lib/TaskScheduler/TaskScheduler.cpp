@@ -0,0 +1,340 @@
+/***********************************************************************************************//**
+ * @file       TaskScheduler.cpp
+ * @details    See TaskScheduler.h
+ * @author      Miguel Silguero
+ * @copyright  Copyright (c) 2024-2025, Horizonless Embedded Solutions LLC
+ * @date       10.17.2026 (created)
+ *
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+#include "TaskScheduler.h"
+
+/***************************************************************************************************
+ * FUNCTION DEFINITIONS
+ **************************************************************************************************/
+
+TaskScheduler::TaskScheduler()
+{
+    count_ = 0;
+    next_ = 0;
+    for (uint8_t slot = 0; slot < SCHEDULER_MAX_TASKS; slot++)
+    {
+        tasks_[slot].callback = nullptr;
+        tasks_[slot].coroutine = nullptr;
+        tasks_[slot].generation = 1;
+        position_[slot] = SCHEDULER_MAX_TASKS;
+    }
+}
+
+taskHandle TaskScheduler::once(Callback callback, unsigned long timeout)
+{
+    return addTask(callback, timeout, 0, TASK_SKIP);
+}
+
+taskHandle TaskScheduler::repeat(Callback callback, unsigned long interval, taskPolicy policy)
+{
+    return addTask(callback, interval, interval, policy);
+}
+
+/***********************************************************************************************//**
+ * @details     Puts the coroutine in a slot of its own, due at once. A coroutine that is running
+ *              already starts over from CO_BEGIN() in the slot it has.
+ **************************************************************************************************/
+taskHandle TaskScheduler::start(Coroutine & coroutine)
+{
+    coroutine.restart();
+
+    for (uint8_t index = 0; index < count_; index++)
+    {
+        uint8_t slot = heap_[index];
+        if (tasks_[slot].coroutine == &coroutine)
+        {
+            tasks_[slot].deadline = millis();
+            siftDown(index);
+            siftUp(position_[slot]);
+            next_ = tasks_[heap_[0]].deadline;
+            return ((taskHandle)tasks_[slot].generation << 8) | slot;
+        }
+    }
+
+    taskHandle handle = addTask(nullptr, 0, 0, TASK_SKIP);
+    if (handle != TASK_NONE)
+    {
+        tasks_[handle & 0xFF].coroutine = &coroutine;
+    }
+    return handle;
+}
+
+/***********************************************************************************************//**
+ * @details     Takes a free slot and puts it into the heap. TASK_NONE when all slots are taken.
+ **************************************************************************************************/
+taskHandle TaskScheduler::addTask(Callback callback, unsigned long delay, unsigned long interval, taskPolicy policy)
+{
+    uint8_t slot = 0;
+
+    while ((slot < SCHEDULER_MAX_TASKS) && (position_[slot] != SCHEDULER_MAX_TASKS))
+    {
+        slot++;
+    }
+    if (slot == SCHEDULER_MAX_TASKS)
+    {
+        return TASK_NONE;
+    }
+
+    tasks_[slot].callback = callback;
+    tasks_[slot].coroutine = nullptr;
+    tasks_[slot].deadline = millis() + delay;
+    tasks_[slot].policy = policy;
+    tasks_[slot].stats = {};
+    tasks_[slot].stats.interval = interval;
+
+    place(count_, slot);
+    count_++;
+    siftUp(count_ - 1);
+    next_ = tasks_[heap_[0]].deadline;
+
+    return ((taskHandle)tasks_[slot].generation << 8) | slot;
+}
+
+bool TaskScheduler::cancel(taskHandle handle)
+{
+    int8_t slot = slotOf(handle);
+
+    if (slot < 0)
+    {
+        return false;
+    }
+    removeAt(position_[slot]);
+    return true;
+}
+
+bool TaskScheduler::isScheduled(taskHandle handle)
+{
+    return slotOf(handle) >= 0;
+}
+
+void TaskScheduler::clearAllTasks()
+{
+    while (count_ != 0)
+    {
+        removeAt(count_ - 1);
+    }
+}
+
+unsigned long TaskScheduler::nextDeadline() const
+{
+    return next_;
+}
+
+uint8_t TaskScheduler::count() const
+{
+    return count_;
+}
+
+const taskStats * TaskScheduler::statsAt(uint8_t slot) const
+{
+    if ((slot >= SCHEDULER_MAX_TASKS) || (position_[slot] == SCHEDULER_MAX_TASKS))
+    {
+        return nullptr;
+    }
+    return &tasks_[slot].stats;
+}
+
+void TaskScheduler::resetStats()
+{
+    for (uint8_t slot = 0; slot < SCHEDULER_MAX_TASKS; slot++)
+    {
+        unsigned long interval = tasks_[slot].stats.interval;
+        tasks_[slot].stats = {};
+        tasks_[slot].stats.interval = interval;
+    }
+}
+
+/***********************************************************************************************//**
+ * @details     Slot of a live handle, -1 if the handle is stale or TASK_NONE.
+ **************************************************************************************************/
+int8_t TaskScheduler::slotOf(taskHandle handle)
+{
+    uint8_t slot = handle & 0xFF;
+
+    if ((slot >= SCHEDULER_MAX_TASKS) || (position_[slot] == SCHEDULER_MAX_TASKS) ||
+        (tasks_[slot].generation != (handle >> 8)))
+    {
+        return -1;
+    }
+    return slot;
+}
+
+/***********************************************************************************************//**
+ * @details     Runs the tasks that are due, each at most once per call so a task with a 0 interval
+ *              cannot hold the loop. The heap is updated before the callback runs, which may then
+ *              add or cancel tasks, itself included.
+ **************************************************************************************************/
+void TaskScheduler::runDue()
+{
+    unsigned long now = millis();
+    uint8_t budget = count_;
+
+    while ((count_ != 0) && (budget != 0) && ((long)(now - tasks_[heap_[0]].deadline) >= 0))
+    {
+        uint8_t slot = heap_[0];
+        Callback callback = tasks_[slot].callback;
+
+        if (tasks_[slot].coroutine != nullptr)
+        {
+            resumeAt(slot, now);
+            budget--;
+            continue;
+        }
+
+        account(tasks_[slot], now);
+
+        if (tasks_[slot].stats.interval != 0)
+        {
+            siftDown(0);
+        }
+        else
+        {
+            removeAt(0);
+        }
+        next_ = (count_ != 0) ? tasks_[heap_[0]].deadline : next_;
+        budget--;
+
+        callback();
+    }
+}
+
+/***********************************************************************************************//**
+ * @details     Resumes the coroutine in slot and puts it back in the heap for the time it awaits
+ *              now, or frees the slot once it ended. It stays at the root while it runs, but what
+ *              it starts or cancels may move it or end it.
+ **************************************************************************************************/
+void TaskScheduler::resumeAt(uint8_t slot, unsigned long now)
+{
+    Task & task = tasks_[slot];
+    uint8_t generation = task.generation;
+
+    account(task, now);
+    unsigned long wait = task.coroutine->resume();
+
+    if ((position_[slot] == SCHEDULER_MAX_TASKS) || (task.generation != generation))
+    {
+        return;
+    }
+    if (wait == CO_DONE)
+    {
+        removeAt(position_[slot]);
+        return;
+    }
+    task.deadline = now + wait;
+    siftDown(position_[slot]);
+    siftUp(position_[slot]);
+    next_ = tasks_[heap_[0]].deadline;
+}
+
+/***********************************************************************************************//**
+ * @details     Books how late the task runs and moves a repeating one to its next deadline, one
+ *              interval after the one it runs for. Periods that are already over too are dropped
+ *              (TASK_SKIP) or run on the next passes (TASK_CATCH_UP), but never more than
+ *              SCHEDULER_MAX_BACKLOG of them: after a long block the loop would only be replaying
+ *              stale work.
+ **************************************************************************************************/
+void TaskScheduler::account(Task & task, unsigned long now)
+{
+    unsigned long late = now - task.deadline;
+    unsigned long interval = task.stats.interval;
+
+    task.stats.lateMin = ((task.stats.runs == 0) || (late < task.stats.lateMin)) ? late : task.stats.lateMin;
+    task.stats.lateMax = (late > task.stats.lateMax) ? late : task.stats.lateMax;
+    task.stats.lateTotal += late;
+    task.stats.runs++;
+
+    if (interval == 0)
+    {
+        return;
+    }
+
+    unsigned long missed = late / interval;     /* periods over besides the one that runs now */
+    unsigned long keep = (task.policy == TASK_CATCH_UP) ? min(missed, (unsigned long)SCHEDULER_MAX_BACKLOG) : 0;
+
+    task.stats.skipped += missed - keep;
+    task.deadline += (missed - keep + 1) * interval;
+}
+
+/***********************************************************************************************//**
+ * @details     Takes the task at heap index out and frees its slot, the last task fills the hole.
+ **************************************************************************************************/
+void TaskScheduler::removeAt(uint8_t index)
+{
+    uint8_t slot = heap_[index];
+
+    tasks_[slot].generation = (tasks_[slot].generation == 0xFF) ? 1 : tasks_[slot].generation + 1;
+    position_[slot] = SCHEDULER_MAX_TASKS;
+    count_--;
+
+    if (index != count_)
+    {
+        place(index, heap_[count_]);
+        siftDown(index);
+        siftUp(index);
+    }
+    if (count_ != 0)
+    {
+        next_ = tasks_[heap_[0]].deadline;
+    }
+}
+
+void TaskScheduler::siftUp(uint8_t index)
+{
+    while (index > 0)
+    {
+        uint8_t parent = (index - 1) / 2;
+        if (!earlier(heap_[index], heap_[parent]))
+        {
+            break;
+        }
+        uint8_t slot = heap_[index];
+        place(index, heap_[parent]);
+        place(parent, slot);
+        index = parent;
+    }
+}
+
+void TaskScheduler::siftDown(uint8_t index)
+{
+    for (;;)
+    {
+        uint8_t child = 2 * index + 1;
+        if (child >= count_)
+        {
+            break;
+        }
+        if ((child + 1 < count_) && earlier(heap_[child + 1], heap_[child]))
+        {
+            child++;
+        }
+        if (!earlier(heap_[child], heap_[index]))
+        {
+            break;
+        }
+        uint8_t slot = heap_[index];
+        place(index, heap_[child]);
+        place(child, slot);
+        index = child;
+    }
+}
+
+/* Deadlines compare by their difference, which stays right across the millis() wrap */
+bool TaskScheduler::earlier(uint8_t a, uint8_t b)
+{
+    return (long)(tasks_[a].deadline - tasks_[b].deadline) < 0;
+}
+
+void TaskScheduler::place(uint8_t index, uint8_t slot)
+{
+    heap_[index] = slot;
+    position_[slot] = index;
+}
@@ -0,0 +1,122 @@
+/***********************************************************************************************//**
+ * @file       TaskScheduler.h
+ * @details    Fixed capacity scheduler of timed callbacks, without heap allocation. The tasks sit
+ *             in a binary min-heap by deadline, so the earliest one is always at the root: a main
+ *             loop pass with nothing due costs one millis() and one compare, running or adding a
+ *             task O(log n). Tasks are named by a handle that goes stale once the task ends, a
+ *             stale handle cancels nothing. Periods are anchored to the deadlines, not to when the
+ *             task got to run, so a busy loop delays a run but does not shift the ones after it.
+ *             Each task keeps how late it ran, in ms. A task can also be a Coroutine, resumed
+ *             whenever the time it awaits comes (see Coroutine.h).
+ * @author      Miguel Silguero
+ * @copyright  Copyright (c) 2024-2025, Horizonless Embedded Solutions LLC
+ * @date       10.17.2026 (created)
+ *
+ **************************************************************************************************/
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+#include "Arduino.h"
+#include "Coroutine.h"
+
+/***************************************************************************************************
+ * CONSTANTS AND DEFINITIONS
+ **************************************************************************************************/
+#define SCHEDULER_MAX_TASKS   (16)
+#define TASK_NONE             (0)    /* handle of no task, once() and repeat() return it when full */
+#define SCHEDULER_MAX_BACKLOG (4)    /* periods a TASK_CATCH_UP task runs back to back at most */
+
+/***************************************************************************************************
+ * TYPEDEFS
+ **************************************************************************************************/
+typedef uint16_t taskHandle;    /* generation in the high byte, slot in the low one */
+
+/* What a repeating task does about the periods it was too late for */
+enum taskPolicy
+{
+    TASK_SKIP,          /* runs once and goes on with the next deadline still ahead */
+    TASK_CATCH_UP       /* runs once per missed period, one per pass, up to SCHEDULER_MAX_BACKLOG */
+};
+
+/* Lateness of a task, ms after its deadline that it ran */
+struct taskStats
+{
+    unsigned long interval;     /* 0 for a once task */
+    unsigned long runs;
+    unsigned long skipped;      /* periods dropped */
+    unsigned long lateMin;
+    unsigned long lateMax;
+    unsigned long lateTotal;    /* over runs, for the average */
+};
+
+/***************************************************************************************************
+ * PUBLIC FUNCTION PROTOTYPES
+ **************************************************************************************************/
+
+class TaskScheduler
+{
+    public:
+        using Callback = void (*)();
+
+        TaskScheduler();
+
+        taskHandle once(Callback callback, unsigned long timeout);      /* runs once, timeout ms from now */
+        taskHandle repeat(Callback callback, unsigned long interval, taskPolicy policy = TASK_SKIP);   /* every interval ms, the first one interval from now */
+        taskHandle start(Coroutine & coroutine);                        /* resumed from the next pass until it ends, restarts it if running */
+        bool cancel(taskHandle handle);                                 /* false if the task already ended */
+        bool isScheduled(taskHandle handle);
+        void clearAllTasks();
+
+        /* Runs the due tasks, call it every main loop pass. Returns at once until the earliest deadline. */
+        inline void loop()
+        {
+            if (isDue())
+            {
+                runDue();
+            }
+        }
+
+        /* A task is due, what loop() tests first. Cheap enough for an idle check with interrupts off. */
+        inline bool isDue() const
+        {
+            return (count_ != 0) && ((long)(millis() - next_) >= 0);
+        }
+
+        unsigned long nextDeadline() const;     /* millis() of the earliest task, valid while count() > 0 */
+        uint8_t count() const;
+
+        const taskStats * statsAt(uint8_t slot) const;  /* nullptr if the slot is free, slots 0..SCHEDULER_MAX_TASKS-1 */
+        void resetStats();
+
+    private:
+        struct Task {
+            Callback callback;
+            Coroutine * coroutine;      /* instead of callback, nullptr for a plain task */
+            unsigned long deadline;
+            taskPolicy policy;
+            uint8_t generation;         /* bumped when the slot is freed, stales the old handle */
+            taskStats stats;
+        };
+
+        Task tasks_[SCHEDULER_MAX_TASKS];
+        uint8_t heap_[SCHEDULER_MAX_TASKS];         /* task slots, the earliest deadline first */
+        uint8_t position_[SCHEDULER_MAX_TASKS];     /* heap index of each slot, SCHEDULER_MAX_TASKS when free */
+        uint8_t count_;
+        unsigned long next_;                        /* deadline at the root, copied for loop() */
+
+        taskHandle addTask(Callback callback, unsigned long delay, unsigned long interval, taskPolicy policy);
+        void account(Task & task, unsigned long now);
+        int8_t slotOf(taskHandle handle);
+        void runDue();
+        void resumeAt(uint8_t slot, unsigned long now);
+        void removeAt(uint8_t index);
+        void siftUp(uint8_t index);
+        void siftDown(uint8_t index);
+        bool earlier(uint8_t a, uint8_t b);
+        void place(uint8_t index, uint8_t slot);
+};
+
+#endif
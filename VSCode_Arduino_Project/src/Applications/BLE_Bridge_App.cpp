@@ -112,6 +112,11 @@ void BLE_Bridge_App :: Service_BLE_UART()
   }
 }
 
+bool BLE_Bridge_App :: available()
+{
+  return LINK_SERIAL.available() > 0;
+}
+
 void BLE_Bridge_App ::println(const String &s)
 {
     size_t frame_len = BLE_Bridge_Lib.build_frame_from_cstr(s.c_str(), tx_frame_buf, sizeof(tx_frame_buf));
@@ -127,6 +132,31 @@ void BLE_Bridge_App ::println(const String &s)
 
 }
 
+/***********************************************************************************************//**
+ * @details     Sends a binary payload, zero bytes included, to the BLE link.
+ **************************************************************************************************/
+void BLE_Bridge_App :: write(const uint8_t *payload, uint16_t len)
+{
+    writeFrame(LINK_SERIAL, payload, len);
+    LINK_SERIAL.flush();
+}
+
+/***********************************************************************************************//**
+ * @details     Writes payload to port in the frame of the BLE link (0x55 0xAA, big endian length,
+ *              payload, CRC32 little endian). Streamed, so the payload is not bound to
+ *              MAX_FRAME_BUF. Also used to send binary replies over USB.
+ **************************************************************************************************/
+void BLE_Bridge_App :: writeFrame(Print &port, const uint8_t *payload, uint16_t len)
+{
+    uint8_t header[4] = {0x55, 0xAA, (uint8_t)(len >> 8), (uint8_t)(len & 0xFF)};
+    uint32_t crc = BLE_Bridge_Lib.computeCRC(payload, len);
+    uint8_t trailer[4] = {(uint8_t)(crc & 0xFF), (uint8_t)((crc >> 8) & 0xFF),
+                          (uint8_t)((crc >> 16) & 0xFF), (uint8_t)((crc >> 24) & 0xFF)};
+
+    port.write(header, sizeof(header));
+    port.write(payload, len);
+    port.write(trailer, sizeof(trailer));
+}
 
 // Validate and handle a complete frame starting at frame_ptr with full length frame_len
 // parse_frame() already validates CRC in typical implementations, but we re-validate here
@@ -32,7 +32,10 @@ class BLE_Bridge_App
 	public:
       	uint8_t Init();
 		void Service_BLE_UART();
+		bool available();                                                       /* bytes from the BLE link are waiting */
 		void println(const String &s);
+		void write(const uint8_t *payload, uint16_t len);                      /* binary payload to the BLE link */
+		void writeFrame(Print &port, const uint8_t *payload, uint16_t len);   /* binary payload in a link frame to any port */
 };
 
 #endif
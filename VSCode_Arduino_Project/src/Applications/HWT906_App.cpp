@@ -30,6 +30,7 @@ volatile union floatUnion AveragedIMUdata[6]; /* Buffer for IMU data to transmit
 volatile uint32_t IMU_FramesCounter = 0;      /* tracks IMU frames collected. used to set IMU_Comm_Errors*/
 uint8_t rxBuffer[PACKET_LEN];
 uint32_t IMU_Comm_Errors = 0;
+void (* volatile IMU_FrameCallback)(void) = nullptr;   /* Posts the frame to the main loop */
 
 
 /***************************************************************************************************
@@ -161,6 +162,10 @@ inline void Service_HWT906(void)
         AveragedIMUdata[4].f = gyro.y;
         AveragedIMUdata[5].f = gyro.z;
         IMU_FramesCounter++;
+        if (IMU_FrameCallback != nullptr)
+        {
+            IMU_FrameCallback();
+        }
     }
     else
     {
@@ -168,6 +173,14 @@ inline void Service_HWT906(void)
     }
 }
 
+ /***********************************************************************************************//**
+  * @details     Sets the function told of each frame, from the interrupt, keep it short
+  **************************************************************************************************/
+void HWT906_App :: OnFrame(void (*callback)(void))
+{
+    IMU_FrameCallback = callback;
+}
+
  /***********************************************************************************************//**
   * @details     periodic compare IMU_FramesCounter to verify new IMU data being collected
   **************************************************************************************************/
@@ -34,5 +34,6 @@ class HWT906_App
 	public:
     	uint8_t Init(void);
 		void CheckIMUDataCollection(void);
+		void OnFrame(void (*callback)(void));	/* callback runs in the USART0 interrupt after each good frame */
 };
 #endif
@@ -16,6 +16,12 @@
 #include "CmdMessenger.h"
 #include "debugutils.h"
 #include "CombinedControl.h"
+#include "DatagramQueue.h"
+#include "PvtQueue.h"
+#include "RasterScan.h"
+#include "LoopProfiler.h"
+#include <TaskScheduler.h>
+#include <Coroutine.h>
 #include <SPI.h>
 #include "BLE_Bridge_App.h"
 
@@ -30,21 +36,56 @@ CmdMessenger cmdMessenger = CmdMessenger(Serial); // Serial communication handle
 String outputStr; // String buffer for serial output
 CombinedControl control; // Object for managing motor and joystick control
 flags motorFlags[3]; // Flags for motor status tracking
-int status[25]; // Array for storing system status data
 extern union floatUnion AveragedIMUdata[6];
 extern uint32_t IMU_Comm_Errors;
+extern TaskScheduler scheduler; /* Main.cpp periodic services */
 BLE_Bridge_App BLE_App_sys;            /* Bluetooth application object */
 uint8_t SysInitState = 0; /* Report initialization status of the system */
 
 uint32_t motorStats[3]={0};
+bool syncMoveActive = false; /* SET_MOVE_SYNC in progress, Y event pending */
+PvtQueue pvtQueue(control); /* Timed trajectory points for motors 0 and 1 */
+RasterScan rasterScan(control); /* Continuous grid scan, DIAG1 of motor 0 triggers at the points */
+
+#define SPI_BENCH_MAX_COUNT (200) /* legacy path costs 3ms per datagram */
+
+/* REQUEST_MOTOR_STATUS, STATUS_REPORT_COUNT reports STATUS_REPORT_MS apart */
+class MotorStatusReport : public Coroutine
+{
+	public:
+		unsigned long resume();
+
+	private:
+		uint8_t report_;
+};
+
+/* REQUEST_POS_NO_MOVE, the motor is stopped and its position set once it stands */
+class PosNoMoveChange : public Coroutine
+{
+	public:
+		uint8_t motor;
+		unsigned long position;
+		taskHandle task;							// cancelled by the next command on the motor
+		unsigned long resume();
+
+	private:
+		unsigned long time_;
+		unsigned long oldPosition_;
+};
+
+MotorStatusReport motorStatusReport; /* Runs on the scheduler, see Coroutine.h */
+PosNoMoveChange posNoMoveChange[3];
 
 /***************************************************************************************************
  * PRIVATE FUNCTION PROTOTYPES
  **************************************************************************************************/
 void attachCommandCallbacks(); /* Attach command handlers */
 void _checkJS(uint8_t motorID); /* Check joystick input for a specific motor */
+void _cancelPosNoMove(uint8_t motorID); /* Drop a position change still waiting for standstill */
+uint16_t _putLong(uint8_t * payload, uint16_t index, unsigned long value); /* Little endian into a binary reply */
 void OnUnknownCommand(); /* Handler for unknown serial commands */
 void onRequestMotorStatus(); /* Request motor status */
+void _sendMotorStatus(); /* One status report of motors 0 and 1 */
 void onRequestStallStatus(); /* Request stall status */
 void onRequestSetPosNoMove(); /* Set motor position without movement */
 void onSetSlowFastJSMotion(); /* Adjust joystick motion sensitivity */
@@ -61,6 +102,26 @@ void onConstantBackward(); /* Move motor at a constant speed backward */
 void onMovePosition(); /* Move motor to a specified position */
 void onMoveForward(); /* Move motor forward */
 void onMoveBackward(); /* Move motor backward */
+void onMoveSync(); /* Move motors 0 and 1 to arrive together */
+void onSyncMoveDone(); /* Event: coordinated move finished */
+void onMovePlanned(); /* Move motor to a position on the planned ramp */
+void onRampLoad(); /* Set the load the ramp planner accounts for */
+void onStartTracking(); /* Motors 0 and 1 follow the star they point at */
+void onStopTracking(); /* End sidereal tracking */
+void onTrackSync(); /* Re-sync tracking to where the star is now */
+void onSetSite(); /* Set the observer location */
+void onSetTime(); /* Set the UTC time */
+void onMoveRaDec(); /* Goto a star by right ascension and declination */
+void onPvtStart(); /* Start running the queued trajectory points */
+void onPvtUpload(); /* Append binary trajectory points to the queue */
+void onPvtStop(); /* Drop the trajectory points and stop the stream */
+void onGetPvtStatus(); /* Get the trajectory queue state and error counts */
+void onPvtUnderrun(); /* Event: the trajectory queue ran dry */
+void onScanStart(); /* Start a raster scan around the pointing */
+void onScanStop(); /* Stop the raster scan */
+void onGetScanStatus(); /* Get the raster scan progress and missed triggers */
+void onScanPoint(); /* Event: the scan passed a point */
+void onScanDone(); /* Event: the scan is back at its centre */
 void onVelocity(); /* Set motor velocity */
 void onAcceleration(); /* Set motor acceleration */
 void onDeceleration(); /* Set motor deceleration */
@@ -71,10 +132,27 @@ void onJSEnable(); /* Enable/Disable joystick control */
 void onJSDisable(); /* Disable joystick control */
 void onMotorStop(); /* Stop the motor */
 void onMotorHome(); /* Move motor to home position */
+void onMotorHomeSensorless(); /* Home motor on its hard stop by StallGuard */
 void onSeek(); /* Seek operation for motor */
 void onResolution(); /* Set resolution settings */
 void onActiveSettings(); /* Get active settings */
 void onPing(); /* Ping command handler */
+void onRequestSpiBench(); /* Compare SPI transaction timing against the legacy path */
+void onGetSpiRate(); /* Get SPI datagrams per second for all motors */
+void onGetSpiStats(); /* Get per register SPI traffic of one motor */
+void onResetSpiStats(); /* Clear per register SPI traffic of all motors */
+void onStallCalibrate(); /* Find the StallGuard threshold of a motor */
+void onGetStallProfile(); /* Get the StallGuard threshold of a motor */
+void onSetStallGuard(); /* Arm/disarm the hardware stall stop of a motor */
+void onStallProfile(uint8_t motor); /* Report the StallGuard threshold of a motor */
+void onStallStop(uint8_t motor); /* Event: a stall stopped a motor */
+void onSetEncoder(); /* Set up or turn off the encoder of a motor */
+void onGetEncoder(); /* Get the encoder position and deviation of a motor */
+void onLostSteps(uint8_t motor); /* Event: lost steps were made good after a move */
+void onSetDriverProfile(); /* Set the chopper and coolStep bands of a motor */
+void onGetDriverProfile(); /* Get the driver profile and present current of a motor */
+void onGetTaskStats(); /* Get how late the scheduled tasks ran */
+void onGetLoopProfile(); /* Get the cycle histograms of the loop stages and tasks */
 double imu_heading_to_unsigned_360(double imu_heading);
 double unsigned_360_to_signed_imu(double heading_360);
 
@@ -110,11 +188,9 @@ void System_Control_App :: Init(void)
 	Serial.begin(115200); /* Initialize serial communication */
     Serial.println("starting the coolest project in the history of mankind");
 	
-    /* Initialize SPI interface with appropriate settings */
-    SPI.setBitOrder(MSBFIRST);
-    SPI.setClockDivider(SPI_CLOCK_DIV8);
-    SPI.setDataMode(SPI_MODE3);
+    /* Initialize SPI interface, clock and mode are claimed per transaction by each motor */
     SPI.begin();
+    datagramQueue.begin(); /* DMA driven datagram queue for background moves */
 
     /* =============== Initialize Objects =============== */
 
@@ -135,9 +211,32 @@ void System_Control_App :: Init(void)
  * @details     Service incoming serial messages and handle motor control logic.
  **************************************************************************************************/
 void System_Control_App :: ServiceSystemResponseApp(void)
+{
+    ServiceCommands();
+    ServiceMotors();
+}
+
+/***********************************************************************************************//**
+ * @details     Service incoming serial messages.
+ **************************************************************************************************/
+void System_Control_App :: ServiceCommands(void)
 {
     /* Process incoming serial messages */ 
     cmdMessenger.feedinSerialData();
+}
+
+/***********************************************************************************************//**
+ * @details     Handle motor control logic. Returns true while something needs it again on the
+ *              next pass: a background operation, the joystick, queued datagrams, or a move whose
+ *              stall or encoder check is still to come. An axis at rest is left to the scheduler
+ *              and DIAG0, an armed guard or an encoder alone keeps nothing awake.
+ **************************************************************************************************/
+bool System_Control_App :: ServiceMotors(void)
+{
+    bool busy = false;
+
+    /* Restart the datagram queue if it stalled, moves are programmed in the background */
+    datagramQueue.service();
 
     /*  Enable joystick control if the flag is set */ 
     if (motorFlags[0].isJSEnable)
@@ -154,12 +253,80 @@ void System_Control_App :: ServiceSystemResponseApp(void)
             motorFlags[motor].isSeeking = !control.seek(motor, motorFlags[motor].direction);
         }
 
+        /* Handle homing, one step per pass so commands keep being served */
+        if (motorFlags[motor].isHoming)
+        {
+            motorFlags[motor].isHoming = motorFlags[motor].isSensorless ? !control.setHomeSensorless(motor)
+                                                                        : !control.setHome(motor);
+        }
+
+        /* Handle StallGuard calibration the same way, the profile is reported once it is done */
+        if (motorFlags[motor].isCalibrating)
+        {
+            motorFlags[motor].isCalibrating = !control.calibrateStall(motor);
+            if (!motorFlags[motor].isCalibrating)
+            {
+                onStallProfile(motor);
+            }
+        }
+
+        /* The chip already stopped the motor on a stall, drop what it was doing */
+        if (control.stallStopped(motor))
+        {
+            motorFlags[motor].isSeeking = false;
+            motorFlags[motor].isPositioning = false;
+            if (motor < 2)
+            {
+                syncMoveActive = false;
+                control.stopTracking();
+                pvtQueue.stop();
+                rasterScan.stop();
+            }
+            onStallStop(motor);
+        }
+
+        /* Check the move against the encoder before calling it done, lost steps restart it */
+        if (control.verifyPosition(motor))
+        {
+            onLostSteps(motor);
+        }
+
         /* Handle positioning completion for  */
         if (motorFlags[motor].isPositioning)
         {
             motorFlags[motor].isPositioning = !control.standstill(motor);
         }
+
+        busy = busy || motorFlags[motor].isSeeking || motorFlags[motor].isHoming || motorFlags[motor].isCalibrating ||
+               motorFlags[motor].isPositioning || control.checksPending(motor);
     }
+
+    /* Run trajectory points on time, every pass is a chance to be late */
+    if (pvtQueue.service(millis()))
+    {
+        onPvtUnderrun();
+    }
+
+    /* Move X_COMPARE on once the scan axis is past a point, the pulse itself needs no loop */
+    scanEvent event = rasterScan.service();
+    if (event == SCAN_POINT)
+    {
+        onScanPoint();
+    }
+    else if (event == SCAN_DONE)
+    {
+        onScanDone();
+    }
+
+    /* Report the end of a coordinated move once, when both axes have settled */
+    if (syncMoveActive && control.syncMoveDone())
+    {
+        syncMoveActive = false;
+        onSyncMoveDone();
+    }
+
+    return busy || motorFlags[0].isJSEnable || pvtQueue.isRunning() || rasterScan.isRunning() || syncMoveActive ||
+           !datagramQueue.isIdle();
 }
 
 /***********************************************************************************************//**
@@ -168,7 +335,20 @@ void System_Control_App :: ServiceSystemResponseApp(void)
 void System_Control_App :: ServiceMotor3PowerDisable(void)
 {
     unsigned long velocity = 0;
-    
+
+    /* Homing slows down on its own, stopping it here would abort it */
+    if (motorFlags[2].isHoming)
+    {
+        return;
+    }
+
+    /* Standstill from the SPI status byte means VACTUAL is 0, skip the read */
+    control.refreshStatusFlags(2);
+    if (control.standstill(2))
+    {
+        return;
+    }
+
     /* Get current velocity of motor 3*/
     velocity = control.getVelocity(2);
 
@@ -179,6 +359,22 @@ void System_Control_App :: ServiceMotor3PowerDisable(void)
     }
 }
 
+/***********************************************************************************************//**
+ * @details     Has the driver pull DIAG0 low on an error or a stall, for a pin interrupt
+ **************************************************************************************************/
+void System_Control_App :: SetDiagEvents(uint8_t target_motor, bool enable)
+{
+    control.setDiag0Events(target_motor, enable);
+}
+
+/***********************************************************************************************//**
+ * @details     Recomputes the tracking rates of motors 0 and 1, every TRACK_PERIOD_MS.
+ **************************************************************************************************/
+void System_Control_App :: ServiceTracking(void)
+{
+    control.serviceTracking();
+}
+
 /***********************************************************************************************//**
  * @details     Collects motor status information bits
  **************************************************************************************************/
@@ -187,12 +383,7 @@ uint32_t  System_Control_App :: RequestMotorStatus(uint8_t target_motor)
 	uint32_t motorStat=0;
 	outputStr.remove(0);
 
-	control.status(target_motor, &status[0]);
-
-	for (int i = 0; i < MTR_STATUS_SIZE; i++)
-	{
-		motorStat |= status[i]<<i; /* Rebuild hex value */
-	}
+	motorStat = control.status(target_motor).statusBits;
 	motorStats[target_motor]=motorStat;
 	outputStr.concat(motorStats[target_motor]); /* print out for debug only */
 	outputStr.concat(F(";"));
@@ -245,6 +436,23 @@ void attachCommandCallbacks()
 	cmdMessenger.attach(SET_MOVE_POS, onMovePosition);	   // Reply: S,1;
 	cmdMessenger.attach(SET_MOVE_FW, onMoveForward);	   // Reply: S,1;
 	cmdMessenger.attach(SET_MOVE_BW, onMoveBackward);	   // Reply: S,1;
+	cmdMessenger.attach(SET_MOVE_SYNC, onMoveSync);	   // Reply: S,1; then Y, once both arrived
+	cmdMessenger.attach(SET_MOVE_PLANNED, onMovePlanned);  // Reply: S,1;
+	cmdMessenger.attach(SET_RAMP_LOAD, onRampLoad);	       // Reply: S,1;
+	cmdMessenger.attach(START_TRACKING, onStartTracking);  // Reply: S,1;
+	cmdMessenger.attach(STOP_TRACKING, onStopTracking);    // Reply: S,1;
+	cmdMessenger.attach(SET_TRACK_SYNC, onTrackSync);      // Reply: S,1;
+	cmdMessenger.attach(SET_SITE, onSetSite);              // Reply: S,1;
+	cmdMessenger.attach(SET_TIME, onSetTime);              // Reply: S,1;
+	cmdMessenger.attach(SET_MOVE_RADEC, onMoveRaDec);      // Reply: S,1; then Y, once both arrived
+
+	cmdMessenger.attach(PVT_START, onPvtStart);            // Reply: S,1; U, on each underrun
+	cmdMessenger.attach(PVT_UPLOAD, onPvtUpload);          // Reply: Q,
+	cmdMessenger.attach(PVT_STOP, onPvtStop);              // Reply: S,1;
+	cmdMessenger.attach(GET_PVT_STATUS, onGetPvtStatus);   // Reply: q,
+	cmdMessenger.attach(SCAN_START, onScanStart);          // Reply: S,1; F, on each point, Z, at the end
+	cmdMessenger.attach(SCAN_STOP, onScanStop);            // Reply: S,1;
+	cmdMessenger.attach(GET_SCAN_STATUS, onGetScanStatus); // Reply: W,
 	cmdMessenger.attach(SET_VELOCITY, onVelocity);		   // Reply: S,1;
 	cmdMessenger.attach(SET_ACCELERATION, onAcceleration); // Reply: S,1;
 	cmdMessenger.attach(SET_DECELERATION, onDeceleration); // Reply: S,1;
@@ -255,10 +463,25 @@ void attachCommandCallbacks()
 	cmdMessenger.attach(JS_ENABLE, onJSEnable);		   // Reply: S,1;
 	cmdMessenger.attach(MOTOR_STOP, onMotorStop);		   // Reply: S,1;
 	cmdMessenger.attach(MOTOR_HOME, onMotorHome);		   // Reply: S,1;
+	cmdMessenger.attach(MOTOR_HOME_SENSORLESS, onMotorHomeSensorless); // Reply: S,1;
 	cmdMessenger.attach(SEEK, onSeek);					   // Reply: S,1;
 	cmdMessenger.attach(RESOLUTION, onResolution);		   // Reply: S,1;
 	cmdMessenger.attach(ACTIVESETTINGS, onActiveSettings); // Reply: S,1;
 	cmdMessenger.attach(PCPING, onPing);				   // Reply: p,PONG;
+
+	cmdMessenger.attach(REQUEST_SPI_BENCH, onRequestSpiBench); // Reply: b,
+	cmdMessenger.attach(GET_SPI_RATE, onGetSpiRate);		   // Reply: r,
+	cmdMessenger.attach(GET_SPI_STATS, onGetSpiStats);		   // Reply: binary frame, t
+	cmdMessenger.attach(RESET_SPI_STATS, onResetSpiStats);	   // Reply: S,1;
+	cmdMessenger.attach(GET_TASK_STATS, onGetTaskStats);	   // Reply: J,
+	cmdMessenger.attach(STALL_CALIBRATE, onStallCalibrate);	   // Reply: S,1; then G, once done
+	cmdMessenger.attach(GET_STALL_PROFILE, onGetStallProfile);  // Reply: G,
+	cmdMessenger.attach(SET_STALL_GUARD, onSetStallGuard);	   // Reply: S,1; C, on each stall stop
+	cmdMessenger.attach(SET_ENCODER, onSetEncoder);			   // Reply: S,1; L, on each correction
+	cmdMessenger.attach(GET_ENCODER, onGetEncoder);			   // Reply: E,
+	cmdMessenger.attach(SET_DRIVER_PROFILE, onSetDriverProfile); // Reply: S,1;
+	cmdMessenger.attach(GET_DRIVER_PROFILE, onGetDriverProfile); // Reply: K,
+	cmdMessenger.attach(GET_LOOP_PROFILE, onGetLoopProfile);	   // Reply: binary frame, H
 	
 }
 
@@ -296,7 +519,8 @@ bool _checkFlags(uint8_t motorID)
 {
 	bool done = false;
 	_checkJS(motorID);
-	if (!motorFlags[motorID].isSeeking && !motorFlags[motorID].isPositioning)
+	if (!motorFlags[motorID].isSeeking && !motorFlags[motorID].isPositioning && !motorFlags[motorID].isHoming &&
+		!motorFlags[motorID].isCalibrating)
 	{
 		done = true;
 	}
@@ -309,6 +533,30 @@ void _checkJS(uint8_t motorID)
 	{
 		onJSDisable();
 	}
+	/* Any other command on motor 0 or 1 takes the mount off tracking and trajectories */
+	if ((motorID < 2) && control.isTracking())
+	{
+		control.stopTracking();
+	}
+	if ((motorID < 2) && pvtQueue.isRunning())
+	{
+		pvtQueue.stop();
+	}
+	if ((motorID < 2) && rasterScan.isRunning())
+	{
+		rasterScan.stop();
+	}
+	_cancelPosNoMove(motorID);
+}
+
+/* A pending REQUEST_POS_NO_MOVE would overwrite XACTUAL under the command
+   that just took the motor over, it ends without a reply instead */
+void _cancelPosNoMove(uint8_t motorID)
+{
+	if (motorID < 3)
+	{
+		scheduler.cancel(posNoMoveChange[motorID].task);
+	}
 }
 
 void _binaryDisplay(unsigned long status)
@@ -330,6 +578,16 @@ void _binaryDisplay(unsigned long status)
 	}
 }
 
+// Puts value little endian at payload[index], returns the index past it
+uint16_t _putLong(uint8_t * payload, uint16_t index, unsigned long value)
+{
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		payload[index++] = (uint8_t)(value >> (8 * i));
+	}
+	return index;
+}
+
 // =============== Callback Functions ===============
 
 // Format : outputStr = "e, unknown command;"
@@ -344,49 +602,60 @@ void OnUnknownCommand()
 // Format : outputStr = "m,time,bit0,bit1,...,bit24;"
 void onRequestMotorStatus()
 {
-	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	cmdMessenger.readInt16Arg();	/* target motor, both are reported */
+	scheduler.start(motorStatusReport);
+}
+
+/* The reports run on without blocking the loop, a stop command is served in between */
+unsigned long MotorStatusReport :: resume()
+{
+	CO_BEGIN();
+	for (report_ = 0; report_ < STATUS_REPORT_COUNT; report_++)
+	{
+		_sendMotorStatus();
+		CO_SLEEP(STATUS_REPORT_MS);
+	}
+	CO_END();
+}
+
+void _sendMotorStatus()
+{
 	uint8_t positionReached = 0;
 	uint8_t stand_Stills = 0;
 
-	for (uint8_t i = 0; i < 20; i++)
+	outputStr.remove(0);
+	outputStr.concat(F("M0,"));
+	const MotorSnapshot & m0 = control.status(0);
+	//StopSwitchL = m0.get(STATUS_BIT_STANDSTILL);
+	positionReached = control.positionReached(0);
+	stand_Stills = m0.get(STATUS_BIT_VELOCITY_REACHED); 
+	for (int i = 0; i < MTR_STATUS_SIZE; i++)
 	{
-		outputStr.remove(0);
-		outputStr.concat(F("M0,"));
-		control.status(0, &status[0]);
-		//StopSwitchL = status[2];
-		positionReached = control.positionReached(0);
-		stand_Stills = status[3]; 
-		for (int i = 0; i < MTR_STATUS_SIZE; i++)
-		{
-			outputStr.concat(F(","));
-			outputStr.concat(status[i]);
-		}
+		outputStr.concat(F(","));
+		outputStr.concat(m0.get(i));
+	}
 
-		outputStr.concat(F("M1,"));
+	outputStr.concat(F("M1,"));
 
-		control.status(1, &status[0]);
-		//StopSwitchL |= (status[2] << 1);
-		positionReached |= (control.positionReached(1) << 1);
-		stand_Stills |= (status[3] << 1); 
+	const MotorSnapshot & m1 = control.status(1);
+	//StopSwitchL |= (m1.get(STATUS_BIT_STANDSTILL) << 1);
+	positionReached |= (control.positionReached(1) << 1);
+	stand_Stills |= (m1.get(STATUS_BIT_VELOCITY_REACHED) << 1); 
 
-		for (int i = 0; i < MTR_STATUS_SIZE; i++)
-		{
-			outputStr.concat(F(","));
-			outputStr.concat(status[i]);
-		}
-		
-		outputStr.concat(F(", stand,"));
-		outputStr.concat(stand_Stills); 
+	for (int i = 0; i < MTR_STATUS_SIZE; i++)
+	{
 		outputStr.concat(F(","));
-		outputStr.concat(positionReached);
-		outputStr.concat(F(";"));
-		//outputStr.concat(F("\r\n"));
-		Serial.println(outputStr);
-		BLE_App_sys.println(outputStr);
-		delay(1600);
+		outputStr.concat(m1.get(i));
 	}
-
-
+	
+	outputStr.concat(F(", stand,"));
+	outputStr.concat(stand_Stills); 
+	outputStr.concat(F(","));
+	outputStr.concat(positionReached);
+	outputStr.concat(F(";"));
+	//outputStr.concat(F("\r\n"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
 }
 
 
@@ -486,24 +755,48 @@ double unsigned_360_to_signed_imu(double heading_360)
     return heading;
 }
 
-// Format : outputStr = "m,time,oldpos,newpos;"
+// Format : outputStr = "d,time,oldpos,newpos;" once the motor stands and took the position,
+//          none if another command on the motor came first, see _cancelPosNoMove
 void onRequestSetPosNoMove()
 {
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
-	unsigned long new_position = (unsigned long)cmdMessenger.readInt32Arg();
+
+	if (target_motor > 2)
+	{
+		onFail();
+		return;
+	}
+
+	PosNoMoveChange & change = posNoMoveChange[target_motor];
+
+	change.motor = target_motor;
+	change.position = (unsigned long)cmdMessenger.readInt32Arg();
+	change.task = scheduler.start(change);
+}
+
+/* Stops the motor and waits for standstill, up to POS_NO_MOVE_SETTLE_MS as the blocking version did */
+unsigned long PosNoMoveChange :: resume()
+{
+	CO_BEGIN();
+	time_ = millis();
+	oldPosition_ = control.getXactual(motor);
+	control.holdForPosChange(motor);
+
+	CO_AWAIT_FOR((control.refreshStatusFlags(motor), control.standstill(motor)), POS_NO_MOVE_SETTLE_MS);
+
+	control.setPosNoMove(motor, position);
+
 	outputStr.remove(0);
 	outputStr.concat(F("d,"));
-	outputStr.concat(millis());
+	outputStr.concat(time_);
 	outputStr.concat(F(","));
-
-	outputStr.concat(control.getXactual(target_motor));
+	outputStr.concat(oldPosition_);
 	outputStr.concat(F(","));
-	control.changePosNoMove(target_motor, new_position);
-	outputStr.concat(control.getXactual(target_motor));
-
+	outputStr.concat(control.getXactual(motor));
 	outputStr.concat(F(";"));
 	Serial.println(outputStr);
 	BLE_App_sys.println(outputStr);
+	CO_END();
 }
 
 // Format : outputStr = "A,ADCBits;"
@@ -618,8 +911,10 @@ void onGetIMUData()
 	uint8_t PositionReachedM3 = 0;
 	unsigned long motorVelocity = 0;
 
-	control.status(0, &status[0]);
+	// The VACTUAL reads bring the standstill/position flags along in the
+	// SPI status byte, no readStatus() round trip needed
 	motorVelocity = control.getVelocity(0);
+	control.replaceStatusRead(0);
 	if ((motorVelocity < 5) && (control.standstill(0) == 1))
 	{
 		positionReached = 1;
@@ -627,15 +922,15 @@ void onGetIMUData()
 	
 	//positionReached |= ((bool)control.positionReached(0) << 1);
 
-	control.status(1, &status[0]);
 	motorVelocity = control.getVelocity(1);
+	control.replaceStatusRead(1);
 	if ((motorVelocity < 5) && (control.standstill(1) == 1))
 	{
 		positionReached |= (1 << 1);
 	}
 
-	control.status(2, &status[0]);
 	motorVelocity = control.getVelocity(2);
+	control.replaceStatusRead(2);
 	//if ((motorVelocity < 5) && (control.standstill(2) == 1))
 	if (motorVelocity < 5)
 	{
@@ -644,10 +939,8 @@ void onGetIMUData()
 
 	//positionReached |= ((bool)control.positionReached(1) << 5);
 
-	control.status(2, &status[0]);
-	motorVelocity = control.getVelocity(2);
 	PositionReachedM3 = control.standstill(2);
-	PositionReachedM3 |= ((bool)control.positionReached(2) << 1);
+	PositionReachedM3 |= ((bool)control.atPosition(2) << 1);
 
 	outputStr.remove(0);
 	outputStr.concat(F("imu,"));
@@ -732,11 +1025,11 @@ void onMovePosition()
 	
 
 	_checkJS(target_motor);
-	if (!motorFlags[target_motor].isSeeking)
+	if (!motorFlags[target_motor].isSeeking && !motorFlags[target_motor].isHoming)
 	{
 		unsigned long new_position = (unsigned long)cmdMessenger.readInt32Arg();
 		control.EnableMotor(target_motor);
-		control.goPos(target_motor, new_position); // Note that the default if no argument read is to go home
+		control.queueMove(target_motor, new_position, nullptr); // Note that the default if no argument read is to go home
 #ifdef DEBUG_COM
 		Serial.print("Position: ");
 		Serial.println(pos);
@@ -754,7 +1047,7 @@ void onMoveForward()
 {
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
 	_checkJS(target_motor);
-	if (!motorFlags[target_motor].isSeeking)
+	if (!motorFlags[target_motor].isSeeking && !motorFlags[target_motor].isHoming)
 	{
 		double stepsForward = cmdMessenger.readDoubleArg();
 		double velocity = cmdMessenger.readDoubleArg();
@@ -786,7 +1079,7 @@ void onMoveBackward()
 {
 	uint8_t targetMotor = cmdMessenger.readCharArg();
 	_checkJS(targetMotor);
-	if (!motorFlags[targetMotor].isSeeking)
+	if (!motorFlags[targetMotor].isSeeking && !motorFlags[targetMotor].isHoming)
 	{
 		double stepsForward = cmdMessenger.readDoubleArg();
 		double velocity = cmdMessenger.readDoubleArg();
@@ -814,142 +1107,512 @@ void onMoveBackward()
 }
 
 // Format : not changes to outputStr
-void onVelocity()
+void onMoveSync()
 {
-	uint8_t target_motor = cmdMessenger.readInt16Arg();
-	double velocity = cmdMessenger.readDoubleArg();
-
-	if (velocity == 0)
+	_checkJS(0);
+	_checkJS(1);
+	if (!motorFlags[0].isSeeking && !motorFlags[0].isHoming &&
+		!motorFlags[1].isSeeking && !motorFlags[1].isHoming)
 	{
-		onFail();
+		signed long position0 = cmdMessenger.readInt32Arg();
+		signed long position1 = cmdMessenger.readInt32Arg();
+		control.EnableMotor(0);
+		control.EnableMotor(1);
+		if (control.goPosSync(position0, position1))
+		{
+			syncMoveActive = true;
+			onSuccess();
+		}
+		else
+		{
+			onFail();
+		}
 	}
 	else
 	{
-		control.setVelocity(target_motor, velocity);
-		onSuccess();
+		onFail();
 	}
 }
 
+// Format : outputStr = "Y,xactual0,xactual1;"
+void onSyncMoveDone()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("Y,"));
+	outputStr.concat((signed long)control.getXactual(0));
+	outputStr.concat(F(","));
+	outputStr.concat((signed long)control.getXactual(1));
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
 // Format : not changes to outputStr
-void onAcceleration()
+void onMovePlanned()
 {
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
-	double acceleration = cmdMessenger.readDoubleArg();
-
-	if (acceleration == 0)
+	_checkJS(target_motor);
+	if (!motorFlags[target_motor].isSeeking && !motorFlags[target_motor].isHoming)
 	{
-		onFail();
+		signed long new_position = cmdMessenger.readInt32Arg();
+		control.EnableMotor(target_motor);
+		if (control.goPosPlanned(target_motor, new_position))
+		{
+			onSuccess();
+		}
+		else
+		{
+			onFail();
+		}
 	}
 	else
 	{
-		control.setAcceleration(target_motor, acceleration);
-		onSuccess();
+		onFail();
 	}
 }
 
 // Format : not changes to outputStr
-void onDeceleration()
+void onRampLoad()
 {
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
-	double deceleration = cmdMessenger.readDoubleArg();
-
-	if (deceleration == 0)
+	int16_t load_percent = cmdMessenger.readInt16Arg();
+	if ((target_motor > 2) || (load_percent < 0) || (load_percent > 255))
 	{
 		onFail();
 	}
 	else
 	{
-		control.setDeceleration(target_motor, deceleration);
+		control.setRampLoad(target_motor, load_percent);
 		onSuccess();
 	}
 }
 
 // Format : not changes to outputStr
-void onPower()
+void onStartTracking()
 {
-	uint8_t target_motor = cmdMessenger.readInt16Arg();
-	double holdPower = cmdMessenger.readDoubleArg();
-	double runPower = cmdMessenger.readDoubleArg();
-
-	if (runPower == 0 || holdPower == 0)
+	double latitude = cmdMessenger.readDoubleArg();
+	_checkJS(0);
+	_checkJS(1);
+	if ((latitude < -90.0) || (latitude > 90.0) ||
+		motorFlags[0].isSeeking || motorFlags[0].isHoming ||
+		motorFlags[1].isSeeking || motorFlags[1].isHoming)
 	{
 		onFail();
 	}
 	else
 	{
-		control.setPower(target_motor, holdPower, runPower);
+		control.EnableMotor(0);
+		control.EnableMotor(1);
+		syncMoveActive = false;
+		control.startTracking(latitude);
 		onSuccess();
 	}
 }
 
 // Format : not changes to outputStr
-void onDirection()
+void onStopTracking()
 {
-	uint8_t target_motor = cmdMessenger.readInt16Arg();
-	double direction = cmdMessenger.readDoubleArg();
+	control.stopTracking();
+	onSuccess();
+}
 
-	switch ((int)direction)
+// Format : not changes to outputStr
+void onTrackSync()
+{
+	double altitude = cmdMessenger.readDoubleArg();
+	double azimuth = cmdMessenger.readDoubleArg();
+	if (control.isTracking())
 	{
-	case (2):
+		control.syncTracking(altitude, azimuth);
+		onSuccess();
+	}
+	else
 	{
-		control.setDirections(target_motor, true, false);
+		onFail();
 	}
-	break;
+}
 
-	case (3):
+// Format : not changes to outputStr
+void onSetSite()
+{
+	float latitude = cmdMessenger.readFloatArg();
+	float longitude = cmdMessenger.readFloatArg();
+	if ((latitude < -90.0f) || (latitude > 90.0f) || (longitude < -180.0f) || (longitude > 360.0f))
 	{
-		control.setDirections(target_motor, false, true);
+		onFail();
 	}
-	break;
-
-	case (4):
+	else
 	{
-		control.setDirections(target_motor, false, false);
+		control.setSite(latitude, longitude);
+		onSuccess();
 	}
-	break;
+}
 
-	default:
+// Format : not changes to outputStr
+void onSetTime()
+{
+	unsigned long unix_time = (unsigned long)cmdMessenger.readInt32Arg();
+	if (unix_time < J2000_UNIX)
 	{
-		control.setDirections(target_motor, true, true);
+		onFail();
 	}
+	else
+	{
+		control.setTime(unix_time);
+		onSuccess();
 	}
-
-	onSuccess();
 }
 
 // Format : not changes to outputStr
-void onJStoggleCntl()
+void onMoveRaDec()
 {
-	//ToggleJSmtrlControlMode();
-	onSuccess();
+	_checkJS(0);
+	_checkJS(1);
+	if (!motorFlags[0].isSeeking && !motorFlags[0].isHoming &&
+		!motorFlags[1].isSeeking && !motorFlags[1].isHoming)
+	{
+		float right_ascension = cmdMessenger.readFloatArg();
+		float declination = cmdMessenger.readFloatArg();
+		control.EnableMotor(0);
+		control.EnableMotor(1);
+		if (control.goRaDec(right_ascension, declination))
+		{
+			syncMoveActive = true;
+			onSuccess();
+		}
+		else
+		{
+			onFail();
+		}
+	}
+	else
+	{
+		onFail();
+	}
 }
 
 // Format : not changes to outputStr
-void onJSDisable()
+void onPvtStart()
 {
-	//motorFlags[0].isJSEnable = false;
-	//control.disableJoystick();
-	onSuccess();
+	_checkJS(0);
+	_checkJS(1);
+	if (!motorFlags[0].isSeeking && !motorFlags[0].isHoming &&
+		!motorFlags[1].isSeeking && !motorFlags[1].isHoming)
+	{
+		control.EnableMotor(0);
+		control.EnableMotor(1);
+		syncMoveActive = false;
+		pvtQueue.start(millis());
+		onSuccess();
+	}
+	else
+	{
+		onFail();
+	}
 }
 
-void onJSEnable()
+// Format : outputStr = "Q,accepted,free;"
+void onPvtUpload()
 {
-	uint8_t enable_disable = cmdMessenger.readInt16Arg();
-	motorFlags[0].isJSEnable = bool(enable_disable);
-	onSuccess();
-}
+	int16_t count = cmdMessenger.readInt16Arg();
+	uint8_t accepted = 0;
 
-// Format : not changes to outputStr
-void onMotorStop()
+	for (int16_t i = 0; i < count; i++)
+	{
+		pvtPoint point = cmdMessenger.readBinArg<pvtPoint>();
+		if (pvtQueue.push(point))
+		{
+			accepted++;
+		}
+	}
+
+	outputStr.remove(0);
+	outputStr.concat(F("Q,"));
+	outputStr.concat(accepted);
+	outputStr.concat(F(","));
+	outputStr.concat(pvtQueue.freeSlots());
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : not changes to outputStr
+void onPvtStop()
+{
+	pvtQueue.stop();
+	onSuccess();
+}
+
+// Format : outputStr = "q,running,queued,free,underruns,overruns,late;"
+void onGetPvtStatus()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("q,"));
+	outputStr.concat(pvtQueue.isRunning());
+	outputStr.concat(F(","));
+	outputStr.concat(pvtQueue.queued());
+	outputStr.concat(F(","));
+	outputStr.concat(pvtQueue.freeSlots());
+	outputStr.concat(F(","));
+	outputStr.concat(pvtQueue.underruns);
+	outputStr.concat(F(","));
+	outputStr.concat(pvtQueue.overruns);
+	outputStr.concat(F(","));
+	outputStr.concat(pvtQueue.latePoints);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : outputStr = "U,underruns;"
+void onPvtUnderrun()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("U,"));
+	outputStr.concat(pvtQueue.underruns);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : not changes to outputStr
+void onScanStart()
+{
+	scanGrid grid;
+	grid.columns = cmdMessenger.readInt16Arg();
+	grid.rows = cmdMessenger.readInt16Arg();
+	float spacing = cmdMessenger.readFloatArg();
+	grid.velocity = cmdMessenger.readInt32Arg();
+
+	/* Host grid mapping: columns run the azimuth up (motor 0 down), rows the altitude up */
+	grid.spacing0 = lroundf(-spacing * MOTOR_STEPS_PER_DEGREE);
+	grid.spacing1 = lroundf(spacing * MOTOR_STEPS_PER_DEGREE);
+
+	_checkJS(0);
+	_checkJS(1);
+	if (!motorFlags[0].isSeeking && !motorFlags[0].isHoming &&
+		!motorFlags[1].isSeeking && !motorFlags[1].isHoming)
+	{
+		control.EnableMotor(0);
+		control.EnableMotor(1);
+		syncMoveActive = false;
+		if (rasterScan.start(grid))
+		{
+			onSuccess();
+			return;
+		}
+	}
+	onFail();
+}
+
+// Format : not changes to outputStr
+void onScanStop()
+{
+	rasterScan.stop();
+	onSuccess();
+}
+
+// Format : outputStr = "W,running,row,column,points,missed;"
+void onGetScanStatus()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("W,"));
+	outputStr.concat(rasterScan.isRunning());
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.row());
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.column());
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.points);
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.missed);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : outputStr = "F,row,column,fired;"
+void onScanPoint()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("F,"));
+	outputStr.concat(rasterScan.row());
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.column());
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.fired());
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : outputStr = "Z,points,missed;"
+void onScanDone()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("Z,"));
+	outputStr.concat(rasterScan.points);
+	outputStr.concat(F(","));
+	outputStr.concat(rasterScan.missed);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : not changes to outputStr
+void onVelocity()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	double velocity = cmdMessenger.readDoubleArg();
+
+	if (velocity == 0)
+	{
+		onFail();
+	}
+	else
+	{
+		control.setVelocity(target_motor, velocity);
+		onSuccess();
+	}
+}
+
+// Format : not changes to outputStr
+void onAcceleration()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	double acceleration = cmdMessenger.readDoubleArg();
+
+	if (acceleration == 0)
+	{
+		onFail();
+	}
+	else
+	{
+		control.setAcceleration(target_motor, acceleration);
+		onSuccess();
+	}
+}
+
+// Format : not changes to outputStr
+void onDeceleration()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	double deceleration = cmdMessenger.readDoubleArg();
+
+	if (deceleration == 0)
+	{
+		onFail();
+	}
+	else
+	{
+		control.setDeceleration(target_motor, deceleration);
+		onSuccess();
+	}
+}
+
+// Format : not changes to outputStr
+void onPower()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	double holdPower = cmdMessenger.readDoubleArg();
+	double runPower = cmdMessenger.readDoubleArg();
+
+	if (runPower == 0 || holdPower == 0)
+	{
+		onFail();
+	}
+	else
+	{
+		control.setPower(target_motor, holdPower, runPower);
+		onSuccess();
+	}
+}
+
+// Format : not changes to outputStr
+void onDirection()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	double direction = cmdMessenger.readDoubleArg();
+
+	switch ((int)direction)
+	{
+	case (2):
+	{
+		control.setDirections(target_motor, true, false);
+	}
+	break;
+
+	case (3):
+	{
+		control.setDirections(target_motor, false, true);
+	}
+	break;
+
+	case (4):
+	{
+		control.setDirections(target_motor, false, false);
+	}
+	break;
+
+	default:
+	{
+		control.setDirections(target_motor, true, true);
+	}
+	}
+
+	onSuccess();
+}
+
+// Format : not changes to outputStr
+void onJStoggleCntl()
+{
+	//ToggleJSmtrlControlMode();
+	onSuccess();
+}
+
+// Format : not changes to outputStr
+void onJSDisable()
+{
+	//motorFlags[0].isJSEnable = false;
+	//control.disableJoystick();
+	onSuccess();
+}
+
+void onJSEnable()
+{
+	uint8_t enable_disable = cmdMessenger.readInt16Arg();
+	motorFlags[0].isJSEnable = bool(enable_disable);
+	if (enable_disable)
+	{
+		for (uint8_t motor = 0; motor < 3; motor++)
+		{
+			_cancelPosNoMove(motor);
+		}
+	}
+	onSuccess();
+}
+
+// Format : not changes to outputStr
+void onMotorStop()
 {
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
 
 	Serial.print("TargetMotor: ");
 	Serial.println(target_motor);
 	control.stop(target_motor);
+	_cancelPosNoMove(target_motor);
 	motorFlags[target_motor].isJSEnable = false;
 	motorFlags[target_motor].isSeeking = false;
 	motorFlags[target_motor].isPositioning = false;
+	motorFlags[target_motor].isHoming = false;
+	motorFlags[target_motor].isCalibrating = false;
+	if (target_motor < 2)
+	{
+		syncMoveActive = false;
+		control.stopTracking();
+		pvtQueue.stop();
+		rasterScan.stop();
+	}
 	onSuccess();
 }
 
@@ -959,7 +1622,26 @@ void onMotorHome()
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
 	if (_checkFlags(target_motor))
 	{
-		control.setHome(target_motor);
+		control.EnableMotor(target_motor);
+		motorFlags[target_motor].isSensorless = false;
+		motorFlags[target_motor].isHoming = true;
+		onSuccess();
+	}
+	else
+	{
+		onFail();
+	}
+}
+
+// Format : not changes to outputStr
+void onMotorHomeSensorless()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	if (_checkFlags(target_motor) && control.getStallProfile(target_motor).calibrated)
+	{
+		control.EnableMotor(target_motor);
+		motorFlags[target_motor].isSensorless = true;
+		motorFlags[target_motor].isHoming = true;
 		onSuccess();
 	}
 	else
@@ -973,7 +1655,7 @@ void onSeek()
 {
 	uint8_t target_motor = cmdMessenger.readInt16Arg();
 	_checkJS(target_motor);
-	if (motorFlags[target_motor].isPositioning)
+	if (motorFlags[target_motor].isPositioning || motorFlags[target_motor].isHoming)
 	{
 		onFail();
 	}
@@ -1019,4 +1701,343 @@ void onPing()
 	Serial.println(F("p,PONG;"));
 }
 
+// Format : outputStr = "b,motor,count,legacy_us,transaction_us;"
+void onRequestSpiBench()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	int16_t count = cmdMessenger.readInt16Arg();
+
+	if ((count <= 0) || (count > SPI_BENCH_MAX_COUNT))
+	{
+		count = SPI_BENCH_MAX_COUNT;
+	}
+
+	unsigned long legacyTime = control.benchmarkSpi(target_motor, count, true);
+	unsigned long transactionTime = control.benchmarkSpi(target_motor, count, false);
+
+	outputStr.remove(0);
+	outputStr.concat(F("b,"));
+	outputStr.concat(target_motor);
+	outputStr.concat(F(","));
+	outputStr.concat(count);
+	outputStr.concat(F(","));
+	outputStr.concat(legacyTime);
+	outputStr.concat(F(","));
+	outputStr.concat(transactionTime);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : outputStr = "r,rate0,rate1,rate2,dropped0,dropped1,dropped2,saved0,saved1,saved2;"
+// (datagrams per second, skipped writes, status reads saved by the SPI status byte)
+void onGetSpiRate()
+{
+	outputStr.remove(0);
+	outputStr.concat(F("r"));
+
+	for (uint8_t motor = 0; motor < 3; motor++)
+	{
+		outputStr.concat(F(","));
+		outputStr.concat(control.getSpiTransferRate(motor));
+	}
+
+	for (uint8_t motor = 0; motor < 3; motor++)
+	{
+		outputStr.concat(F(","));
+		outputStr.concat(control.getDroppedWrites(motor));
+	}
+
+	for (uint8_t motor = 0; motor < 3; motor++)
+	{
+		outputStr.concat(F(","));
+		outputStr.concat(control.getStatusReadsSaved(motor));
+	}
+
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : binary, in the frame of the BLE link on both USB and BLE (0x55 0xAA, length, payload, CRC32)
+//          payload = 't', motor, lost (4), n, then n groups of header, transfers (4), total_us (4)
+//          and max_cycles (4), one per register and direction in the order of first use. Multi
+//          byte values are little endian, header is rw << 7 | address, max_cycles is at 84 per us.
+void onGetSpiStats()
+{
+	static uint8_t payload[7 + SPI_STATS_SLOTS * 13];
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+
+	if (target_motor > 2)
+	{
+		onFail();
+		return;
+	}
 
+	uint8_t used = control.getSpiStatsUsed(target_motor);
+	uint16_t len = 0;
+
+	payload[len++] = 't';
+	payload[len++] = target_motor;
+	len = _putLong(payload, len, control.getSpiStatsLost(target_motor));
+	payload[len++] = used;
+
+	for (uint8_t slot = 0; slot < used; slot++)
+	{
+		const spiRegisterStats & stats = control.getSpiStats(target_motor, slot);
+
+		payload[len++] = stats.header;
+		len = _putLong(payload, len, stats.transfers);
+		len = _putLong(payload, len, (unsigned long)(stats.totalCycles / CYCLES_PER_US));
+		len = _putLong(payload, len, stats.maxCycles);
+	}
+
+	BLE_App_sys.writeFrame(Serial, payload, len);
+	BLE_App_sys.write(payload, len);
+}
+
+void onResetSpiStats()
+{
+	control.resetSpiStats();
+	onSuccess();
+}
+
+// Format : outputStr = "J,tasks[,slot,interval,runs,skipped,late_min,late_avg,late_max]...;" lateness in ms
+void onGetTaskStats()
+{
+	bool reset = cmdMessenger.readBoolArg();
+
+	outputStr.remove(0);
+	outputStr.concat(F("J,"));
+	outputStr.concat(scheduler.count());
+
+	for (uint8_t slot = 0; slot < SCHEDULER_MAX_TASKS; slot++)
+	{
+		const taskStats * stats = scheduler.statsAt(slot);
+		if (stats == nullptr)
+		{
+			continue;
+		}
+
+		outputStr.concat(F(","));
+		outputStr.concat(slot);
+		outputStr.concat(F(","));
+		outputStr.concat(stats->interval);
+		outputStr.concat(F(","));
+		outputStr.concat(stats->runs);
+		outputStr.concat(F(","));
+		outputStr.concat(stats->skipped);
+		outputStr.concat(F(","));
+		outputStr.concat(stats->lateMin);
+		outputStr.concat(F(","));
+		outputStr.concat((stats->runs == 0) ? 0 : stats->lateTotal / stats->runs);
+		outputStr.concat(F(","));
+		outputStr.concat(stats->lateMax);
+	}
+
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+
+	if (reset)
+	{
+		scheduler.resetStats();
+	}
+}
+
+// Format : not changes to outputStr, G, follows once the calibration is done
+void onStallCalibrate()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	if (_checkFlags(target_motor))
+	{
+		control.EnableMotor(target_motor);
+		motorFlags[target_motor].isCalibrating = true;
+		onSuccess();
+	}
+	else
+	{
+		onFail();
+	}
+}
+
+// Format : outputStr = "G,motor,calibrated,sgt,velocity,sg_free,armed,stall_stops;"
+void onGetStallProfile()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	onStallProfile(target_motor);
+}
+
+// Format : not changes to outputStr
+void onSetStallGuard()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	bool enable = cmdMessenger.readBoolArg();
+	if (control.armStallGuard(target_motor, enable))
+	{
+		onSuccess();
+	}
+	else
+	{
+		onFail();
+	}
+}
+
+// Format : outputStr = "G,motor,calibrated,sgt,velocity,sg_free,armed,stall_stops;"
+void onStallProfile(uint8_t motor)
+{
+	const stallProfile & profile = control.getStallProfile(motor);
+
+	outputStr.remove(0);
+	outputStr.concat(F("G,"));
+	outputStr.concat(motor);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.calibrated);
+	outputStr.concat(F(","));
+	outputStr.concat((int)profile.sgt);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.velocity);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.sgFree);
+	outputStr.concat(F(","));
+	outputStr.concat(control.isStallGuardArmed(motor));
+	outputStr.concat(F(","));
+	outputStr.concat(control.getStallStops(motor));
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : outputStr = "C,motor,position;"
+void onStallStop(uint8_t motor)
+{
+	outputStr.remove(0);
+	outputStr.concat(F("C,"));
+	outputStr.concat(motor);
+	outputStr.concat(F(","));
+	outputStr.concat((signed long)control.getXactual(motor));
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : not changes to outputStr
+void onSetEncoder()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	float countsPerDegree = cmdMessenger.readFloatArg();
+	if (_checkFlags(target_motor))
+	{
+		control.setEncoder(target_motor, countsPerDegree);
+		onSuccess();
+	}
+	else
+	{
+		onFail();
+	}
+}
+
+// Format : outputStr = "E,motor,enabled,xactual,xenc,deviation,max_deviation,corrections;"
+void onGetEncoder()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	const encoderState & encoder = control.getEncoder(target_motor);
+
+	outputStr.remove(0);
+	outputStr.concat(F("E,"));
+	outputStr.concat(target_motor);
+	outputStr.concat(F(","));
+	outputStr.concat(encoder.enabled);
+	outputStr.concat(F(","));
+	outputStr.concat(encoder.xactual);
+	outputStr.concat(F(","));
+	outputStr.concat(encoder.xenc);
+	outputStr.concat(F(","));
+	outputStr.concat(encoder.deviation);
+	outputStr.concat(F(","));
+	outputStr.concat(encoder.maxDeviation);
+	outputStr.concat(F(","));
+	outputStr.concat(encoder.corrections);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : outputStr = "L,motor,deviation;"
+void onLostSteps(uint8_t motor)
+{
+	outputStr.remove(0);
+	outputStr.concat(F("L,"));
+	outputStr.concat(motor);
+	outputStr.concat(F(","));
+	outputStr.concat(control.getEncoder(motor).deviation);
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : not changes to outputStr
+void onSetDriverProfile()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	driverProfile profile;
+	profile.stealthVelocity = (unsigned long)cmdMessenger.readInt32Arg();
+	profile.coolVelocity = (unsigned long)cmdMessenger.readInt32Arg();
+	profile.highVelocity = (unsigned long)cmdMessenger.readInt32Arg();
+	profile.quarterCurrent = cmdMessenger.readBoolArg();
+	profile.enabled = profile.stealthVelocity || profile.coolVelocity || profile.highVelocity;
+	if (_checkFlags(target_motor))
+	{
+		control.setDriverProfile(target_motor, profile);
+		onSuccess();
+	}
+	else
+	{
+		onFail();
+	}
+}
+
+// Format : outputStr = "K,motor,enabled,stealth_velocity,cool_velocity,high_velocity,quarter_current,cs_actual;"
+void onGetDriverProfile()
+{
+	uint8_t target_motor = cmdMessenger.readInt16Arg();
+	const driverProfile & profile = control.getDriverProfile(target_motor);
+
+	outputStr.remove(0);
+	outputStr.concat(F("K,"));
+	outputStr.concat(target_motor);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.enabled);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.stealthVelocity);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.coolVelocity);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.highVelocity);
+	outputStr.concat(F(","));
+	outputStr.concat(profile.quarterCurrent);
+	outputStr.concat(F(","));
+	outputStr.concat(control.getCurrentScale(target_motor));
+	outputStr.concat(F(";"));
+	Serial.println(outputStr);
+	BLE_App_sys.println(outputStr);
+}
+
+// Format : binary, in the frame of the BLE link on both USB and BLE (0x55 0xAA, length, payload, CRC32)
+//          payload = 'H' then the table as packed by profileEncode(), see LoopProfiler.cpp
+void onGetLoopProfile()
+{
+	static uint8_t payload[1 + PROFILE_PAYLOAD_MAX];
+	bool reset = cmdMessenger.readBoolArg();
+
+	payload[0] = 'H';
+	uint16_t len = 1 + profileEncode(payload + 1, sizeof(payload) - 1);
+
+	BLE_App_sys.writeFrame(Serial, payload, len);
+	BLE_App_sys.write(payload, len);
+
+	if (reset)
+	{
+		profileReset();
+	}
+}
@@ -18,6 +18,7 @@
  * CONSTANTS AND DEFINITIONS
  **************************************************************************************************/
 #define JS_SWITCH_CHK (500)
+#define TRACK_PERIOD_MS (500) /* sidereal tracking rate update */
 /***************************************************************************************************
  * PUBLIC FUNCTION PROTOTYPES
  **************************************************************************************************/
@@ -26,9 +27,13 @@ class System_Control_App
 {
       public:
             void Init(void);
-            void ServiceSystemResponseApp(void);
+            void ServiceSystemResponseApp(void);    /* ServiceCommands then ServiceMotors */
+            void ServiceCommands(void);
+            bool ServiceMotors(void);               /* true while it has to run again */
             void ServiceMotor3PowerDisable(void);
+            void ServiceTracking(void);
             uint32_t RequestMotorStatus(uint8_t target_motor);
+            void SetDiagEvents(uint8_t target_motor, bool enable);
             void SendIMUdataFrame(void);
             void SetSysInitstate(uint8_t state);
 };
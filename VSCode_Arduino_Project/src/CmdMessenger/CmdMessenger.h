@@ -40,8 +40,8 @@ extern "C"
 	typedef void(*messengerCallbackFunction) (void);
 }
 
-#define MAXCALLBACKS        50   // The maximum number of commands   (default: 50)
-#define MESSENGERBUFFERSIZE 64   // The length of the commandbuffer  (default: 64)
+#define MAXCALLBACKS        100  // The maximum number of commands   (default: 50)
+#define MESSENGERBUFFERSIZE 255  // The length of the commandbuffer  (default: 64), PVT_UPLOAD carries several points
 #define MAXSTREAMBUFFERSIZE 512  // The length of the streambuffer   (default: 64)
 #define DEFAULT_TIMEOUT     5000 // Time out on unanswered messages. (default: 5s)
 
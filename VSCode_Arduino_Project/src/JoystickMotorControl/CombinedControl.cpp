@@ -31,6 +31,7 @@ void CombinedControl :: begin() {
 	_mirrorMode = 0;
 	_slow_fast = 0; 
 	_mtr3JSControl = true;
+	_tracking = false;
 
 	// Iniializing the motor objects and start it at home position
 	joystick.begin();
@@ -38,6 +39,15 @@ void CombinedControl :: begin() {
   	motor[1].begin();
 	motor[2].begin();
 	
+	// Axes 0 and 1 track in stealthChop and slew on spreadCycle with coolStep
+	driverProfile profile;
+	profile.enabled = true;
+	profile.stealthVelocity = DRV_STEALTH_VELOCITY;
+	profile.coolVelocity = DRV_COOL_VELOCITY;
+	profile.highVelocity = DRV_HIGH_VELOCITY;
+	motor[0].setDriverProfile(profile);
+	motor[1].setDriverProfile(profile);
+
 	setPower(2,MTR3_HOLD_POWER,MTR3_RUN_POWER);
 	setVelocity(2,STAND_MTR3_VELOCITY);
 	setAcceleration(2, MTR3_ACCELERATION);
@@ -146,7 +156,7 @@ void CombinedControl :: enableJoystick()
 					_lastX_Y_vel[axis] = X_Y_AxisVel[axis];
 					CombinedControl :: _setJS(axis, X_Y_AxisVel[axis]);
 					X_Y_RampModeSet[axis] = false;
-					motor[axis].status_standstill = false;
+					motor[axis].snapshot.set(STATUS_BIT_STANDSTILL, false);
 					motor[axis].powerEnable();
 				}
 			}
@@ -156,7 +166,7 @@ void CombinedControl :: enableJoystick()
 				_lastX_Y_vel[axis] = X_Y_AxisVel[axis];
 				CombinedControl :: _setJS(axis, X_Y_AxisVel[axis]);
 				X_Y_RampModeSet[axis] = false;
-				motor[axis].status_standstill = false;
+				motor[axis].snapshot.set(STATUS_BIT_STANDSTILL, false);
 				motor[axis].powerEnable();
 			}
 
@@ -210,47 +220,295 @@ bool CombinedControl :: _timer(unsigned long lastReadTime) {
 
 void CombinedControl :: goPos(uint8_t motor_id, signed long position) 
 {
+	if (CombinedControl :: _checkRange(motor_id, position))
 	{
-		if (motor_id == 0)
-		{	
-			if ((position < -4582400) || (position >= 4608000) ) //Limit range between -179 and 180 degrees
-			{
+		motor[motor_id].goPos(position);
+	}
+}
+
+/* ======================================================================
+	goPos at VMAX velocity instead of the standard one. Returns false if
+	the position is out of range.
+ ====================================================================== */
+
+bool CombinedControl :: goPosAt(uint8_t motor_id, signed long position, unsigned long velocity)
+{
+	if (!CombinedControl :: _checkRange(motor_id, position))
+	{
+		return false;
+	}
+	return motor[motor_id].goPosAt(position, velocity);
+}
+
+/* ======================================================================
+	Passes position in ms at a constant speed and carries on to beyond,
+	where the motor stops unless it is given a new target first. With
+	beyond == position it is a goPos that takes ms. Aiming past the
+	point keeps the ramp from braking into it, a stream of targets runs
+	through without slowing down between them. Speed is clamped to the
+	VMAX limit of the planner, a far point is passed late rather than too
+	fast. Returns false if beyond is out of range.
+ ====================================================================== */
+
+bool CombinedControl :: goPosTimed(uint8_t motor_id, signed long position, unsigned long ms, signed long beyond)
+{
+	signed long xactual = TMC5130::XACTUAL::value::getSigned(motor[motor_id].getXactual());
+
+	// Turning back at position, it is where the motor has to stop
+	if ((beyond - xactual > 0) != (position - xactual > 0) || labs(beyond - xactual) < labs(position - xactual))
+	{
+		beyond = position;
+	}
+	if (!CombinedControl :: _checkRange(motor_id, beyond))
+	{
+		return false;
+	}
+
+	double velocity = labs(position - xactual) * 1000.0 / max(ms, 1UL) * 16777216.0 / TMC5130_FCLK;
+	if (velocity > motor[motor_id].planner.limits.vmax)
+	{
+		velocity = motor[motor_id].planner.limits.vmax;
+	}
+	return motor[motor_id].goPosAt(beyond, lround(ceil(velocity)));
+}
+
+/* ======================================================================
+	Same as goPos but the move (RAMPMODE, AMAX, VMAX, XTARGET) is queued and
+	sent by DMA, so the call returns before it is on the wire. The callback
+	fires once XTARGET has been sent. If the motor's queue is full the move
+	is sent blocking instead (no callback). Returns false if the position is
+	out of range.
+ ====================================================================== */
+
+bool CombinedControl :: queueMove(uint8_t motor_id, signed long position, datagramCallback callback) 
+{
+	if (!CombinedControl :: _checkRange(motor_id, position))
+	{
+		return false;
+	}
+
+	if (!motor[motor_id].queueMove(position, callback))
+	{
+		motor[motor_id].goPos(position);
+	}
+	return true;
+}
+
+/* ======================================================================
+	Moves motors 0 and 1 so both arrive at the same time. The axis with
+	the longer travel runs the nominal goPos ramp, the other one the same
+	ramp with every velocity and acceleration scaled by the ratio of the
+	travels. A ramp scaled by r covers r times the distance in the same
+	time, so both axes settle together. Both XTARGET writes go out back to
+	back once the ramps are programmed. Assumes both axes start from
+	standstill. Returns false if a target is out of range.
+ ====================================================================== */
+
+bool CombinedControl :: goPosSync(signed long position0, signed long position1)
+{
+	if (!CombinedControl :: _checkRange(0, position0) || !CombinedControl :: _checkRange(1, position1))
+	{
+		return false;
+	}
+
+	unsigned long travel0 = labs(position0 - TMC5130::XACTUAL::value::getSigned(motor[0].getXactual()));
+	unsigned long travel1 = labs(position1 - TMC5130::XACTUAL::value::getSigned(motor[1].getXactual()));
+
+	uint8_t leader = (travel0 >= travel1) ? 0 : 1;
+	uint8_t follower = 1 - leader;
+	double ratio = (travel0 == travel1) ? 1.0 : (double)min(travel0, travel1) / (double)max(travel0, travel1);
+
+	rampProfile ramp = motor[leader].nominalRamp();
+	motor[leader].armMove(ramp);
+	motor[follower].armMove(RampPlanner :: scale(ramp, ratio));
+
+	motor[0].setXtarget(position0);
+	motor[1].setXtarget(position1);
+	return true;
+}
+
+/* ======================================================================
+	True once motors 0 and 1 both stand at their targets, from the SPI
+	status byte so polling it costs at most one transfer per axis.
+ ====================================================================== */
+
+bool CombinedControl :: syncMoveDone()
+{
+	CombinedControl :: refreshStatusFlags(0);
+	CombinedControl :: refreshStatusFlags(1);
+
+	return CombinedControl :: atPosition(0) && CombinedControl :: standstill(0) &&
+		   CombinedControl :: atPosition(1) && CombinedControl :: standstill(1);
+}
+
+/* ======================================================================
+	goPos on the ramp the axis planner finds for the distance, see
+	RampPlanner :: plan. Returns false if the position is out of range.
+ ====================================================================== */
+
+bool CombinedControl :: goPosPlanned(uint8_t motor_id, signed long position)
+{
+	if (!CombinedControl :: _checkRange(motor_id, position))
+	{
+		return false;
+	}
+	return motor[motor_id].goPosPlanned(position);
+}
+
+void CombinedControl :: setRampLoad(uint8_t motor_id, uint8_t loadPercent)
+{
+	motor[motor_id].planner.loadPercent = loadPercent;
+}
+
+/* ======================================================================
+	Checks a target position against the travel limits of the axis.
+ ====================================================================== */
+
+bool CombinedControl :: _checkRange(uint8_t motor_id, signed long position) 
+{
+	bool isRangeOk = true;
+
+	if (motor_id == 0)
+	{	
+		if ((position < -4582400) || (position >= 4608000) ) //Limit range between -179 and 180 degrees
+		{
 			Serial.print("Limit range between -179 and 180 degrees exceeded");
-			}
-			else 
-			{
-				motor[motor_id].goPos(position);
-			}
+			isRangeOk = false;
 		}
-		else if (motor_id == 1)
-		{	
-			if ((position < (-4582400/2)) || (position > 2304000) )
-			{
+	}
+	else if (motor_id == 1)
+	{	
+		if ((position < (-4582400/2)) || (position > 2304000) )
+		{
 			Serial.print("Limit range exceeded");
-			}
-			else 
-			{
-				motor[motor_id].goPos(position);
-			}
-		}
-		else 
-		{	
-			motor[motor_id].goPos(position);
+			isRangeOk = false;
 		}
 	}
+	return isRangeOk;
+}
+
+/* ======================================================================
+	Advances the homing sequence of the motor by one step, see
+	MotorControl :: setHome. Call it from the main loop until it returns
+	true, stop() aborts it.
+ ====================================================================== */
+
+bool CombinedControl :: setHome(uint8_t motor_id) {
+	return motor[motor_id].setHome();
+}
+
+/* ======================================================================
+	setHome against the forward hard stop instead of the switch, see
+	MotorControl :: setHomeSensorless. Needs calibrateStall first.
+ ====================================================================== */
+
+bool CombinedControl :: setHomeSensorless(uint8_t motor_id) {
+	return motor[motor_id].setHomeSensorless();
+}
+
+/* ======================================================================
+	Advances the StallGuard calibration of the motor by one step, see
+	MotorControl :: calibrateStall. Call it from the main loop until it
+	returns true, stop() aborts it. The axis moves back and forth a
+	little while it runs.
+ ====================================================================== */
+
+bool CombinedControl :: calibrateStall(uint8_t motor_id) {
+	return motor[motor_id].calibrateStall();
+}
+
+const stallProfile & CombinedControl :: getStallProfile(uint8_t motor_id) {
+	return motor[motor_id].stall;
+}
+
+/* ======================================================================
+	Arms or disarms the hardware stall stop of the motor. Arming fails on
+	an axis that was never calibrated.
+ ====================================================================== */
+
+bool CombinedControl :: armStallGuard(uint8_t motor_id, bool enable) {
+
+	if (enable && !motor[motor_id].stall.calibrated) {
+		return false;
+	}
+	motor[motor_id].armStallGuard(enable);
+	return true;
+}
+
+bool CombinedControl :: isStallGuardArmed(uint8_t motor_id) {
+	return motor[motor_id].stallGuardArmed;
+}
+
+bool CombinedControl :: stallStopped(uint8_t motor_id) {
+	return motor[motor_id].stallStopped();
+}
+
+unsigned long CombinedControl :: getStallStops(uint8_t motor_id) {
+	return motor[motor_id].stallStops;
 }
 
 /* ======================================================================
-	Function sends commands to the motor to return it to the "home" state.
-	Function checks homing device in order and will not complete until all
-	steps have been completed successfully.
+	Encoder support of an axis, see MotorControl :: setEncoder. The axis
+	should be at rest, XENC starts at XACTUAL.
  ====================================================================== */
 
-void CombinedControl :: setHome(uint8_t motor_id) {
-	bool setHome = false;
-	while (!setHome) {
-		setHome = motor[motor_id].setHome();
+void CombinedControl :: setEncoder(uint8_t motor_id, float countsPerDegree) {
+	motor[motor_id].setEncoder(countsPerDegree);
+}
+
+const encoderState & CombinedControl :: getEncoder(uint8_t motor_id) {
+
+	if (motor[motor_id].encoder.enabled) {
+		motor[motor_id].readEncoder();
 	}
+	return motor[motor_id].encoder;
+}
+
+/* ======================================================================
+	Keeps the encoder deviation current and corrects lost steps once a
+	move ends, see MotorControl :: verifyPosition. Call it from the main
+	loop, it does nothing on an axis without an encoder.
+ ====================================================================== */
+
+bool CombinedControl :: verifyPosition(uint8_t motor_id) {
+	return motor[motor_id].verifyPosition();
+}
+
+bool CombinedControl :: hasEncoder(uint8_t motor_id) {
+	return motor[motor_id].encoder.enabled;
+}
+
+bool CombinedControl :: checksPending(uint8_t motor_id) {
+	return motor[motor_id].checksPending();
+}
+
+/* ======================================================================
+	Driver tuning of an axis, see MotorControl :: setDriverProfile.
+	begin() loads the DRV_ profile on axes 0 and 1.
+ ====================================================================== */
+
+void CombinedControl :: setDriverProfile(uint8_t motor_id, const driverProfile & profile) {
+	motor[motor_id].setDriverProfile(profile);
+}
+
+const driverProfile & CombinedControl :: getDriverProfile(uint8_t motor_id) {
+	return motor[motor_id].driver;
+}
+
+uint8_t CombinedControl :: getCurrentScale(uint8_t motor_id) {
+	return motor[motor_id].getCurrentScale();
+}
+
+void CombinedControl :: setCompare(uint8_t motor_id, signed long position) {
+	motor[motor_id].setCompare(position);
+}
+
+void CombinedControl :: setCompareOutput(uint8_t motor_id, bool pushPull) {
+	motor[motor_id].setCompareOutput(pushPull);
+}
+
+void CombinedControl :: setDiag0Events(uint8_t motor_id, bool enable) {
+	motor[motor_id].setDiag0Events(enable);
 }
 
 /* ======================================================================
@@ -297,6 +555,8 @@ void CombinedControl :: constReverse(uint8_t motor_id, unsigned long velocity) {
  ====================================================================== */
 
 void CombinedControl :: stop(uint8_t motor_id) {
+	motor[motor_id].abortHome();
+	motor[motor_id].abortCalibration();
 	motor[motor_id].stop();
 	motor[motor_id].powerDisable();
 }
@@ -350,50 +610,157 @@ bool CombinedControl :: seek(uint8_t motor_id, bool goForward) {
 	return done;
 }
 
-//====================================================================================
-//==================== INFORMATION FUNCTIONS =========================================
-//====================================================================================
+/* ======================================================================
+	Starts tracking the star motors 0 and 1 point at. Like the host, the
+	mount reads motor 1 as altitude and motor 0 as minus the azimuth, at
+	MOTOR_STEPS_PER_DEGREE usteps per degree.
+ ====================================================================== */
+
+void CombinedControl :: startTracking(double latitude)
+{
+	_sky.setLatitude(latitude);
+	_tracking = true;
+	CombinedControl :: syncTracking(TMC5130::XACTUAL::value::getSigned(motor[1].getXactual()) / (double)MOTOR_STEPS_PER_DEGREE,
+									-TMC5130::XACTUAL::value::getSigned(motor[0].getXactual()) / (double)MOTOR_STEPS_PER_DEGREE);
+}
 
 /* ======================================================================
-	Gets the current status of the motor and sends it back as an integer
-	array of 1's and 0's.
+	Re-sync from the host: the tracked star is at altitude/azimuth now.
+	The mount is not jumped there, serviceTracking closes the offset over
+	TRACK_CATCHUP_S on top of the sidereal rates.
  ====================================================================== */
 
-void CombinedControl :: status(uint8_t motor_id, int * statusBits) {
+void CombinedControl :: syncTracking(double altitude, double azimuth)
+{
+	_sky.setTarget(altitude, azimuth, millis());
+	CombinedControl :: serviceTracking();
+}
+
+/* ======================================================================
+	One tracking update, call it every TRACK_PERIOD_MS. Both axes run in
+	velocity mode at the sidereal rate of where the star is now plus the
+	position error over TRACK_CATCHUP_S, so the motion stays smooth and
+	errors from the clock or the last sync die out on their own. Costs
+	one XACTUAL read and at most two writes per axis. Tracking stops with
+	the mount at rest when the star leaves the travel of an axis.
+ ====================================================================== */
 
-	motor[motor_id].readStatus();
+bool CombinedControl :: serviceTracking()
+{
+	if (!_tracking)
+	{
+		return false;
+	}
+
+	double altitude, azimuth, altitudeRate, azimuthRate;
+	_sky.position(millis(), altitude, azimuth);
+	_sky.rates(altitude, azimuth, altitudeRate, azimuthRate);
+
+	signed long x0 = TMC5130::XACTUAL::value::getSigned(motor[0].getXactual());
+	signed long x1 = TMC5130::XACTUAL::value::getSigned(motor[1].getXactual());
+
+	// Azimuth wraps, follow it on the turn closest to where the mount is
+	double mountAzimuth = -x0 / (double)MOTOR_STEPS_PER_DEGREE;
+	azimuth += 360.0 * round((mountAzimuth - azimuth) / 360.0);
+
+	signed long target0 = lround(-azimuth * MOTOR_STEPS_PER_DEGREE);
+	signed long target1 = lround(altitude * MOTOR_STEPS_PER_DEGREE);
+	if (!CombinedControl :: _checkRange(0, target0) || !CombinedControl :: _checkRange(1, target1))
+	{
+		CombinedControl :: stopTracking();
+		return false;
+	}
 
-	statusBits[0] = motor[motor_id].status_sg2;
-	statusBits[1] = motor[motor_id].status_sg2_event;
-	statusBits[2] = motor[motor_id].status_standstill;
+	motor[0].runAt(-azimuthRate * MOTOR_STEPS_PER_DEGREE + (target0 - x0) / TRACK_CATCHUP_S);
+	motor[1].runAt(altitudeRate * MOTOR_STEPS_PER_DEGREE + (target1 - x1) / TRACK_CATCHUP_S);
+	return true;
+}
 
-	statusBits[3] = motor[motor_id].status_velocity_reached;
-	statusBits[4] = motor[motor_id].status_position_reached;
-	statusBits[5] = motor[motor_id].status_position_reached_event;
+void CombinedControl :: stopTracking()
+{
+	_tracking = false;
+	motor[0].runAt(0.0);
+	motor[1].runAt(0.0);
+}
 
-	statusBits[6] = motor[motor_id].status_stop_l;
-	statusBits[7] = motor[motor_id].status_stop_r;
-	statusBits[8] = motor[motor_id].status_stop_l_event;
-	statusBits[9] = motor[motor_id].status_stop_r_event;
-	statusBits[10] = motor[motor_id].status_latch_l;
-	statusBits[11] = motor[motor_id].status_latch_r;
+bool CombinedControl :: isTracking()
+{
+	return _tracking;
+}
 
-	statusBits[12] = motor[motor_id].status_openLoad_A;
-	statusBits[13] = motor[motor_id].status_openLoad_B;
-	statusBits[14] = motor[motor_id].status_shortToGround_A;
-	statusBits[15] = motor[motor_id].status_shortToGround_B;
+void CombinedControl :: setSite(float latitude, float longitude)
+{
+	_site.setSite(latitude, longitude);
+}
 
-	statusBits[16] = motor[motor_id].status_overtemperatureWarning;
-	statusBits[17] = motor[motor_id].status_overtemperatureShutdown;
+void CombinedControl :: setTime(unsigned long unixTime)
+{
+	_site.setTime(unixTime, millis());
+}
+
+/* ======================================================================
+	Slews motors 0 and 1 to a J2000 star with goPosSync. The target is
+	where the star will be when the slew ends, one estimate of the slew
+	time from the nominal ramp is enough at the sidereal rate. Returns
+	false without moving if site or time are missing, the star is below
+	the horizon or out of the travel of an axis.
+ ====================================================================== */
 
-	statusBits[18] = motor[motor_id].status_isReverse;
-	statusBits[19] = motor[motor_id].status_resetDetected;
-	statusBits[20] = motor[motor_id].status_driverError;
-	statusBits[21] = motor[motor_id].status_underVoltage;
+bool CombinedControl :: goRaDec(float rightAscension, float declination)
+{
+	if (!_site.isReady())
+	{
+		return false;
+	}
 
-	statusBits[22] = motor[motor_id].getIsForward();
-	statusBits[23] = motor[motor_id].getIsPositionMode();
-	statusBits[24] = motor[motor_id].getIsHomed();
+	unsigned long now = millis();
+	float altitude, azimuth;
+	signed long position0, position1;
+	_site.toHorizontal(rightAscension, declination, now, altitude, azimuth);
+	CombinedControl :: _horizontalToSteps(altitude, azimuth, position0, position1);
+
+	unsigned long travel0 = labs(position0 - TMC5130::XACTUAL::value::getSigned(motor[0].getXactual()));
+	unsigned long travel1 = labs(position1 - TMC5130::XACTUAL::value::getSigned(motor[1].getXactual()));
+	float slewTime = RampPlanner :: slewTimef(motor[0].nominalRamp(), max(travel0, travel1));
+	_site.toHorizontal(rightAscension, declination, now + (unsigned long)(slewTime * 1000.0f), altitude, azimuth);
+	CombinedControl :: _horizontalToSteps(altitude, azimuth, position0, position1);
+
+	if (altitude < 0.0f)
+	{
+		return false;
+	}
+	return CombinedControl :: goPosSync(position0, position1);
+}
+
+/* ======================================================================
+	Motor 0 and 1 positions of altitude/azimuth, with the host's mapping:
+	motor 1 is the altitude, motor 0 minus the azimuth and azimuths past
+	180 are reached the short way round.
+ ====================================================================== */
+
+void CombinedControl :: _horizontalToSteps(float altitude, float azimuth, signed long & position0, signed long & position1)
+{
+	if (azimuth > 180.0f)
+	{
+		azimuth -= 360.0f;
+	}
+	position0 = lroundf(-azimuth * MOTOR_STEPS_PER_DEGREE);
+	position1 = lroundf(altitude * MOTOR_STEPS_PER_DEGREE);
+}
+
+//====================================================================================
+//==================== INFORMATION FUNCTIONS =========================================
+//====================================================================================
+
+/* ======================================================================
+	Reads the status registers and returns the motor's snapshot. The
+	statusBits word is the 25 bit status the host expects.
+ ====================================================================== */
+
+const MotorSnapshot & CombinedControl :: status(uint8_t motor_id) {
+
+	motor[motor_id].readStatus();
+	return motor[motor_id].snapshot;
 }
 
 /* ======================================================================
@@ -412,12 +779,44 @@ unsigned long  CombinedControl :: sgStatus(uint8_t motor_id) {
 
 bool CombinedControl :: standstill(uint8_t motor_id)
  {
-	return motor[motor_id].status_standstill;
+	return motor[motor_id].snapshot.get(STATUS_BIT_STANDSTILL);
 }
 
 uint8_t CombinedControl :: positionReached(uint8_t motor_id)
  {
-	return motor[motor_id].status_position_reached_event;
+	return motor[motor_id].snapshot.get(STATUS_BIT_POSITION_EVENT);
+}
+
+bool CombinedControl :: atPosition(uint8_t motor_id)
+ {
+	return motor[motor_id].snapshot.get(STATUS_BIT_POSITION_REACHED);
+}
+
+bool CombinedControl :: inRange(uint8_t motor_id, signed long position)
+{
+	return CombinedControl :: _checkRange(motor_id, position);
+}
+
+/* ======================================================================
+	Brings the standstill and position flags up to date from the status
+	byte of recent transfers, costs at most one datagram.
+ ====================================================================== */
+
+void CombinedControl :: refreshStatusFlags(uint8_t motor_id)
+ {
+	motor[motor_id].refreshStatusFlags(STATUS_FLAGS_MAX_AGE_MS);
+}
+
+/* ======================================================================
+	refreshStatusFlags for callers that used to run readStatus(), counts
+	the round trip as saved when no transfer was needed at all.
+ ====================================================================== */
+
+void CombinedControl :: replaceStatusRead(uint8_t motor_id)
+ {
+	if (motor[motor_id].refreshStatusFlags(STATUS_FLAGS_MAX_AGE_MS)) {
+		motor[motor_id].statusReadsSaved++;
+	}
 }
 
 
@@ -427,21 +826,24 @@ uint8_t CombinedControl :: positionReached(uint8_t motor_id)
 
  void CombinedControl :: Setstandstill(uint8_t motor_id, bool state) 
 {
-	motor[motor_id].status_standstill = state;
+	motor[motor_id].snapshot.set(STATUS_BIT_STANDSTILL, state);
 }
 
 /* ======================================================================
-	Returns the actual position of the motor[motor_id].
+	Returns the actual position of the motor[motor_id], signed, within
+	XEST_REPORT_ERROR usteps. Mostly from the estimate, without the bus.
  ====================================================================== */
 
 double CombinedControl :: getXactual(uint8_t motor_id) {
-	double xPos = motor[motor_id].getXactual();
-	if (xPos > 2147483648.0) {
-		Serial.println(xPos);
-		xPos -= 4294967296.0;
-		Serial.println(xPos);
-	}
-	return (xPos);
+	return motor[motor_id].estimateXactual(XEST_REPORT_ERROR);
+}
+
+signed long CombinedControl :: estimateXactual(uint8_t motor_id, unsigned long maxError) {
+	return motor[motor_id].estimateXactual(maxError);
+}
+
+const positionEstimate & CombinedControl :: getEstimate(uint8_t motor_id) {
+	return motor[motor_id].estimate;
 }
 
 /* ======================================================================
@@ -470,6 +872,10 @@ unsigned long CombinedControl :: getDeceleration(uint8_t motor_id) {
 	return motor[motor_id].getDeceleration();
 }
 
+rampProfile CombinedControl :: getRamp(uint8_t motor_id) {
+	return motor[motor_id].nominalRamp();
+}
+
 /* ======================================================================
 	Gets the deceleration from maximum velocity to the stop velocity
 	to the given value.
@@ -479,6 +885,60 @@ unsigned long CombinedControl :: getPower(uint8_t motor_id) {
 	return motor[motor_id].getPowerLevel();
 }
 
+/* ======================================================================
+	Gets the number of SPI datagrams sent to the motor in the last second.
+ ====================================================================== */
+
+unsigned long CombinedControl :: getSpiTransferRate(uint8_t motor_id) {
+	return motor[motor_id].spi.transfersPerSecond();
+}
+
+/* ======================================================================
+	Gets the number of register writes skipped because the register
+	already held the value.
+ ====================================================================== */
+
+unsigned long CombinedControl :: getDroppedWrites(uint8_t motor_id) {
+	return motor[motor_id].droppedWrites;
+}
+
+unsigned long CombinedControl :: getStatusReadsSaved(uint8_t motor_id) {
+	return motor[motor_id].statusReadsSaved;
+}
+
+/* ======================================================================
+	Per register SPI traffic of a motor. Slots 0 to getSpiStatsUsed()-1
+	are filled, in the order the registers were first used.
+ ====================================================================== */
+
+uint8_t CombinedControl :: getSpiStatsUsed(uint8_t motor_id) {
+	return motor[motor_id].spiStatsUsed;
+}
+
+const spiRegisterStats & CombinedControl :: getSpiStats(uint8_t motor_id, uint8_t slot) {
+	return motor[motor_id].spiStats[slot];
+}
+
+unsigned long CombinedControl :: getSpiStatsLost(uint8_t motor_id) {
+	return motor[motor_id].spiStatsLost;
+}
+
+void CombinedControl :: resetSpiStats() {
+
+	for (uint8_t i = 0; i < 3; i++) {
+		motor[i].resetSpiStats();
+	}
+}
+
+/* ======================================================================
+	Times count register reads on the motor's SPI bus, either with the
+	datasheet CSN timing or the old 1ms delays, and returns microseconds.
+ ====================================================================== */
+
+unsigned long CombinedControl :: benchmarkSpi(uint8_t motor_id, unsigned int count, bool legacyTiming) {
+	return motor[motor_id].benchmarkSpi(count, legacyTiming);
+}
+
 //====================================================================================
 //====================== SETTER FUNCTIONS ============================================
 //====================================================================================
@@ -540,30 +1000,17 @@ void CombinedControl :: setResolution(uint8_t motor_id, int resolution) {
 
 /* ======================================================================
 	Changes the position of the motor without moving the motor by resetting
-	the current position to the specified position.
+	the current position to the specified position, in two halves:
+	holdForPosChange stops the motor, setPosNoMove sets the position once
+	it stands. The caller awaits standstill in between.
  ====================================================================== */
 
-void CombinedControl :: changePosNoMove(uint8_t motor_id, unsigned long position) {
+void CombinedControl :: holdForPosChange(uint8_t motor_id) {
 	motor[motor_id].stop(); 							/* stop the motor */
-	motor[motor_id].setRampMode(ADDRESS_MODE_HOLD);		/* set ramp mode to hold */	
-	delay(30);										/* wait for motor to stop */
-	//motor[motor_id].readStatus();						/* wait until motor is at standstill */
-	//unsigned long startTime;
-	//unsigned long lastReadTime;
-	//startTime = millis();
-	// while (motor[motor_id].status_standstill == false) 
-	// {
-	// 	motor[motor_id].readStatus();					/* wait until motor is at standstill */
-
-	// 	lastReadTime = millis();
-	// 	if(startTime - lastReadTime > 100 ) 			/* timeout after 1 second*/
-	// 	{
-	// 		break;
-	// 	}
-
-	// }
-
+	motor[motor_id].setRampMode(ADDRESS_MODE_HOLD);		/* set ramp mode to hold */
+}
 
+void CombinedControl :: setPosNoMove(uint8_t motor_id, unsigned long position) {
 	motor[motor_id].setXactual(position);
 	motor[motor_id].setRampMode(ADDRESS_MODE_POSITION);
 	motor[motor_id].setXtarget(position);
@@ -13,14 +13,19 @@
 #include "System_definitions.h"
 #include "Joystick.h"
 #include "MotorControl.h"
+#include "SkyTracker.h"
+#include "SkyCoordinates.h"
 
 struct flags
 {
 	public:
 		bool isJSEnable 		= false;
 		bool isSeeking			= false;
+		bool isHoming			= false;
 		bool direction			= true;
 		bool isPositioning		= false;
+		bool isCalibrating		= false;
+		bool isSensorless		= false;		// isHoming runs setHomeSensorless
 };
 
 class CombinedControl {
@@ -40,7 +45,15 @@ class CombinedControl {
       //===== MOVE FUNCTIONS =====
 
       void goPos(uint8_t motor_id, signed long position);                                  // brings the motor back to its home position
-      void setHome(uint8_t motor_id);                                                      // sets the home position using the right hand switch
+      bool goPosAt(uint8_t motor_id, signed long position, unsigned long velocity);          // goPos at VMAX velocity, false if out of range
+      bool goPosTimed(uint8_t motor_id, signed long position, unsigned long ms, signed long beyond);  // reaches position in ms, heading on to beyond
+      bool queueMove(uint8_t motor_id, signed long position, datagramCallback callback);   // goPos programmed in the background by DMA
+      bool goPosSync(signed long position0, signed long position1);                         // moves motors 0 and 1 so they arrive together
+      bool syncMoveDone();                                                                  // motors 0 and 1 both stand at their targets
+      bool goPosPlanned(uint8_t motor_id, signed long position);                            // goPos on the fastest ramp within the axis limits
+      void setRampLoad(uint8_t motor_id, uint8_t loadPercent);                              // inertia added to the axis, for goPosPlanned
+      bool setHome(uint8_t motor_id);                                                      // one homing step on the forward switch, true once homed
+      bool setHomeSensorless(uint8_t motor_id);                                            // one homing step against the forward hard stop, true once homed
       void forward(uint8_t motor_id, unsigned long stepsForward, unsigned long velocity);    // push forward at the specified velocity
       void reverse(uint8_t motor_id, unsigned long stepsBackward, unsigned long velocity);   // moves motor in reverse direction
       void constForward(uint8_t motor_id, unsigned long velocity);                           // moves the motor forward constantly
@@ -48,20 +61,78 @@ class CombinedControl {
       void stop(uint8_t motor_id);                                                         // stops the motor when it is in continuous movement
       bool seek(uint8_t motor_id, bool goForward);                                           // goes until a switch as defined by goForward is pressed
 
+      //===== TRACKING FUNCTIONS =====
+
+      void startTracking(double latitude);                                                   // motors 0 and 1 follow the star they point at
+      void syncTracking(double altitude, double azimuth);                                    // the tracked star is at altitude/azimuth now
+      bool serviceTracking();                                                              // recomputes the axis rates, false once tracking stopped
+      void stopTracking();                                                                 // ramps motors 0 and 1 down to rest
+      bool isTracking();
+
+      //===== STALLGUARD FUNCTIONS =====
+
+      bool calibrateStall(uint8_t motor_id);                                               // one StallGuard calibration step, true once done
+      const stallProfile & getStallProfile(uint8_t motor_id);                              // threshold found by the last calibration
+      bool armStallGuard(uint8_t motor_id, bool enable);                                    // hardware stop on a stall, false if not calibrated
+      bool isStallGuardArmed(uint8_t motor_id);
+      bool stallStopped(uint8_t motor_id);                                                 // true once after the guard stopped the motor
+      unsigned long getStallStops(uint8_t motor_id);                                       // stall stops since power up
+
+      //===== ENCODER FUNCTIONS =====
+
+      void setEncoder(uint8_t motor_id, float countsPerDegree);                             // encoder counts per degree of the axis, 0 turns it off
+      const encoderState & getEncoder(uint8_t motor_id);                                   // reads XACTUAL/XENC and returns the deviation state
+      bool verifyPosition(uint8_t motor_id);                                               // true when lost steps were corrected after a move
+      bool hasEncoder(uint8_t motor_id);
+      bool checksPending(uint8_t motor_id);                                                // stall or encoder check due at the end of a move
+
+      //===== DRIVER PROFILE FUNCTIONS =====
+
+      void setDriverProfile(uint8_t motor_id, const driverProfile & profile);               // chopper and coolStep bands, at rest
+      const driverProfile & getDriverProfile(uint8_t motor_id);
+      uint8_t getCurrentScale(uint8_t motor_id);                                           // CS_ACTUAL, the current coolStep runs at
+
+      //===== POSITION COMPARE FUNCTIONS =====
+
+      void setCompare(uint8_t motor_id, signed long position);                              // DIAG1 pulses as the axis runs through position
+      void setCompareOutput(uint8_t motor_id, bool pushPull);                               // DIAG1 push-pull or open collector
+      void setDiag0Events(uint8_t motor_id, bool enable);                                   // DIAG0 low on a driver error or a stall
+
+      //===== SKY FUNCTIONS =====
+
+      void setSite(float latitude, float longitude);                                        // observer location, degrees north and east
+      void setTime(unsigned long unixTime);                                                 // UTC now, seconds since 1970
+      bool goRaDec(float rightAscension, float declination);                                // goPosSync to a J2000 star, ra in hours
+
       //===== INFO FUNCTIONS =====
 
-      void status(uint8_t motor_id, int * statusBits);                                       // returns the status bits of the motor
+      const MotorSnapshot & status(uint8_t motor_id);                                      // reads and returns the status snapshot of the motor
       unsigned long sgStatus(uint8_t motor_id);                                            // returns the stallguard status info
 
       bool standstill(uint8_t motor_id);  
       uint8_t positionReached(uint8_t motor_id);                                                 // checks if the motor is at a standstill
+      bool inRange(uint8_t motor_id, signed long position);                                 // position is within the travel of the axis
+      bool atPosition(uint8_t motor_id);                                                   // XACTUAL == XTARGET, from the SPI status byte
+      void refreshStatusFlags(uint8_t motor_id);                                           // freshens standstill/atPosition without readStatus
+      void replaceStatusRead(uint8_t motor_id);                                            // refreshStatusFlags in place of readStatus, counts the saved ones
       void Setstandstill(uint8_t motor_id, bool state);                                    // sets motor standstill value
 
-      double getXactual(uint8_t motor_id);                                                 // returns the position of the motor
+      double getXactual(uint8_t motor_id);                                                 // returns the position of the motor, within XEST_REPORT_ERROR
+      signed long estimateXactual(uint8_t motor_id, unsigned long maxError);               // position within maxError usteps, the bus only when needed
+      const positionEstimate & getEstimate(uint8_t motor_id);                             // estimator state and read counts
       unsigned long getVelocity(uint8_t motor_id);                                         // returns the vmax speed
       unsigned long getAcceleration(uint8_t motor_id);                                     // returns the amax acceleration
       unsigned long getDeceleration(uint8_t motor_id);                                     // returns the dmax deceleration
+      rampProfile getRamp(uint8_t motor_id);                                               // the ramp goPos moves with
       unsigned long getPower(uint8_t motor_id);                                            // returns the running power
+      unsigned long getSpiTransferRate(uint8_t motor_id);                                  // returns datagrams sent in the last second
+      unsigned long getDroppedWrites(uint8_t motor_id);                                    // returns writes skipped by the register shadow
+      unsigned long getStatusReadsSaved(uint8_t motor_id);                                 // returns readStatus round trips saved by the status byte
+      unsigned long benchmarkSpi(uint8_t motor_id, unsigned int count, bool legacyTiming);   // times count register reads (us)
+      uint8_t getSpiStatsUsed(uint8_t motor_id);                                           // returns the filled per register traffic slots
+      const spiRegisterStats & getSpiStats(uint8_t motor_id, uint8_t slot);                // returns the traffic of one register and direction
+      unsigned long getSpiStatsLost(uint8_t motor_id);                                     // returns transfers no slot was left for
+      void resetSpiStats();                                                                // clears the per register traffic of all motors
 
       //===== SET FUNCTIONS =====
 
@@ -72,7 +143,8 @@ class CombinedControl {
       void setXtarget(uint8_t motor_id, unsigned long position);                             // sets the target position (will move in mode 0)
       void setResolution(uint8_t motor_id, int resolution);                                  // sets the step resolution of the motor
 
-      void changePosNoMove(uint8_t motor_id, unsigned long position);                        // changes the actual position value without moving
+      void holdForPosChange(uint8_t motor_id);                                               // stops the motor ahead of setPosNoMove
+      void setPosNoMove(uint8_t motor_id, unsigned long position);                           // changes the actual position value without moving, once it stands
       void setDirections(uint8_t motor_id, bool forwardDirection, bool forwardSwitch);       // sets the dir of switches and which is the forward dir
       void switchActiveEnable(uint8_t motor_id, bool fw, bool bw);                           // allows the user to change switches active high or low
       void SetSlowFastJoyStick(uint8_t slow_fast);
@@ -93,8 +165,14 @@ class CombinedControl {
       bool _slow_fast;
       bool _mtr3JSControl;
 
+      SkyTracker _sky;
+      SkyCoordinates _site;
+      bool _tracking;
+
 
       void _setJS(uint8_t motor_id, double velocity);
+      bool _checkRange(uint8_t motor_id, signed long position);
+      void _horizontalToSteps(float altitude, float azimuth, signed long & position0, signed long & position1);
       bool _timer(unsigned long lastReadTime);
 };
 
@@ -0,0 +1,44 @@
+#ifndef CycleCounter_H
+
+/* ========================================================================
+   $File: CycleCounter.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Core clock cycle counter for cheap, always-on timing. On the Due it is
+	the Cortex-M3 DWT CYCCNT register (one load per read, 84 cycles per
+	us), the native build counts on the virtual clock and other boards
+	fall back to micros(). The counter wraps after ~51s, the unsigned
+	difference of two reads is right as long as the interval is shorter
+	than that.
+====================================================================== */
+
+#define CycleCounter_H
+#include "Arduino.h"
+
+#define CYCLES_PER_US		(F_CPU / 1000000UL)
+
+// Starts the counter, safe to call more than once
+inline void cycleCounterBegin() {
+#if defined(ARDUINO_ARCH_SAM)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+inline uint32_t cycleCount() {
+#if defined(ARDUINO_ARCH_SAM)
+	return DWT->CYCCNT;
+#elif defined(NATIVE_BUILD)
+	return hal::cycles();
+#else
+	return micros() * CYCLES_PER_US;
+#endif
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include "DatagramQueue.h"
+#include <SPI.h>
+
+/* ======================================================================
+	Per motor datagram queue drained in the background. On the Due every
+	40 bit datagram is clocked out by two DMAC channels (SPI0 TX/RX) and
+	the RX block-complete interrupt releases CS, hands the reply to the
+	callback and starts the next datagram, so the main loop never waits
+	on SPI.transfer. Motors are served round robin, datagrams of one motor
+	keep their order. Off target (no DMAC) the queue is drained
+	synchronously from service().
+====================================================================== */
+
+DatagramQueue datagramQueue;
+
+#if defined(ARDUINO_ARCH_SAM)
+
+// DMAC channels and SPI0 hardware handshaking interfaces (SAM3X datasheet
+// table 22-2)
+#define SPI_DMAC_TX_CH		0
+#define SPI_DMAC_RX_CH		1
+#define SPI_TX_IDX			1
+#define SPI_RX_IDX			2
+
+static void _dmacChannelDisable(uint32_t ch) {
+	DMAC->DMAC_CHDR = DMAC_CHDR_DIS0 << ch;
+}
+
+static void _dmacChannelEnable(uint32_t ch) {
+	DMAC->DMAC_CHER = DMAC_CHER_ENA0 << ch;
+}
+
+extern "C" void DMAC_Handler(void) {
+
+	// Reading EBCISR clears the flags
+	uint32_t status = DMAC->DMAC_EBCISR;
+
+	if (status & (DMAC_EBCISR_BTC0 << SPI_DMAC_RX_CH)) {
+		datagramQueue.onTransferComplete();
+	}
+}
+
+#endif
+
+DatagramQueue :: DatagramQueue() {
+
+	for (uint8_t motor = 0; motor < DATAGRAM_QUEUE_MOTORS; motor++) {
+		_head[motor] = 0;
+		_tail[motor] = 0;
+		statusFlags[motor] = 0;
+		statusTime[motor] = 0;
+		replies[motor] = 0;
+	}
+
+	_activeMotor = -1;
+	_nextMotor = 0;
+	overflows = 0;
+}
+
+/* ======================================================================
+	Enables the DMA controller and the RX block-complete interrupt. SPI
+	must already be started with SPI.begin().
+====================================================================== */
+
+void DatagramQueue :: begin() {
+
+#if defined(ARDUINO_ARCH_SAM)
+	pmc_enable_periph_clk(ID_DMAC);
+
+	DMAC->DMAC_EN &= ~DMAC_EN_ENABLE;
+	DMAC->DMAC_GCFG = DMAC_GCFG_ARB_CFG_FIXED;
+	DMAC->DMAC_EN = DMAC_EN_ENABLE;
+
+	_dmacChannelDisable(SPI_DMAC_TX_CH);
+	_dmacChannelDisable(SPI_DMAC_RX_CH);
+
+	DMAC->DMAC_EBCIER = DMAC_EBCIER_BTC0 << SPI_DMAC_RX_CH;
+	NVIC_EnableIRQ(DMAC_IRQn);
+#endif
+}
+
+/* ======================================================================
+	Adds a datagram to the motor's queue and starts the bus if it is idle.
+	Returns false (and counts an overflow) when the queue is full.
+====================================================================== */
+
+bool DatagramQueue :: enqueue(uint8_t motorID, byte csPin, const datagram * out, datagramCallback callback) {
+
+	uint8_t next = (_head[motorID] + 1) % DATAGRAM_QUEUE_DEPTH;
+
+	if (next == _tail[motorID]) {
+		overflows++;
+		return false;
+	}
+
+	queuedDatagram * entry = &_ring[motorID][_head[motorID]];
+	entry->out = *out;
+	entry->csPin = csPin;
+	entry->callback = callback;
+	_head[motorID] = next;
+
+	noInterrupts();
+	if (_activeMotor < 0) {
+		_startNext();
+	}
+	interrupts();
+
+	return true;
+}
+
+bool DatagramQueue :: isIdle() {
+
+	if (_activeMotor >= 0) {
+		return false;
+	}
+
+	for (uint8_t motor = 0; motor < DATAGRAM_QUEUE_MOTORS; motor++) {
+		if (_head[motor] != _tail[motor]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint8_t DatagramQueue :: freeSlots(uint8_t motorID) {
+	return (DATAGRAM_QUEUE_DEPTH - 1) - ((_head[motorID] - _tail[motorID] + DATAGRAM_QUEUE_DEPTH) % DATAGRAM_QUEUE_DEPTH);
+}
+
+/* ======================================================================
+	Blocks until every queued datagram is on the wire. Blocking SPI users
+	(MotorControl :: sendData) call this first so they never interleave
+	with a DMA transfer.
+====================================================================== */
+
+void DatagramQueue :: flush() {
+
+	while (!isIdle()) {
+		DatagramQueue :: service();
+	}
+}
+
+void DatagramQueue :: service() {
+
+#if defined(ARDUINO_ARCH_SAM)
+	noInterrupts();
+	if (_activeMotor < 0) {
+		_startNext();
+	}
+	interrupts();
+#else
+	while (_activeMotor >= 0) {
+		_finishTransfer();
+	}
+#endif
+}
+
+/* ======================================================================
+	Picks the next motor with pending datagrams, round robin. Must be
+	called with interrupts disabled or from the DMAC interrupt.
+====================================================================== */
+
+void DatagramQueue :: _startNext() {
+
+	for (uint8_t i = 0; i < DATAGRAM_QUEUE_MOTORS; i++) {
+
+		uint8_t motor = (_nextMotor + i) % DATAGRAM_QUEUE_MOTORS;
+
+		if (_head[motor] != _tail[motor]) {
+			_activeMotor = motor;
+			_nextMotor = (motor + 1) % DATAGRAM_QUEUE_MOTORS;
+			_startTransfer(&_ring[motor][_tail[motor]]);
+			return;
+		}
+	}
+	_activeMotor = -1;
+}
+
+void DatagramQueue :: _startTransfer(queuedDatagram * entry) {
+
+	_txBuffer[0] = ((entry->out.rw << 7) | entry->out.address) & 0xff;
+	_txBuffer[1] = (entry->out.data >> 24) & 0xff;
+	_txBuffer[2] = (entry->out.data >> 16) & 0xff;
+	_txBuffer[3] = (entry->out.data >> 8) & 0xff;
+	_txBuffer[4] = (entry->out.data) & 0xff;
+
+	SPI.beginTransaction(TMC5130_SPI_SETTINGS);
+	digitalWrite(entry->csPin, LOW);
+
+#if defined(ARDUINO_ARCH_SAM)
+	// Byte wide DMA writes carry no PCS field, switch to fixed peripheral
+	// select on the channel beginTransaction configured
+	uint32_t channel = BOARD_PIN_TO_SPI_CHANNEL(BOARD_SPI_DEFAULT_SS);
+	SPI0->SPI_MR = SPI_MR_MSTR | SPI_MR_MODFDIS | SPI_MR_PCS(~(1u << channel) & 0xF);
+	(void)SPI0->SPI_RDR;
+
+	_dmacChannelDisable(SPI_DMAC_RX_CH);
+	DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH].DMAC_SADDR = (uint32_t)&SPI0->SPI_RDR;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH].DMAC_DADDR = (uint32_t)_rxBuffer;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH].DMAC_DSCR = 0;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH].DMAC_CTRLA = sizeof(_rxBuffer) |
+		DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH].DMAC_CTRLB = DMAC_CTRLB_SRC_DSCR |
+		DMAC_CTRLB_DST_DSCR | DMAC_CTRLB_FC_PER2MEM_DMA_FC |
+		DMAC_CTRLB_SRC_INCR_FIXED | DMAC_CTRLB_DST_INCR_INCREMENTING;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH].DMAC_CFG = DMAC_CFG_SRC_PER(SPI_RX_IDX) |
+		DMAC_CFG_SRC_H2SEL | DMAC_CFG_SOD | DMAC_CFG_FIFOCFG_ASAP_CFG;
+	_dmacChannelEnable(SPI_DMAC_RX_CH);
+
+	_dmacChannelDisable(SPI_DMAC_TX_CH);
+	DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH].DMAC_SADDR = (uint32_t)_txBuffer;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH].DMAC_DADDR = (uint32_t)&SPI0->SPI_TDR;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH].DMAC_DSCR = 0;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH].DMAC_CTRLA = sizeof(_txBuffer) |
+		DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH].DMAC_CTRLB = DMAC_CTRLB_SRC_DSCR |
+		DMAC_CTRLB_DST_DSCR | DMAC_CTRLB_FC_MEM2PER_DMA_FC |
+		DMAC_CTRLB_SRC_INCR_INCREMENTING | DMAC_CTRLB_DST_INCR_FIXED;
+	DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH].DMAC_CFG = DMAC_CFG_DST_PER(SPI_TX_IDX) |
+		DMAC_CFG_DST_H2SEL | DMAC_CFG_SOD | DMAC_CFG_FIFOCFG_ALAP_CFG;
+	_dmacChannelEnable(SPI_DMAC_TX_CH);
+#else
+	for (uint8_t i = 0; i < sizeof(_txBuffer); i++) {
+		_rxBuffer[i] = SPI.transfer(_txBuffer[i]);
+	}
+#endif
+}
+
+/* ======================================================================
+	Releases CS for the datagram in flight, passes the reply on and
+	starts the next one.
+====================================================================== */
+
+void DatagramQueue :: onTransferComplete() {
+
+	if (_activeMotor < 0) {
+		return;
+	}
+
+#if defined(ARDUINO_ARCH_SAM)
+	// Back to variable peripheral select for blocking SPI.transfer users
+	SPI0->SPI_MR = SPI_MR_MSTR | SPI_MR_PS | SPI_MR_MODFDIS;
+#endif
+
+	_finishTransfer();
+}
+
+void DatagramQueue :: _finishTransfer() {
+
+	uint8_t motor = _activeMotor;
+	queuedDatagram * entry = &_ring[motor][_tail[motor]];
+
+	digitalWrite(entry->csPin, HIGH);
+	SPI.endTransaction();
+
+	datagram reply;
+	reply.rw = entry->out.rw;
+	reply.address = entry->out.address;
+	reply.responseFlags = _rxBuffer[0];
+	reply.data = ((unsigned long)_rxBuffer[1] << 24) | ((unsigned long)_rxBuffer[2] << 16) |
+				 ((unsigned long)_rxBuffer[3] << 8) | (unsigned long)_rxBuffer[4];
+
+	statusFlags[motor] = reply.responseFlags;
+	statusTime[motor] = micros();
+	replies[motor]++;
+
+	datagramCallback callback = entry->callback;
+	_tail[motor] = (_tail[motor] + 1) % DATAGRAM_QUEUE_DEPTH;
+
+	if (callback != nullptr) {
+		callback(motor, &reply);
+	}
+
+	// The call path between CS high and the next CS low is well above the
+	// tCSH minimum, no extra wait needed here
+	_startNext();
+}
@@ -0,0 +1,68 @@
+#ifndef DatagramQueue_H
+
+/* ========================================================================
+   $File: DatagramQueue.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+#define DatagramQueue_H
+#include "System_definitions.h"
+#include "Arduino.h"
+#include "MotorControl.h"
+
+#define DATAGRAM_QUEUE_MOTORS	3
+#define DATAGRAM_QUEUE_DEPTH	16		// datagrams per motor, a full move is 4
+
+struct queuedDatagram {
+	public:
+		datagram out;
+		byte csPin;
+		datagramCallback callback;
+};
+
+class DatagramQueue {
+
+	public:
+
+		DatagramQueue();
+
+		void begin();												// set up the DMA channels
+		bool enqueue(uint8_t motorID, byte csPin, const datagram * out, datagramCallback callback);
+		bool isIdle();												// nothing queued or in flight
+		uint8_t freeSlots(uint8_t motorID);
+		void flush();												// wait until the queue has drained
+		void service();												// restart a stalled queue, drains it off target
+		void onTransferComplete();									// called from the DMAC interrupt
+
+		unsigned long overflows;									// datagrams refused with a full queue
+
+		// SPI_STATUS byte of the last reply per motor, its micros() stamp and
+		// a reply count to spot new ones. Read by MotorControl :: refreshStatusFlags
+		volatile byte statusFlags[DATAGRAM_QUEUE_MOTORS];
+		volatile unsigned long statusTime[DATAGRAM_QUEUE_MOTORS];
+		volatile unsigned long replies[DATAGRAM_QUEUE_MOTORS];
+
+	private:
+
+		queuedDatagram _ring[DATAGRAM_QUEUE_MOTORS][DATAGRAM_QUEUE_DEPTH];
+		volatile uint8_t _head[DATAGRAM_QUEUE_MOTORS];
+		volatile uint8_t _tail[DATAGRAM_QUEUE_MOTORS];
+
+		volatile int8_t _activeMotor;								// motor in flight, -1 when idle
+		uint8_t _nextMotor;											// round robin start point
+
+		uint8_t _txBuffer[5];
+		uint8_t _rxBuffer[5];
+
+		void _startNext();
+		void _startTransfer(queuedDatagram * entry);
+		void _finishTransfer();
+};
+
+extern DatagramQueue datagramQueue;
+
+#endif
@@ -0,0 +1,74 @@
+#include "LoopProfiler.h"
+
+profileEntry profileTable[PROFILE_STAGES];
+
+void profileReset() {
+	memset(profileTable, 0, sizeof(profileTable));
+}
+
+// Unsigned LEB128, 7 bits a byte, low group first. NULL once dst is full.
+static uint8_t * _putVarint(uint8_t * dst, const uint8_t * end, uint64_t value) {
+
+	do {
+		if (dst == NULL || dst >= end) {
+			return NULL;
+		}
+		*dst++ = (uint8_t)((value & 0x7F) | ((value > 0x7F) ? 0x80 : 0));
+		value >>= 7;
+	} while (value != 0);
+
+	return dst;
+}
+
+/* ======================================================================
+	Packs the table: version, number of stages and cycles per us, one
+	byte each, then per stage in profileStage order the count, total and
+	max as varints, the first non empty bucket and the number of buckets
+	up to the last non empty one, one byte each, and their counts as
+	varints. A stage that never ran takes 5 bytes, most take 20 to 40.
+	The table is read while the probes keep booking, a stage can be off
+	by the one run the reply itself is part of.
+ ====================================================================== */
+
+size_t profileEncode(uint8_t * dst, size_t dstLen) {
+
+	const uint8_t * end = dst + dstLen;
+	uint8_t * out = dst;
+
+	if (dstLen < 3) {
+		return 0;
+	}
+	*out++ = PROFILE_VERSION;
+	*out++ = PROFILE_STAGES;
+	*out++ = (uint8_t)CYCLES_PER_US;
+
+	for (uint8_t stage = 0; stage < PROFILE_STAGES; stage++) {
+		const profileEntry & entry = profileTable[stage];
+		uint8_t first = 0;
+		uint8_t last = PROFILE_BUCKETS;
+
+		while (first < PROFILE_BUCKETS && entry.buckets[first] == 0) {
+			first++;
+		}
+		while (last > first && entry.buckets[last - 1] == 0) {
+			last--;
+		}
+
+		out = _putVarint(out, end, entry.count);
+		out = _putVarint(out, end, entry.total);
+		out = _putVarint(out, end, entry.max);
+		if (out == NULL || end - out < 2) {
+			return 0;
+		}
+		*out++ = (first < last) ? first : 0;
+		*out++ = last - first;
+		for (uint8_t bucket = first; bucket < last; bucket++) {
+			out = _putVarint(out, end, entry.buckets[bucket]);
+		}
+		if (out == NULL) {
+			return 0;
+		}
+	}
+
+	return out - dst;
+}
@@ -0,0 +1,92 @@
+#ifndef LoopProfiler_H
+
+/* ========================================================================
+   $File: LoopProfiler.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Always-on execution profile of the main loop stages and the scheduled
+	tasks, in core clock cycles (see CycleCounter.h). A probe is one
+	counter read and a few adds into a static table: the count, the total,
+	the longest run and a log2 histogram, bucket b counts the runs of
+	2^b to 2^(b+1)-1 cycles. profileEncode() packs the table for the
+	GET_LOOP_PROFILE reply.
+
+	Probes nest, a stage includes the stages that run inside it (the
+	scheduler includes its tasks). Runs longer than the counter wraps
+	(~51s) are booked short.
+====================================================================== */
+
+#define LoopProfiler_H
+#include "Arduino.h"
+#include "CycleCounter.h"
+
+#define PROFILE_BUCKETS			32
+#define PROFILE_VERSION			1
+
+// Worst case profileEncode() size, every varint at its longest
+#define PROFILE_PAYLOAD_MAX		(3 + PROFILE_STAGES * (5 + 10 + 5 + 2 + PROFILE_BUCKETS * 5))
+
+// What the probes time, the order is the one of the reply
+enum profileStage {
+	PROFILE_SYSTEM_RESPONSE,						// ServiceCommands, USB commands
+	PROFILE_BLE_UART,								// Service_BLE_UART, BLE commands
+	PROFILE_SCHEDULER,								// scheduler.loop(), the tasks below included
+	PROFILE_MTR3_POWER,
+	PROFILE_IMU,
+	PROFILE_LED,
+	PROFILE_JS_SWITCH,
+	PROFILE_TRACKING,
+	PROFILE_MOTORS,									// ServiceMotors, background operations and checks
+	PROFILE_IMU_FRAME,								// IMU frame handler
+	PROFILE_SLEEP,									// idle test and WFI
+	PROFILE_STAGES
+};
+
+struct profileEntry {
+	uint32_t count;
+	uint64_t total;									// cycles
+	uint32_t max;
+	uint32_t buckets[PROFILE_BUCKETS];
+};
+
+extern profileEntry profileTable[PROFILE_STAGES];
+
+// Books the cycles since start to stage and returns now, the start of the next stage
+inline uint32_t profileLap(profileStage stage, uint32_t start) {
+	uint32_t now = cycleCount();
+	uint32_t cycles = now - start;
+	profileEntry & entry = profileTable[stage];
+
+	entry.count++;
+	entry.total += cycles;
+	if (cycles > entry.max) {
+		entry.max = cycles;
+	}
+	entry.buckets[31 - __builtin_clz(cycles | 1)]++;
+	return now;
+}
+
+// Times the scope it is declared in
+class ProfileScope {
+
+	public:
+
+		explicit ProfileScope(profileStage stage) : _stage(stage), _start(cycleCount()) {}
+		~ProfileScope() { profileLap(_stage, _start); }
+
+	private:
+
+		profileStage _stage;
+		uint32_t _start;
+};
+
+void profileReset();
+size_t profileEncode(uint8_t * dst, size_t dstLen);		// bytes written, 0 if dstLen is too short
+
+#endif
@@ -1,8 +1,28 @@
 #include "MotorControl.h"
+#include "DatagramQueue.h"
 
 byte WRITE = 0x01;
 byte READ = 0x00; 
 
+// TMC5130 uses SPI MODE 3, MSB first (datasheet chp. 4)
+const SPISettings TMC5130_SPI_SETTINGS(TMC5130_SPI_CLOCK, MSBFIRST, SPI_MODE3);
+
+// Power up register values
+static constexpr uint32_t CHOPCONF_DEFAULT = TMC5130::CHOPCONF::TOFF::of<5>() | TMC5130::CHOPCONF::HSTRT::of<5>() |
+											 TMC5130::CHOPCONF::HEND::of<3>() | TMC5130::CHOPCONF::TBL::of<2>();
+static constexpr uint32_t IHOLDDELAY_DEFAULT = TMC5130::IHOLD_IRUN::IHOLDDELAY::of<7>();
+static constexpr uint32_t IHOLD_IRUN_DEFAULT = TMC5130::IHOLD_IRUN::IHOLD::of<15>() | TMC5130::IHOLD_IRUN::IRUN::of<20>() |
+											   IHOLDDELAY_DEFAULT;
+
+// stealthChop with automatic current scaling, loaded when a driver profile uses it
+static constexpr uint32_t PWMCONF_STEALTH = TMC5130::PWMCONF::PWM_AMPL::of<0x80>() | TMC5130::PWMCONF::PWM_GRAD::of<0x04>() |
+											TMC5130::PWMCONF::pwm_freq::of<1>() | TMC5130::PWMCONF::pwm_autoscale::of<1>() |
+											TMC5130::PWMCONF::freewheel::of<1>();
+
+// Same words the driver was tuned with before the register map existed
+static_assert(CHOPCONF_DEFAULT == 0x000101D5UL, "CHOPCONF power up value changed");
+static_assert(IHOLD_IRUN_DEFAULT == 0x0007140FUL, "IHOLD_IRUN power up value changed");
+
 /* ======================================================================
 	Constructor functiona to make a motor object. Requires the Chip Select (cs)
 	pin, the enable output pin, and the motor ID as inputs. Note that the pins
@@ -21,6 +41,28 @@ MotorControl :: MotorControl() {
 	IsPositionMode = true;
 	IsForward = true;
 
+	droppedWrites = 0;
+	MotorControl :: _invalidateShadow();
+
+	statusFlagsTime = 0;
+	statusReadsSaved = 0;
+	_statusFlagsValid = false;
+	_queueReplies = 0;
+	_queueReplyMark = 0;
+
+	MotorControl :: resetSpiStats();
+	_rampScaled = false;
+
+	_stallCaseNum = 0;
+	_stallChecked = false;
+	_stallVelocity = 0;
+	stallGuardArmed = false;
+	stallStops = 0;
+
+	_encoderChecked = false;
+	_encoderTarget = 0;
+	_encoderTime = 0;
+
 	// change so there's only one const and step function instead and deal with in structure
 
 	// Initialize directional structures
@@ -42,14 +84,14 @@ MotorControl :: MotorControl() {
 	 
 	CHOPCONF.rw   = WRITE;
 	CHOPCONF.address = ADDRESS_CHOPCONF;
-	CHOPCONF.data   = 0x000101D5;//TBL=10, HEND = 11, HSTRT=101, TOFF = 0101, CHM=0 (SpreadCycle
+	CHOPCONF.data   = CHOPCONF_DEFAULT;//TBL=10, HEND = 11, HSTRT=101, TOFF = 0101, CHM=0 (SpreadCycle
 	 
 	IHOLD_IRUN.rw= WRITE;
 	IHOLD_IRUN.address = ADDRESS_IHOLD_IRUN;
-	IHOLD_IRUN.data= 0x0007140F;   //IHOLD_IRUN: IHOLD=15, IRUN=20 (max.current), IHOLDDELAY=7
+	IHOLD_IRUN.data= IHOLD_IRUN_DEFAULT;   //IHOLD_IRUN: IHOLD=15, IRUN=20 (max.current), IHOLDDELAY=7
 	 
 	TPOWERDOWN.rw  = WRITE;
-	TPOWERDOWN.address= ADDRESS_TZEROWAIT;
+	TPOWERDOWN.address= ADDRESS_TPOWERDOWN;
 	TPOWERDOWN.data  = 0x0000000A;//TPOWERDOWN=10: Delay before power down in stand still
 	 
 	PWMCONF.rw   = WRITE;
@@ -105,6 +147,24 @@ MotorControl :: MotorControl() {
 	SW_MODE.address 			= ADDRESS_SWMODE;
 	SW_MODE.data 				= 0x00000002;
 
+	// SGT 0 and TCOOLTHRS 0 (StallGuard never flags) until calibrateStall
+	COOLCONF.rw 				= WRITE;
+	COOLCONF.address 			= ADDRESS_COOLCONF;
+	COOLCONF.data 				= 0x00000000;
+
+	TCOOLTHRS.rw 				= WRITE;
+	TCOOLTHRS.address 			= ADDRESS_TCOOLTHRS;
+	TCOOLTHRS.data 				= 0x00000000;
+
+	// No stealthChop and no high speed band until setDriverProfile
+	TPWMTHRS.rw 				= WRITE;
+	TPWMTHRS.address 			= ADDRESS_TPWMTHRS;
+	TPWMTHRS.data 				= 0x00000000;
+
+	THIGH.rw 					= WRITE;
+	THIGH.address 				= ADDRESS_THIGH;
+	THIGH.data 					= 0x00000000;
+
 	// Reading to Registers
 	DRV_STATUS_READ.rw 			= READ;
 	DRV_STATUS_READ.address 	= ADDRESS_DRVSTATUS;
@@ -164,6 +224,28 @@ MotorControl :: MotorControl(byte csPin, byte enablePin, int ID) {
 	IsPositionMode = true;
 	IsForward = true;
 
+	droppedWrites = 0;
+	MotorControl :: _invalidateShadow();
+
+	statusFlagsTime = 0;
+	statusReadsSaved = 0;
+	_statusFlagsValid = false;
+	_queueReplies = 0;
+	_queueReplyMark = 0;
+
+	MotorControl :: resetSpiStats();
+	_rampScaled = false;
+
+	_stallCaseNum = 0;
+	_stallChecked = false;
+	_stallVelocity = 0;
+	stallGuardArmed = false;
+	stallStops = 0;
+
+	_encoderChecked = false;
+	_encoderTarget = 0;
+	_encoderTime = 0;
+
 	// Initialize directional structures
 	forwardDirection.activeEnableNum 	= 3;
 	forwardDirection.buttonStatusNum 	= 1;
@@ -179,6 +261,7 @@ MotorControl :: MotorControl(byte csPin, byte enablePin, int ID) {
 	//start automatically with pin not connected (active LOW)
 	_csPin = csPin;
 	_enablePin = enablePin;
+	spi.csPin = csPin;
 
 	digitalWrite(csPin, HIGH);
 	digitalWrite(enablePin, HIGH);
@@ -190,19 +273,19 @@ MotorControl :: MotorControl(byte csPin, byte enablePin, int ID) {
 
 	CHOPCONF.rw 				= WRITE;
 	CHOPCONF.address 			= ADDRESS_CHOPCONF;
-	CHOPCONF.data 				= 0x000101D5;
+	CHOPCONF.data 				= CHOPCONF_DEFAULT;
 
 	IHOLD_IRUN.rw 				= WRITE;
 	IHOLD_IRUN.address			= ADDRESS_IHOLD_IRUN;
-	IHOLD_IRUN.data 			= 0x0000190A;
+	IHOLD_IRUN.data 			= TMC5130::IHOLD_IRUN::IHOLD::of<10>() | TMC5130::IHOLD_IRUN::IRUN::of<25>();
 
 	TPOWERDOWN.rw 				= WRITE;
-	TPOWERDOWN.address 			= ADDRESS_TZEROWAIT;
+	TPOWERDOWN.address 			= ADDRESS_TPOWERDOWN;
 	TPOWERDOWN.data 			= 0x0000000A;
 
 	PWMCONF.rw 					= WRITE;
 	PWMCONF.address 			= ADDRESS_PWMCONF;
-	PWMCONF.data 				= 0x00150480;
+	PWMCONF.data 				= PWMCONF_STEALTH;
 
 	A1.rw 						= WRITE;
 	A1.address 					= ADDRESS_A1;
@@ -252,6 +335,24 @@ MotorControl :: MotorControl(byte csPin, byte enablePin, int ID) {
 	SW_MODE.address 			= ADDRESS_SWMODE;
 	SW_MODE.data 				= 0x00000002;
 
+	// SGT 0 and TCOOLTHRS 0 (StallGuard never flags) until calibrateStall
+	COOLCONF.rw 				= WRITE;
+	COOLCONF.address 			= ADDRESS_COOLCONF;
+	COOLCONF.data 				= 0x00000000;
+
+	TCOOLTHRS.rw 				= WRITE;
+	TCOOLTHRS.address 			= ADDRESS_TCOOLTHRS;
+	TCOOLTHRS.data 				= 0x00000000;
+
+	// No stealthChop and no high speed band until setDriverProfile
+	TPWMTHRS.rw 				= WRITE;
+	TPWMTHRS.address 			= ADDRESS_TPWMTHRS;
+	TPWMTHRS.data 				= 0x00000000;
+
+	THIGH.rw 					= WRITE;
+	THIGH.address 				= ADDRESS_THIGH;
+	THIGH.data 					= 0x00000000;
+
 	// Reading to Registers
 	DRV_STATUS_READ.rw 			= READ;
 	DRV_STATUS_READ.address 	= ADDRESS_DRVSTATUS;
@@ -303,6 +404,7 @@ void MotorControl :: set(byte csPin, byte enablePin, int ID) {
 	// start automatically with pin not connected (active LOW)
 	_csPin = csPin;
 	_enablePin = enablePin;
+	spi.csPin = csPin;
 }
 
 /* ======================================================================
@@ -320,6 +422,12 @@ void MotorControl :: begin() {
 	// Turn on the enable pin to talk to the motor
 	MotorControl :: powerEnable();
 
+	// Nothing is known about the chip yet, send every register
+	MotorControl :: _invalidateShadow();
+
+	// Times every transfer for spiStats
+	cycleCounterBegin();
+
 	MotorControl::sendData(&GCONF);
   MotorControl::sendData(&CHOPCONF);
 	MotorControl::sendData(&IHOLD_IRUN);
@@ -337,11 +445,21 @@ void MotorControl :: begin() {
 	MotorControl::sendData(&VMAX);
 
 	MotorControl::sendData(&VSTOP);
+
+	MotorControl::sendData(&COOLCONF);
+	MotorControl::sendData(&TCOOLTHRS);
+	MotorControl::sendData(&TPWMTHRS);
+	MotorControl::sendData(&THIGH);
 	
   MotorControl::sendData(&RAMPMODE);
 
 	MotorControl::sendData(&XACTUAL);
 	MotorControl::sendData(&XTARGET);
+	estimate.valid = false;
+
+	// GSTAT clears on read, from here on the reset flag in the SPI_STATUS
+	// byte only marks a real chip reset
+	MotorControl::readRegister(ADDRESS_GSTAT);
   	
 	#ifdef DEBUG_MOTOR
 	Serial.print(motorID);
@@ -368,8 +486,18 @@ void MotorControl :: begin() {
 void MotorControl :: sendData(datagram * out_datagram) {
 	//TMC5130 takes 40 bit data: 8 address and 32 data, first bit determines read(0) or write(1)
 
-	// Re-write this function 
-	delayMicroseconds(3);
+	MotorControl::_estimateWrite(out_datagram);
+
+	if (MotorControl::_isRedundantWrite(out_datagram)) {
+		return;
+	}
+	MotorControl::_commitShadow(out_datagram);
+
+	// Let queued datagrams go out first so the order on the wire is kept
+	datagramQueue.flush();
+
+	unsigned long startCycles = cycleCount();
+
 	MotorControl::csEnable();
 
 	i_datagram.responseFlags = SPI.transfer(((out_datagram->rw << 7) | out_datagram->address) & 0xff);
@@ -384,6 +512,16 @@ void MotorControl :: sendData(datagram * out_datagram) {
 	
 	MotorControl::csDisable();
 
+	MotorControl::_countTransfer(((out_datagram->rw << 7) | out_datagram->address) & 0xff, cycleCount() - startCycles);
+	MotorControl::_harvestStatus(i_datagram.responseFlags, micros());
+
+	// The reply predates the write, after a motion write the flags are stale
+	if (out_datagram->rw == WRITE && MotorControl::_affectsMotion(out_datagram->address)) {
+		_statusFlagsValid = false;
+		_stallChecked = false;
+		_encoderChecked = false;
+	}
+
 	_outputDatagram = i_datagram;
 
 	#ifdef DEBUG_MOTOR
@@ -396,6 +534,227 @@ void MotorControl :: sendData(datagram * out_datagram) {
 	#endif
 }
 
+/* ======================================================================
+	Every reply starts with the SPI_STATUS byte, a free copy of the GSTAT
+	reset/drv_err flags, the DRV_STATUS sg2/stst bits and the RAMP_STAT
+	velocity/position reached and stop switch bits. It is decoded into the
+	status model on every transfer so callers only need readStatus() for
+	the latched events, load and temperature flags.
+ ====================================================================== */
+
+void MotorControl :: _harvestStatus(byte flags, unsigned long stamp) {
+
+	snapshot.spiStatus = flags;
+	statusFlagsTime = stamp;
+	_statusFlagsValid = true;
+
+	snapshot.set(STATUS_BIT_RESET, flags & SPI_STATUS_RESET_FLAG);
+	snapshot.set(STATUS_BIT_DRIVER_ERROR, flags & SPI_STATUS_DRIVER_ERROR);
+	snapshot.set(STATUS_BIT_SG2, flags & SPI_STATUS_SG2);
+	snapshot.set(STATUS_BIT_STANDSTILL, flags & SPI_STATUS_STANDSTILL);
+	snapshot.set(STATUS_BIT_VELOCITY_REACHED, flags & SPI_STATUS_VELOCITY_REACHED);
+	snapshot.set(STATUS_BIT_POSITION_REACHED, flags & SPI_STATUS_POSITION_REACHED);
+	snapshot.set(STATUS_BIT_STOP_L, flags & SPI_STATUS_STOP_L);
+	snapshot.set(STATUS_BIT_STOP_R, flags & SPI_STATUS_STOP_R);
+
+	// The reset flag stays up until GSTAT is read, keep the shadow empty
+	// until then
+	if (flags & SPI_STATUS_RESET_FLAG) {
+		MotorControl :: _invalidateShadow();
+		estimate.valid = false;
+	}
+}
+
+/* ======================================================================
+	Makes the harvested flags at most maxAgeMs old. Replies of queued
+	datagrams are picked up first, if the flags are still too old a single
+	GCONF read refreshes them (1 transfer instead of readStatus()'s 7).
+ ====================================================================== */
+
+bool MotorControl :: refreshStatusFlags(unsigned long maxAgeMs) {
+
+	noInterrupts();
+	unsigned long replies = datagramQueue.replies[motorID];
+	byte queueFlags = datagramQueue.statusFlags[motorID];
+	unsigned long queueTime = datagramQueue.statusTime[motorID];
+	interrupts();
+
+	if (replies != _queueReplies) {
+		_queueReplies = replies;
+		bool afterMark = (long)(replies - _queueReplyMark) > 0;
+		if (afterMark && (!_statusFlagsValid || (long)(queueTime - statusFlagsTime) > 0)) {
+			MotorControl::_harvestStatus(queueFlags, queueTime);
+		}
+	}
+
+	if (_statusFlagsValid && (micros() - statusFlagsTime) <= maxAgeMs * 1000UL) {
+		return true;
+	}
+
+	// GCONF, not GSTAT: reading GSTAT would clear the reset flag
+	MotorControl::sendData(&GCONF_READ);
+	return false;
+}
+
+/* ======================================================================
+	Queues the datagram for the DMA driven transfer and returns at once.
+	The callback gets the reply once it has been clocked in; on the Due it
+	runs in interrupt context. Returns false if the motor's queue is full.
+	A datagram with a callback always goes out, even as a redundant write,
+	so the callback fires. The shadow only takes writes that were queued.
+ ====================================================================== */
+
+bool MotorControl :: queueData(datagram * out, datagramCallback callback) {
+
+	MotorControl::_estimateWrite(out);
+
+	if (callback == nullptr && MotorControl::_isRedundantWrite(out)) {
+		return true;
+	}
+
+	if (!datagramQueue.enqueue(motorID, _csPin, out, callback)) {
+		return false;
+	}
+	MotorControl::_commitShadow(out);
+
+	// Replies up to and including this write's carry pre-move flags
+	if (out->rw == WRITE && MotorControl::_affectsMotion(out->address)) {
+		_stallChecked = false;
+		_encoderChecked = false;
+		noInterrupts();
+		_queueReplyMark = datagramQueue.replies[motorID] + (DATAGRAM_QUEUE_DEPTH - 1 - datagramQueue.freeSlots(motorID));
+		interrupts();
+		_statusFlagsValid = false;
+	}
+	return true;
+}
+
+bool MotorControl :: _affectsMotion(byte address) {
+
+	return (address == ADDRESS_XTARGET) || (address == ADDRESS_XACTUAL) ||
+		   (address == ADDRESS_RAMPMODE) || (address == ADDRESS_VMAX);
+}
+
+/* ======================================================================
+	Write-through shadow of the registers. A write of the value the register
+	already holds is dropped and counted in droppedWrites. Registers the chip
+	changes on its own (XACTUAL, XENC) or that clear on write (GSTAT,
+	RAMP_STAT, ENC_STATUS) are never shadowed. The shadow is invalidated by
+	begin() and whenever a chip reset is seen. _isRedundantWrite only
+	tests, _commitShadow records the value once the write is on its way.
+====================================================================== */
+
+bool MotorControl :: _isShadowed(datagram * out) {
+
+	if (out->rw != WRITE) {
+		return false;
+	}
+
+	switch (out->address) {
+		case ADDRESS_XACTUAL:
+		case ADDRESS_XENC:
+		case ADDRESS_GSTAT:
+		case ADDRESS_RAMPSTAT:
+		case ADDRESS_ENC_STATUS:
+			return false;
+	}
+	return true;
+}
+
+bool MotorControl :: _isRedundantWrite(datagram * out) {
+
+	if (!MotorControl::_isShadowed(out)) {
+		return false;
+	}
+
+	byte address = out->address & (TMC5130_REGISTER_COUNT - 1);
+	unsigned long validBit = 1UL << (address & 31);
+
+	if ((_shadowValid[address >> 5] & validBit) && (_shadow[address] == out->data)) {
+		droppedWrites++;
+		return true;
+	}
+	return false;
+}
+
+void MotorControl :: _commitShadow(datagram * out) {
+
+	if (!MotorControl::_isShadowed(out)) {
+		return;
+	}
+
+	byte address = out->address & (TMC5130_REGISTER_COUNT - 1);
+
+	_shadow[address] = out->data;
+	_shadowValid[address >> 5] |= 1UL << (address & 31);
+}
+
+void MotorControl :: _invalidateShadow() {
+
+	for (uint8_t i = 0; i < TMC5130_REGISTER_COUNT / 32; i++) {
+		_shadowValid[i] = 0;
+	}
+}
+
+/* ======================================================================
+	Times count GCONF reads with either the transaction timing or the
+	old 1ms CS delays and returns the elapsed microseconds. GCONF, not
+	GSTAT, which clears its reset and error flags on every read.
+	Used to compare both paths on the real bus.
+ ====================================================================== */
+
+unsigned long MotorControl :: benchmarkSpi(unsigned int count, bool legacyTiming) {
+
+	spi.legacyTiming = legacyTiming;
+
+	unsigned long start = micros();
+	for (unsigned int i = 0; i < count; i++) {
+		MotorControl :: sendData(&GCONF_READ);
+	}
+	unsigned long elapsed = micros() - start;
+
+	spi.legacyTiming = false;
+	return elapsed;
+}
+
+/* ======================================================================
+	Adds one sendData() transfer to the traffic of its register and
+	direction. Pairs get a slot on first use, the header byte indexes
+	_spiStatsSlot so the cost is the same for every transfer.
+ ====================================================================== */
+
+void MotorControl :: _countTransfer(byte header, unsigned long cycles) {
+
+	byte slot = _spiStatsSlot[header];
+
+	if (slot == 0) {
+		if (spiStatsUsed >= SPI_STATS_SLOTS) {
+			spiStatsLost++;
+			return;
+		}
+		spiStats[spiStatsUsed].header = header;
+		slot = ++spiStatsUsed;
+		_spiStatsSlot[header] = slot;
+	}
+
+	spiRegisterStats * stats = &spiStats[slot - 1];
+	stats->transfers++;
+	stats->totalCycles += cycles;
+	if (cycles > stats->maxCycles) {
+		stats->maxCycles = cycles;
+	}
+}
+
+void MotorControl :: resetSpiStats() {
+
+	for (uint8_t i = 0; i < SPI_STATS_SLOTS; i++) {
+		spiStats[i] = spiRegisterStats();
+	}
+	memset(_spiStatsSlot, 0, sizeof(_spiStatsSlot));
+	spiStatsUsed = 0;
+	spiStatsLost = 0;
+}
+
 /* ======================================================================
 	Function gets and prints the main motor data. Used for debugging.
  ====================================================================== */
@@ -435,112 +794,132 @@ void MotorControl :: getMotorData() {
 }
 
 
+/* ======================================================================
+	Reads a batch of registers. The TMC5130 answers every datagram with the
+	data requested by the previous one (datasheet chp. 4.1), so the read of
+	addresses[i] is sent with transfer i and its value arrives with transfer
+	i+1. count registers take count+1 transfers; the trailing transfer is a
+	GCONF read, which has no side effects.
+====================================================================== */
+
+void MotorControl :: readRegisters(const byte * addresses, unsigned long * values, uint8_t count) {
+
+	datagram request;
+	request.rw = READ;
+	request.data = 0x00000000;
+
+	for (uint8_t i = 0; i <= count; i++) {
+
+		request.address = (i < count) ? addresses[i] : ADDRESS_GCONF;
+		MotorControl::sendData(&request);
+
+		// Reply to transfer i belongs to the read sent with transfer i-1
+		if (i > 0) {
+			values[i - 1] = i_datagram.data;
+		}
+	}
+}
+
+/* ======================================================================
+	Write only registers (IHOLD_IRUN, AMAX, DMAX, ...) read back as 0 on
+	the chip, their value comes from the shadow instead. Used by
+	readRegister<REG>(), which picks the path at compile time.
+ ====================================================================== */
+
+unsigned long MotorControl :: _shadowValue(byte address) {
+
+	if (_shadowValid[address >> 5] & (1UL << (address & 31))) {
+		return _shadow[address];
+	}
+	return 0;
+}
+
+unsigned long MotorControl :: readRegister(byte address) {
+
+	unsigned long value = 0;
+	MotorControl::readRegisters(&address, &value, 1);
+	return value;
+}
+
 /* ======================================================================
 	Function finds the status of all the registers of the motor. See chapter
 	6 of the datasheet for specific register and bit numbers.
  ====================================================================== */
 
 void MotorControl :: readStatus() {
-    status_sg2 = false;
-    status_standstill = false;
-    status_velocity_reached = false;
-    status_position_reached = false;
-    status_stop_l = false;
-    status_stop_r = false;   
-
-    //pipeline flush
-    MotorControl::sendData( & RAMP_STAT_READ);
-    MotorControl::sendData( & RAMP_STAT_READ);
-	MotorControl::sendData( & RAMP_STAT_READ);
-	
-    MotorControl::sendData( & DRV_STATUS_READ);
+
+	static const byte statusRegisters[6] = {ADDRESS_RAMPSTAT, ADDRESS_DRVSTATUS, ADDRESS_GCONF,
+											ADDRESS_GSTAT, ADDRESS_XACTUAL, ADDRESS_VACTUAL};
+	unsigned long values[6];
+
+	MotorControl::readRegisters(statusRegisters, values, 6);
+
+	snapshot.time = micros();
+	snapshot.rampStat = values[0];
+	snapshot.drvStatus = values[1];
+	snapshot.gstat = values[3] & 0xff;
+	snapshot.xactual = values[4];
+	snapshot.vactual = values[5];
+
+	uint32_t bits = 0;
+	using namespace TMC5130;
+
 	// Flags for the RAMP_STAT register
-    status_stop_l = MotorControl::_checkBit( & _outputDatagram,0);
-    status_stop_r = MotorControl::_checkBit( & _outputDatagram,1);
-	status_stop_l_event = MotorControl::_checkBit( & _outputDatagram,4);
-	status_stop_r_event = MotorControl::_checkBit( & _outputDatagram,5);
-	status_latch_l = MotorControl::_checkBit( & _outputDatagram,2);
-	status_latch_r = MotorControl::_checkBit( & _outputDatagram,3);
-    status_position_reached = MotorControl::_checkBit( & _outputDatagram,9);
-    status_velocity_reached = MotorControl::_checkBit( & _outputDatagram,8);
-	status_position_reached_event = MotorControl::_checkBit( & _outputDatagram,7);
-	status_sg2 = MotorControl::_checkBit( & _outputDatagram,13);
-	status_sg2_event = MotorControl::_checkBit( & _outputDatagram,6);
-	status_standstill = MotorControl::_checkBit( & _outputDatagram,10); // vzero: VACTUAL=0, immediate
+	bits |= RAMP_STAT::status_sg::get(values[0]) << STATUS_BIT_SG2;
+	bits |= RAMP_STAT::event_stop_sg::get(values[0]) << STATUS_BIT_SG2_EVENT;
+	bits |= RAMP_STAT::vzero::get(values[0]) << STATUS_BIT_STANDSTILL;		// VACTUAL=0, immediate
+	bits |= RAMP_STAT::velocity_reached::get(values[0]) << STATUS_BIT_VELOCITY_REACHED;
+	bits |= RAMP_STAT::position_reached::get(values[0]) << STATUS_BIT_POSITION_REACHED;
+	bits |= RAMP_STAT::event_pos_reached::get(values[0]) << STATUS_BIT_POSITION_EVENT;
+	bits |= RAMP_STAT::status_stop_l::get(values[0]) << STATUS_BIT_STOP_L;
+	bits |= RAMP_STAT::status_stop_r::get(values[0]) << STATUS_BIT_STOP_R;
+	bits |= RAMP_STAT::event_stop_l::get(values[0]) << STATUS_BIT_STOP_L_EVENT;
+	bits |= RAMP_STAT::event_stop_r::get(values[0]) << STATUS_BIT_STOP_R_EVENT;
+	bits |= RAMP_STAT::status_latch_l::get(values[0]) << STATUS_BIT_LATCH_L;
+	bits |= RAMP_STAT::status_latch_r::get(values[0]) << STATUS_BIT_LATCH_R;
 
-	MotorControl::sendData(&GCONF_READ);
 	// Flags for the DRV_STATUS register
-	status_openLoad_A = MotorControl::_checkBit( & _outputDatagram,29);
-	status_openLoad_B = MotorControl::_checkBit( & _outputDatagram,30);
-	status_shortToGround_A = MotorControl::_checkBit( & _outputDatagram,28);
-	status_shortToGround_B = MotorControl::_checkBit( & _outputDatagram,27);
-	status_overtemperatureWarning = MotorControl::_checkBit( & _outputDatagram,26);
-	status_overtemperatureShutdown = MotorControl::_checkBit( & _outputDatagram,25);
-	
-	MotorControl::sendData(&GSTAT_READ);
+	bits |= DRV_STATUS::ola::get(values[1]) << STATUS_BIT_OPEN_LOAD_A;
+	bits |= DRV_STATUS::olb::get(values[1]) << STATUS_BIT_OPEN_LOAD_B;
+	bits |= DRV_STATUS::s2ga::get(values[1]) << STATUS_BIT_SHORT_GND_A;
+	bits |= DRV_STATUS::s2gb::get(values[1]) << STATUS_BIT_SHORT_GND_B;
+	bits |= DRV_STATUS::otpw::get(values[1]) << STATUS_BIT_OT_WARNING;
+	bits |= DRV_STATUS::ot::get(values[1]) << STATUS_BIT_OT_SHUTDOWN;
+
 	// Flags for the GCONF register
-	status_isReverse = MotorControl::_checkBit( & i_datagram,4);
-	
-	MotorControl::sendData(&GSTAT_READ);
+	bits |= GCONF::shaft::get(values[2]) << STATUS_BIT_IS_REVERSE;
+
 	// Flags for the GSTAT register
-	status_resetDetected = MotorControl::_checkBit( & i_datagram,0);
-	status_driverError = MotorControl::_checkBit( & i_datagram,1);
-	status_underVoltage = MotorControl::_checkBit( & i_datagram,2);
-
-	if (false){
-		Serial.print(motorID);
-		Serial.print(F(" : "));
-		Serial.print(F("Response Flags: "));
-		Serial.println(i_datagram.responseFlags,HEX);
-		Serial.println(i_datagram.responseFlags,BIN);
-		Serial.print(F("Stop L: "));
-		Serial.println(status_stop_l);
-		Serial.print(F("Stop R:"));
-		Serial.println(status_stop_r);
-		Serial.print(F("Latch L: "));
-		Serial.println(status_latch_l);
-		Serial.print(F("Latch R:"));
-		Serial.println(status_latch_r);
-		Serial.print(F("Stop L Event: "));
-		Serial.println(status_stop_l_event);
-		Serial.print(F("Stop R Event:"));
-		Serial.println(status_stop_r_event);
-		Serial.print(F("Position reached: "));
-		Serial.println(status_position_reached);
-		Serial.print(F("Velocity Reached: "));
-		Serial.println(status_velocity_reached);
-		Serial.print(F("Position Reached Event: "));
-		Serial.println(status_position_reached_event);
-		Serial.print(F("Stall Gaurd On:"));
-		Serial.println(status_sg2);
-		Serial.print(F("Stall gaurd event: "));
-		Serial.println(status_sg2_event);
-		Serial.print(F("Motor in standstill: "));
-		Serial.println(status_standstill);
-		Serial.print(F("Open load A: "));
-		Serial.println(status_openLoad_A);
-		Serial.print(F("Open load B: "));
-		Serial.println(status_openLoad_B);
-		Serial.print(F("Short to ground A: "));
-		Serial.println(status_shortToGround_A);
-		Serial.print(F("Short to ground B: "));
-		Serial.println(status_shortToGround_B);
-		Serial.print(F("Overtemperature warning: "));
-		Serial.println(status_overtemperatureWarning);
-		Serial.print(F("Overtemperature Shutdown: "));
-		Serial.println(status_overtemperatureShutdown);
-		Serial.print(F("Running Reverse: "));
-		Serial.println(status_isReverse);
-		Serial.print(F("Chip had been reset: "));
-		Serial.println(status_resetDetected);
-		Serial.print(F("Driver Error: "));
-		Serial.println(status_driverError);
-		Serial.print(F("Undervoltage: "));
-		Serial.println(status_underVoltage);
-		Serial.print(F("Current Position: "));
-
-		Serial.flush();
+	bits |= GSTAT::reset::get(values[3]) << STATUS_BIT_RESET;
+	bits |= GSTAT::drv_err::get(values[3]) << STATUS_BIT_DRIVER_ERROR;
+	bits |= GSTAT::uv_cp::get(values[3]) << STATUS_BIT_UNDERVOLTAGE;
+
+	// Software state
+	bits |= (uint32_t)IsForward << STATUS_BIT_IS_FORWARD;
+	bits |= (uint32_t)IsPositionMode << STATUS_BIT_IS_POSITION_MODE;
+	bits |= (uint32_t)_isHomed << STATUS_BIT_IS_HOMED;
+
+	snapshot.statusBits = bits;
+
+	// A reset chip is back at its defaults, the shadow no longer holds
+	if (snapshot.get(STATUS_BIT_RESET)) {
+		MotorControl :: _invalidateShadow();
 	}
+
+	#ifdef DEBUG_MOTOR
+	Serial.print(motorID);
+	Serial.print(F(" : Status: "));
+	Serial.println(snapshot.statusBits, BIN);
+	Serial.print(F("RAMP_STAT: "));
+	Serial.println(snapshot.rampStat, HEX);
+	Serial.print(F("DRV_STATUS: "));
+	Serial.println(snapshot.drvStatus, HEX);
+	Serial.print(F("GSTAT: "));
+	Serial.println(snapshot.gstat, HEX);
+	Serial.print(F("Current Position: "));
+	Serial.println(snapshot.xactual);
+	Serial.flush();
+	#endif
 }
 
 /* ======================================================================
@@ -549,12 +928,9 @@ void MotorControl :: readStatus() {
 ====================================================================== */
 
 void MotorControl :: sgStatus() {
-	
-    MotorControl::sendData( & DRV_STATUS_READ);
-    MotorControl::sendData( & DRV_STATUS_READ);
 
-    // sgStatusBits = _outputDatagram.data & 0x000003FF;
-    sgStatusBits = _outputDatagram.data & 0xFFFFFFFF;
+    // sgStatusBits = readRegister(ADDRESS_DRVSTATUS) & 0x000003FF;
+    sgStatusBits = MotorControl::readRegister(ADDRESS_DRVSTATUS);
 }
 
 /* ======================================================================
@@ -564,13 +940,12 @@ void MotorControl :: sgStatus() {
 
 void MotorControl :: buttonStatus() {
 
-	//pipeline flush
-    MotorControl::sendData( & RAMP_STAT_READ);
-    MotorControl::sendData( & RAMP_STAT_READ);
+	datagram rampStat;
+	rampStat.data = MotorControl::readRegister(ADDRESS_RAMPSTAT);
 
     // Bit 1 = right switch, Bit 0 = left switch
-    forwardSwitch = MotorControl::_checkBit( & _outputDatagram,(forwardDirection.buttonStatusNum));
-	backwardSwitch = MotorControl::_checkBit( & _outputDatagram,(backwardDirection.buttonStatusNum));
+    forwardSwitch = MotorControl::_checkBit( & rampStat,(forwardDirection.buttonStatusNum));
+	backwardSwitch = MotorControl::_checkBit( & rampStat,(backwardDirection.buttonStatusNum));
 }
 
 /* ======================================================================
@@ -595,13 +970,13 @@ bool MotorControl::_checkBit(datagram * dg, int targetBit) {
 void MotorControl :: switchReference(bool rightIsREFR) {
 
 	if (rightIsREFR) {
-		// Keep old SW_MODE.data except for bit-4, replace bit with 0
-		SW_MODE.data = (SW_MODE.data & 0xFFFFFFEF) | 0x00000000;
+		// Keep old SW_MODE.data except for swap_lr, replace bit with 0
+		SW_MODE.data = TMC5130::SW_MODE::swap_lr::set(SW_MODE.data, 0);
 		MotorControl :: sendData( &SW_MODE );
 	}
 	else {
-		// Keep old SW_MODE.data except for bit-4, replace bit with 1
-		SW_MODE.data = (SW_MODE.data & 0xFFFFFFEF) | 0x00000010;
+		// Keep old SW_MODE.data except for swap_lr, replace bit with 1
+		SW_MODE.data = TMC5130::SW_MODE::swap_lr::set(SW_MODE.data, 1);
 		MotorControl :: sendData( &SW_MODE );
 	}
 }
@@ -624,20 +999,70 @@ bool MotorControl :: powerDisable() {
 
 bool MotorControl :: csEnable() {
 
-    digitalWrite(_csPin,LOW);
-    delay(1);
+	spi.begin();
     return true;
 }
 
 bool MotorControl :: csDisable() {
 
-	delay(1);
-    digitalWrite(_csPin,HIGH);
-	//digitalWrite(DIO13,LOW);
-    delay(1);
+	spi.end();
     return true;
 }
 
+/* ======================================================================
+	SPI transaction for one 40 bit datagram. The bus settings are claimed
+	per transaction so other SPI users (BLE) cannot leave it in the wrong
+	mode. The CSN timing follows the datasheet minimums instead of the 1ms
+	delays used before, which can still be replayed with legacyTiming to
+	benchmark against the old path.
+ ====================================================================== */
+
+void spiTransaction :: begin() {
+
+	SPI.beginTransaction(TMC5130_SPI_SETTINGS);
+	digitalWrite(csPin, LOW);
+
+	if (legacyTiming) {
+		delay(1);
+	}
+}
+
+void spiTransaction :: end() {
+
+	if (legacyTiming) {
+		delay(1);
+	}
+
+	digitalWrite(csPin, HIGH);
+	SPI.endTransaction();
+
+	if (legacyTiming) {
+		delay(1);
+	}
+	else {
+		delayMicroseconds(TMC5130_CSN_HIGH_US);
+	}
+
+	transfers++;
+	_windowTransfers++;
+
+	unsigned long now = millis();
+	if (now - _windowStart >= 1000) {
+		_lastWindowTransfers = _windowTransfers;
+		_windowTransfers = 0;
+		_windowStart = now;
+	}
+}
+
+unsigned long spiTransaction :: transfersPerSecond() {
+
+	// No traffic for a whole window, the last count is stale
+	if (millis() - _windowStart >= 2000) {
+		return 0;
+	}
+	return _lastWindowTransfers;
+}
+
 /* ======================================================================
 	checks the user input and changes the bits for the polarity of the
 	switches. Forward and backward switch are determined by the user's
@@ -654,8 +1079,9 @@ bool MotorControl :: switchActiveEnable(bool fw, bool bw) {
 	forward = ((long) fw) << (forwardDirection.activeEnableNum);
 	backward = ((long) bw) << (backwardDirection.activeEnableNum);
 
-	// Keep old SW_MODE.data except for the first two bits, replace them with new bits
-	SW_MODE.data = (SW_MODE.data & 0xFFFFFFF3) | (forward | backward);
+	// Keep old SW_MODE.data except for the two polarity bits, replace them with new bits
+	SW_MODE.data = (SW_MODE.data & ~(TMC5130::SW_MODE::pol_stop_l::mask | TMC5130::SW_MODE::pol_stop_r::mask)) |
+				   (forward | backward);
 	MotorControl :: sendData( &SW_MODE );
 
 	#ifdef DEBUG_DIR
@@ -672,13 +1098,16 @@ bool MotorControl :: switchActiveEnable(bool fw, bool bw) {
 
 void MotorControl :: setPowerLevel(unsigned long holdPower, unsigned long runPower) {
 
-	IHOLD_IRUN.data = holdPower | ( runPower << 8 ) | ( 7 << 16 );
+	IHOLD_IRUN.data = TMC5130::IHOLD_IRUN::IHOLD::encode(holdPower) | TMC5130::IHOLD_IRUN::IRUN::encode(runPower) |
+					  IHOLDDELAY_DEFAULT;
 	MotorControl :: sendData(&IHOLD_IRUN);
 }
 
 void MotorControl :: setVelocity(unsigned long velocity) {
 
-	VMAX.data = velocity;
+	MotorControl :: _restoreRamp();
+
+	VMAX.data = TMC5130::VMAX::value::encode(velocity);
 	MotorControl :: sendData(&VMAX);
 
 	#ifdef DEBUG_MOTOR
@@ -691,7 +1120,7 @@ void MotorControl :: setVelocity(unsigned long velocity) {
 
 void MotorControl :: setAcceleration(unsigned long acceleration) {
 
-	AMAX.data = acceleration;
+	AMAX.data = TMC5130::AMAX::value::encode(acceleration);
 	MotorControl :: sendData(&AMAX);
 
 	#ifdef DEBUG_MOTOR
@@ -704,7 +1133,7 @@ void MotorControl :: setAcceleration(unsigned long acceleration) {
 
 void MotorControl :: setDeceleration(unsigned long deceleration) {
 
-	DMAX.data = deceleration;
+	DMAX.data = TMC5130::DMAX::value::encode(deceleration);
 	MotorControl :: sendData(&DMAX);
 
 	#ifdef DEBUG_MOTOR
@@ -717,7 +1146,7 @@ void MotorControl :: setDeceleration(unsigned long deceleration) {
 
 void MotorControl :: setXtarget(unsigned long xtarget) {
 
-	XTARGET.data = xtarget;
+	XTARGET.data = TMC5130::XTARGET::value::encode(xtarget);
 	MotorControl :: sendData(&XTARGET);
 
 	#ifdef DEBUG_MOTOR
@@ -729,7 +1158,7 @@ void MotorControl :: setXtarget(unsigned long xtarget) {
 }
 
 void MotorControl :: setXactual(unsigned long xactual) {
-	XACTUAL.data = xactual;
+	XACTUAL.data = TMC5130::XACTUAL::value::encode(xactual);
 	MotorControl :: sendData(&XACTUAL);
 
 	#ifdef DEBUG_MOTOR
@@ -786,7 +1215,7 @@ void MotorControl :: setRampMode(unsigned long rampMode) {
 			break;
 		}
 	}
-	RAMPMODE.data = rampMode;
+	RAMPMODE.data = TMC5130::RAMPMODE::value::encode(rampMode);
 	MotorControl :: sendData(&RAMPMODE);
 
 	#ifdef DEBUG_MOTOR
@@ -807,18 +1236,13 @@ void MotorControl :: setChopConf(int resolution) {
 	for (int i = 0; i < 9; i++) {
 		if ( res[i] == resolution ) {
 			_resolutionNum = i+1;
-			binaryNum = i & (0b000000000000000000001111);
+			binaryNum = i;
 			Serial.println(binaryNum, HEX);
 			break;
 		}
 	}
 
-	binaryNum <<= 24;
-
-	// Serial.print("Binary Number: ");
-	// Serial.println(binaryNum,HEX);
-
-	CHOPCONF.data = binaryNum | 0x000101D5;
+	CHOPCONF.data = TMC5130::CHOPCONF::MRES::set(CHOPCONF_DEFAULT, binaryNum);
 
 	// Serial.print("CHOPCONF data: ");
 	// Serial.println(CHOPCONF.data, HEX);
@@ -831,27 +1255,20 @@ int MotorControl :: getMotorID() {
 }
 
 unsigned long MotorControl :: getPowerLevel() {
-	MotorControl :: sendData(&IHOLD_IRUN_READ);
-	MotorControl :: sendData(&IHOLD_IRUN_READ);
-	return i_datagram.data;
+	return MotorControl :: readRegister<TMC5130::IHOLD_IRUN>();
 }
 
 unsigned long MotorControl :: getVelocity() {
-	MotorControl :: sendData(&VACTUAL_READ);
-	MotorControl :: sendData(&VACTUAL_READ);
-	return i_datagram.data;
+	snapshot.vactual = MotorControl :: readRegister<TMC5130::VACTUAL>();
+	return snapshot.vactual;
 }
 
 unsigned long MotorControl :: getAcceleration() {
-	MotorControl :: sendData(&AMAX_READ);
-	MotorControl :: sendData(&AMAX_READ);
-	return i_datagram.data;
+	return MotorControl :: readRegister<TMC5130::AMAX>();
 }
 
 unsigned long MotorControl :: getDeceleration() {
-	MotorControl :: sendData(&DMAX_READ);
-	MotorControl :: sendData(&DMAX_READ);
-	return i_datagram.data;
+	return MotorControl :: readRegister<TMC5130::DMAX>();
 }
 
 signed long MotorControl :: getXtarget() {
@@ -859,10 +1276,8 @@ signed long MotorControl :: getXtarget() {
 }
 
 unsigned long MotorControl :: getXactual() {
-	MotorControl :: sendData(&XACTUAL_READ);
-	MotorControl :: sendData(&XACTUAL_READ);
-
-	return i_datagram.data;
+	snapshot.xactual = MotorControl :: readRegister<TMC5130::XACTUAL>();
+	return snapshot.xactual;
 }
 
 unsigned long MotorControl :: getHomeXtarget() {
@@ -900,120 +1315,275 @@ int MotorControl :: getResolution() {
 
 bool MotorControl :: goPos(unsigned long position) {
 
-	MotorControl :: setVelocity(0);
+	return MotorControl :: goPosAt(position, STAND_MTR_VELOCITY / _resolutionNum);
+}
+
+/* ======================================================================
+	goPos with VMAX velocity instead of the standard one.
+ ====================================================================== */
 
-	// Check if the motor is in position mode, if not, change to position mode
+bool MotorControl :: goPosAt(unsigned long position, unsigned long velocity) {
+
+	// Check if the motor is in position mode, if not, stop and change to position mode
 	if (MotorControl :: getRampMode() != ADDRESS_MODE_POSITION) {
+		MotorControl :: setVelocity(0);
 		MotorControl :: setRampMode(ADDRESS_MODE_POSITION);
 	}
 
-	MotorControl :: setVelocity(STAND_MTR_VELOCITY / _resolutionNum);
+	MotorControl :: setVelocity(velocity);
  	MotorControl :: setXtarget(position);
  	
  	return true;
 }
 
 /* ======================================================================
-	Function sends commands to the motor to return it to the "home" state.
-	Function checks homing device in order:
-		case(0): 	checks the register to see if the right (home) switch is active.
-					If active, finishes homing procedure. If home position has not 
-					been set, sets home position.
-		case(1):	Set switch mode for right active switch.
-		case(2):	Monitors register for right switch active status.
-		case(3):	Once the right switch is active, sets the home position to the
-					current position.	
-		default:	
+	Same move as goPos, but RAMPMODE, AMAX, VMAX and XTARGET are queued for
+	the DMA driven transfer so the caller returns before the move is on the
+	wire. The callback fires once XTARGET has been sent. Returns false
+	without queueing anything if the queue cannot take the whole move.
  ====================================================================== */
 
-bool MotorControl :: setHome() {
+bool MotorControl :: queueMove(unsigned long position, datagramCallback callback) {
 
-	bool done = false;
+	if (datagramQueue.freeSlots(motorID) < 4) {
+		return false;
+	}
 
-	switch(_homeCaseNum) {
+	MotorControl :: _restoreRamp();
 
-		case(0): {
+	IsPositionMode = true;
+	IsForward = true;
+	RAMPMODE.data = ADDRESS_MODE_POSITION;
+	VMAX.data = STAND_MTR_VELOCITY / _resolutionNum;
+	XTARGET.data = position;
 
-			MotorControl::buttonStatus();
+	MotorControl :: queueData(&RAMPMODE, nullptr);
+	MotorControl :: queueData(&AMAX, nullptr);
+	MotorControl :: queueData(&VMAX, nullptr);
+	MotorControl :: queueData(&XTARGET, callback);
 
-			if (forwardSwitch) {
+	return true;
+}
 
-				#ifdef DEBUG_HOME
-					Serial.print(motorID);
-					Serial.print(F(" : "));
-					Serial.println(F("Homing: Stage at home. "));
-				#endif
+/* ======================================================================
+	The ramp of a goPos move, from the registers as last set. Coordinated
+	moves scale it for the axis with the shorter travel.
+ ====================================================================== */
 
-				_homeCaseNum = 3;
-			}
+rampProfile MotorControl :: nominalRamp() {
+
+	rampProfile ramp;
+	ramp.a1 = A1.data;
+	ramp.v1 = V1.data;
+	ramp.amax = AMAX.data;
+	ramp.vmax = STAND_MTR_VELOCITY / _resolutionNum;
+	ramp.dmax = DMAX.data;
+	ramp.d1 = D1.data;
+	ramp.vstop = VSTOP.data;
+	return ramp;
+}
 
-			else {
+/* ======================================================================
+	Moves to position on the fastest ramp within the limits of the axis.
+	The planner works at full resolution, a coarser step setting covers
+	the same move with proportionally smaller numbers.
+ ====================================================================== */
 
-				#ifdef DEBUG_HOME
-					Serial.print(motorID);
-					Serial.print(F(" : "));
-					Serial.println(F("Homing: Stage not homed, continuing with homing."));
-				#endif 
+bool MotorControl :: goPosPlanned(unsigned long position) {
 
-				_homeCaseNum++;
-			}
-		} break;
-		
-		case(1): {
+	unsigned long distance = labs((signed long)position - (signed long)MotorControl :: getXactual());
+	rampProfile ramp = planner.plan(distance * _resolutionNum);
 
-			MotorControl :: sendData(&RAMPMODE);
-			MotorControl :: sendData(&XACTUAL);
-			MotorControl :: sendData(&VMAX);
-			_homeCaseNum++;
-			
-		} break;
+	MotorControl :: armMove(RampPlanner :: scale(ramp, 1.0 / _resolutionNum));
+	MotorControl :: setXtarget(position);
+	return true;
+}
 
-		case(2): {
+/* ======================================================================
+	Puts the motor in position mode with the given ramp, the move starts
+	with the next setXtarget. The datagrams keep the nominal values so the
+	next setVelocity or queueMove can put them back, see _restoreRamp.
+ ====================================================================== */
 
-			#ifdef DEBUG_HOME
-				Serial.print(motorID);
-				Serial.print(F(" : "));
-				Serial.println(F("Homing: Set home target."));
-			#endif 
+void MotorControl :: armMove(const rampProfile & ramp) {
 
-			MotorControl::sendData(&HOME_XTARGET);
-			MotorControl::sendData(&SW_MODE);
-			_homeCaseNum++;
-		} break;
-		
-		case(3): {
+	if (MotorControl :: getRampMode() != ADDRESS_MODE_POSITION) {
+		MotorControl :: setVelocity(0);
+		MotorControl :: setRampMode(ADDRESS_MODE_POSITION);
+	}
 
-			MotorControl :: constForward(STAND_MTR_VELOCITY / _resolutionNum);
+	datagram out;
+	out.rw = WRITE;
 
-			while(forwardSwitch == false) {
-				MotorControl :: buttonStatus();
-			}
+	out.address = ADDRESS_A1;
+	out.data = TMC5130::A1::value::encode(ramp.a1);
+	MotorControl :: sendData(&out);
 
-			MotorControl :: stop();
+	out.address = ADDRESS_V1;
+	out.data = TMC5130::V1::value::encode(ramp.v1);
+	MotorControl :: sendData(&out);
 
-			#ifdef DEBUG_HOME
-				Serial.print(motorID);
-				Serial.print(F(" : "));
-				Serial.println(F("Homing: Motor Homed."));
-			#endif
+	out.address = ADDRESS_AMAX;
+	out.data = TMC5130::AMAX::value::encode(ramp.amax);
+	MotorControl :: sendData(&out);
 
-			MotorControl::sendData(&XACTUAL);
+	out.address = ADDRESS_DMAX;
+	out.data = TMC5130::DMAX::value::encode(ramp.dmax);
+	MotorControl :: sendData(&out);
 
-			HOME_XTARGET.data = MotorControl :: getXactual();
-			MotorControl :: setXtarget(HOME_XTARGET.data);
+	out.address = ADDRESS_D1;
+	out.data = TMC5130::D1::value::encode(ramp.d1);
+	MotorControl :: sendData(&out);
 
+	out.address = ADDRESS_VSTOP;
+	out.data = TMC5130::VSTOP::value::encode(ramp.vstop);
+	MotorControl :: sendData(&out);
 
-			_homeCaseNum++;
-		} break;
-		
-		default: {
+	VMAX.data = TMC5130::VMAX::value::encode(ramp.vmax);
+	MotorControl :: sendData(&VMAX);
 
-			#ifdef DEBUG_HOME
-				Serial.print(motorID);
+	_rampScaled = true;
+}
+
+/* ======================================================================
+	Writes the nominal A1/V1/AMAX/DMAX/D1/VSTOP back after armMove, the
+	shadow skips the registers armMove left unchanged.
+ ====================================================================== */
+
+void MotorControl :: _restoreRamp() {
+
+	if (!_rampScaled) {
+		return;
+	}
+	_rampScaled = false;
+
+	MotorControl :: sendData(&A1);
+	MotorControl :: sendData(&V1);
+	MotorControl :: sendData(&AMAX);
+	MotorControl :: sendData(&DMAX);
+	MotorControl :: sendData(&D1);
+	MotorControl :: sendData(&VSTOP);
+}
+
+/* ======================================================================
+	Advances homing by one step and returns true once the motor is homed.
+	Call it from the main loop until it does, like CombinedControl :: seek,
+	every call costs at most a few transfers. The home switch (the one hit
+	going forward) arms the SW_MODE latch, so the chip copies XACTUAL into
+	XLATCH on the switch edge while approaching at full speed.
+		case(0): 	checks the home switch. If the stage already sits on it,
+					backs off first since the latch needs an edge.
+		case(1):	waits for the home switch to release.
+		case(2):	clears the old latch event, arms the latch on the home
+					switch and approaches it.
+		case(3):	waits for the latch event, then disarms the latch and
+					moves back to XLATCH, the home position.
+		case(4):	waits until the motor stands at the home position.
+		default:	makes the home position coordinate 0, see
+					_zeroPosition, and marks the motor homed.
+	abortHome() stops the motor and drops out of the sequence.
+ ====================================================================== */
+
+bool MotorControl :: setHome() {
+
+	bool done = false;
+
+	switch(_homeCaseNum) {
+
+		case(0): {
+
+			MotorControl::buttonStatus();
+
+			if (forwardSwitch) {
+
+				#ifdef DEBUG_HOME
+					Serial.print(motorID);
+					Serial.print(F(" : "));
+					Serial.println(F("Homing: Stage on the switch, backing off."));
+				#endif
+
+				MotorControl :: constReverse(HOME_BACKOFF_VELOCITY / _resolutionNum);
+				_homeCaseNum = 1;
+			}
+
+			else {
+				_homeCaseNum = 2;
+			}
+		} break;
+
+		case(1): {
+
+			MotorControl::buttonStatus();
+
+			if (!forwardSwitch) {
+				_homeCaseNum = 2;
+			}
+		} break;
+
+		case(2): {
+
+			#ifdef DEBUG_HOME
+				Serial.print(motorID);
+				Serial.print(F(" : "));
+				Serial.println(F("Homing: Approaching the switch."));
+			#endif
+
+			// Write 1 to clear an old latch event
+			datagram clearLatch;
+			clearLatch.rw = WRITE;
+			clearLatch.address = ADDRESS_RAMPSTAT;
+			clearLatch.data = MotorControl :: _homeLatchStatusMask();
+			MotorControl :: sendData(&clearLatch);
+
+			SW_MODE.data |= MotorControl :: _homeLatchEnableMask();
+			MotorControl :: sendData(&SW_MODE);
+
+			MotorControl :: constForward(STAND_MTR_VELOCITY / _resolutionNum);
+			_homeCaseNum++;
+		} break;
+
+		case(3): {
+
+			if ((MotorControl :: readRegister(ADDRESS_RAMPSTAT) & MotorControl :: _homeLatchStatusMask()) == 0) {
+				break;
+			}
+
+			HOME_XTARGET.data = MotorControl :: readRegister<TMC5130::XLATCH>();
+
+			SW_MODE.data &= ~MotorControl :: _homeLatchEnableMask();
+			MotorControl :: sendData(&SW_MODE);
+
+			#ifdef DEBUG_HOME
+				Serial.print(motorID);
+				Serial.print(F(" : "));
+				Serial.print(F("Homing: Switch latched at "));
+				Serial.println((signed long)HOME_XTARGET.data);
+			#endif
+
+			// Brakes from the approach and returns to the switch edge
+			MotorControl :: goPos(HOME_XTARGET.data);
+			_homeCaseNum++;
+		} break;
+
+		case(4): {
+
+			MotorControl :: refreshStatusFlags(STATUS_FLAGS_MAX_AGE_MS);
+
+			if (snapshot.get(STATUS_BIT_POSITION_REACHED) && snapshot.get(STATUS_BIT_STANDSTILL)) {
+				_homeCaseNum++;
+			}
+		} break;
+		
+		default: {
+
+			#ifdef DEBUG_HOME
+				Serial.print(motorID);
 				Serial.print(F(" : "));
 				Serial.println(F("Homing: Operation complete."));
 			#endif 
 
+			MotorControl :: _zeroPosition();
+			_isHomed = true;
 			_homeCaseNum = 0;
 			done = true;
 		}	
@@ -1022,6 +1592,897 @@ bool MotorControl :: setHome() {
     return done;
 }
 
+/* ======================================================================
+	Stops a homing sequence part way, the latch is disarmed and the next
+	setHome() starts over. Does nothing if no homing is in progress.
+ ====================================================================== */
+
+void MotorControl :: abortHome() {
+
+	if (_homeCaseNum == 0) {
+		return;
+	}
+
+	SW_MODE.data &= ~MotorControl :: _homeLatchEnableMask();
+	MotorControl :: sendData(&SW_MODE);
+	MotorControl :: _restoreStallGuard();
+	MotorControl :: stop();
+
+	_homeCaseNum = 0;
+}
+
+bool MotorControl :: isHoming() {
+	return _homeCaseNum != 0;
+}
+
+// The home switch is the one hit going forward, see swapDirection
+unsigned long MotorControl :: _homeLatchEnableMask() {
+	return forwardDirection.buttonStatusNum ? TMC5130::SW_MODE::latch_r_active::mask : TMC5130::SW_MODE::latch_l_active::mask;
+}
+
+unsigned long MotorControl :: _homeLatchStatusMask() {
+	return forwardDirection.buttonStatusNum ? TMC5130::RAMP_STAT::status_latch_r::mask : TMC5130::RAMP_STAT::status_latch_l::mask;
+}
+
+/* ======================================================================
+	Makes the position the motor stands at coordinate 0, what goPos(0),
+	the travel limits and the sky coordinates take as home. XACTUAL is
+	only written in hold mode so the ramp cannot start on the new value,
+	XTARGET follows before position mode is back. An encoder starts over
+	at 0 with it.
+ ====================================================================== */
+
+void MotorControl :: _zeroPosition() {
+
+	MotorControl :: setRampMode(ADDRESS_MODE_HOLD);
+	MotorControl :: setXactual(0);
+	MotorControl :: setXtarget(0);
+	MotorControl :: setRampMode(ADDRESS_MODE_POSITION);
+
+	if (encoder.enabled) {
+		datagram out;
+		out.rw = WRITE;
+		out.address = ADDRESS_XENC;
+		out.data = 0x00000000;
+		MotorControl :: sendData(&out);
+		_encoderTarget = XTARGET.data;
+	}
+
+	HOME_XTARGET.data = 0x00000000;
+}
+
+/* ======================================================================
+	setHome for an axis without a home switch: the motor runs forward
+	into the end of its travel with sg_stop set, and the chip stops it
+	the moment it stalls, so the hard stop lies at XACTUAL. Home is
+	STALL_HOME_BACKOFF short of it, the axis does not rest against the
+	stop. Needs a calibrateStall first, returns true at once without
+	homing otherwise. The approach runs at twice stall.velocity, fast
+	enough for a clean SG_RESULT and slow enough for a soft hit.
+		case(0):	loads the threshold, sets sg_stop and runs forward.
+		case(1):	waits for the stall event, then releases the motor
+					and moves back to home.
+		case(2):	waits until the motor stands at home.
+		default:	makes home coordinate 0 like setHome and marks the
+					motor homed.
+	abortHome() stops it like setHome.
+ ====================================================================== */
+
+bool MotorControl :: setHomeSensorless() {
+
+	bool done = false;
+
+	switch(_homeCaseNum) {
+
+		case(0): {
+
+			if (!stall.calibrated) {
+				done = true;
+				break;
+			}
+
+			#ifdef DEBUG_HOME
+				Serial.print(motorID);
+				Serial.print(F(" : "));
+				Serial.println(F("Homing: Running into the hard stop."));
+			#endif
+
+			MotorControl :: _setStallThreshold(stall.sgt, stall.velocity);
+
+			// Write 1 to clear an old stall event
+			datagram clearStall;
+			clearStall.rw = WRITE;
+			clearStall.address = ADDRESS_RAMPSTAT;
+			clearStall.data = ADDRESS_RS_EV_STOP_SG;
+			MotorControl :: sendData(&clearStall);
+
+			MotorControl :: _setStallStop(true);
+
+			unsigned long velocity = 2 * stall.velocity;
+			MotorControl :: constForward(min(velocity, (unsigned long)(STAND_MTR_VELOCITY / _resolutionNum)));
+			_homeCaseNum = 1;
+		} break;
+
+		case(1): {
+
+			if ((MotorControl :: readRegister(ADDRESS_RAMPSTAT) & ADDRESS_RS_EV_STOP_SG) == 0) {
+				break;
+			}
+
+			MotorControl :: _releaseStall();
+
+			signed long hardStop = (signed long)MotorControl :: getXactual();
+			signed long backoff = (forwardDirection.address == ADDRESS_MODE_VELPOS) ? -STALL_HOME_BACKOFF : STALL_HOME_BACKOFF;
+			HOME_XTARGET.data = hardStop + backoff / _resolutionNum;
+
+			#ifdef DEBUG_HOME
+				Serial.print(motorID);
+				Serial.print(F(" : "));
+				Serial.print(F("Homing: Stalled at "));
+				Serial.println(hardStop);
+			#endif
+
+			MotorControl :: goPos(HOME_XTARGET.data);
+			_homeCaseNum = 2;
+		} break;
+
+		case(2): {
+
+			MotorControl :: refreshStatusFlags(STATUS_FLAGS_MAX_AGE_MS);
+
+			if (snapshot.get(STATUS_BIT_POSITION_REACHED) && snapshot.get(STATUS_BIT_STANDSTILL)) {
+				_homeCaseNum++;
+			}
+		} break;
+
+		default: {
+
+			#ifdef DEBUG_HOME
+				Serial.print(motorID);
+				Serial.print(F(" : "));
+				Serial.println(F("Homing: Operation complete."));
+			#endif
+
+			MotorControl :: _restoreStallGuard();
+			MotorControl :: _zeroPosition();
+
+			_isHomed = true;
+			_homeCaseNum = 0;
+			done = true;
+		}
+	}
+
+	return done;
+}
+
+//==============================================================
+//======================== STALLGUARD ==========================
+//==============================================================
+
+/* ======================================================================
+	Finds the StallGuard2 threshold of the axis, one step per call like
+	setHome. SG_RESULT falls with the load and reaches 0 at a stall; a
+	lower SGT makes it fall sooner, a lower speed makes it weaker and
+	noisier. The motor runs free in velocity mode at STAND_MTR_VELOCITY,
+	then at half of it again and again (STALL_CAL_SPEEDS speeds). At each
+	speed SGT goes up from where the faster one left it until the lowest
+	of STALL_CAL_SAMPLES readings stays at STALL_SG_MARGIN or above. The
+	sweep ends at the first speed whose readings spread more than
+	STALL_SG_SPREAD or that no SGT up to STALL_CAL_SGT_MAX holds; the last
+	speed that passed and its SGT are the profile, and TCOOLTHRS keeps
+	stall detection off below that speed. The direction changes with
+	every step so the axis stays within a fraction of a degree of where
+	it started. It has to run free, nothing but its own load on it.
+		case(0):	disarms the guard and starts the sweep.
+		case(1):	sets SGT and runs at the speed of the step.
+		case(2):	waits STALL_CAL_SETTLE_MS for the speed to settle.
+		case(3):	reads SG_RESULT once per full step, it only updates
+					that often, and judges the step once all are in.
+		default:	stops the motor, loads the profile and re-arms the
+					guard.
+ ====================================================================== */
+
+bool MotorControl :: calibrateStall() {
+
+	bool done = false;
+
+	switch(_stallCaseNum) {
+
+		case(0): {
+
+			MotorControl :: _setStallStop(false);
+			stall.calibrated = false;
+			_stallStep = 0;
+			_stallSgt = STALL_CAL_SGT_MIN;
+			_stallForward = true;
+			_stallCaseNum = 1;
+		} break;
+
+		case(1): {
+
+			// TCOOLTHRS 0, nothing may stop the motor while sweeping
+			MotorControl :: _setStallThreshold(_stallSgt, 0);
+
+			// You must set velocity after ramp mode otherwise will go in the positive direction
+			MotorControl :: setRampMode(_stallForward ? ADDRESS_MODE_VELPOS : ADDRESS_MODE_VELNEG);
+			unsigned long velocity = (STAND_MTR_VELOCITY >> _stallStep) / _resolutionNum;
+			MotorControl :: setVelocity(velocity);
+
+			// 256 usteps per full step, VMAX in usteps per 2^24 clocks (datasheet chp. 14)
+			_stallInterval = (unsigned long)ceil(256000.0 * 16777216.0 / (max(velocity, 1UL) * TMC5130_FCLK));
+
+			_stallForward = !_stallForward;
+			_stallSamples = 0;
+			_stallMin = TMC5130::DRV_STATUS::SG_RESULT::max;
+			_stallMax = 0;
+			_stallTime = millis();
+			_stallCaseNum = 2;
+		} break;
+
+		case(2): {
+
+			if (millis() - _stallTime >= STALL_CAL_SETTLE_MS) {
+				_stallCaseNum = 3;
+			}
+		} break;
+
+		case(3): {
+
+			if (_stallSamples != 0 && millis() - _stallTime < _stallInterval) {
+				break;
+			}
+			_stallTime = millis();
+
+			unsigned int sg = TMC5130::DRV_STATUS::SG_RESULT::get(MotorControl :: readRegister<TMC5130::DRV_STATUS>());
+			_stallMin = min(_stallMin, sg);
+			_stallMax = max(_stallMax, sg);
+
+			if (++_stallSamples < STALL_CAL_SAMPLES) {
+				break;
+			}
+
+			#ifdef DEBUG_MOTOR
+			Serial.print(motorID);
+			Serial.print(F(" : Stall calibration: speed "));
+			Serial.print(_stallStep);
+			Serial.print(F(" SGT "));
+			Serial.print(_stallSgt);
+			Serial.print(F(" SG_RESULT "));
+			Serial.print(_stallMin);
+			Serial.print(F(".."));
+			Serial.println(_stallMax);
+			#endif
+
+			_stallCaseNum = 1;
+
+			if (_stallMax - _stallMin > STALL_SG_SPREAD) {
+				_stallCaseNum = 4;
+			}
+			else if (_stallMin >= STALL_SG_MARGIN) {
+				stall.calibrated = true;
+				stall.sgt = _stallSgt;
+				stall.velocity = (STAND_MTR_VELOCITY >> _stallStep) / _resolutionNum;
+				stall.sgFree = _stallMin;
+
+				if (++_stallStep >= STALL_CAL_SPEEDS) {
+					_stallCaseNum = 4;
+				}
+			}
+			else if (++_stallSgt > STALL_CAL_SGT_MAX) {
+				_stallCaseNum = 4;
+			}
+		} break;
+
+		default: {
+
+			MotorControl :: setVelocity(0);
+
+			_stallCaseNum = 0;
+			MotorControl :: _restoreStallGuard();
+			done = true;
+		}
+	}
+
+	return done;
+}
+
+/* ======================================================================
+	Stops a calibration part way. The old profile is gone by then, the
+	axis is left uncalibrated and unguarded.
+ ====================================================================== */
+
+void MotorControl :: abortCalibration() {
+
+	if (_stallCaseNum == 0) {
+		return;
+	}
+
+	MotorControl :: setVelocity(0);
+	_stallCaseNum = 0;
+	MotorControl :: _setStallThreshold(0, 0);
+}
+
+bool MotorControl :: isCalibrating() {
+	return _stallCaseNum != 0;
+}
+
+/* ======================================================================
+	Keeps sg_stop set so the chip stops the motor by itself the moment it
+	stalls, within a full step instead of after the next poll. TCOOLTHRS
+	limits it to stall.velocity and up: slews and homing approaches are
+	covered, tracking and slow joystick moves, where SG_RESULT means
+	little, are not. Stays off until the axis is calibrated.
+ ====================================================================== */
+
+void MotorControl :: armStallGuard(bool enable) {
+
+	stallGuardArmed = enable;
+
+	if (_stallCaseNum == 0 && _homeCaseNum == 0) {
+		MotorControl :: _restoreStallGuard();
+	}
+}
+
+/* ======================================================================
+	True while stallStopped or verifyPosition still have to look at the
+	end of the last move: from a motion write until the motor parked or
+	stood. An armed guard or an encoder alone needs no polling at rest.
+ ====================================================================== */
+
+bool MotorControl :: checksPending() {
+
+	bool stallPending = stallGuardArmed && stall.calibrated && !_stallChecked;
+	bool encoderPending = encoder.enabled && IsPositionMode && !_encoderChecked;
+
+	return stallPending || encoderPending;
+}
+
+/* ======================================================================
+	True once after the guard stopped the motor. The stop itself needs no
+	software; this only has to notice it, so RAMP_STAT is read only when
+	the status byte shows the motor standing where it was not told to
+	stop (short of its target, or with VMAX above 0), and only once until
+	the next move. The motor is then released without picking up its old
+	target, see _releaseStall. Steps may have been lost on the way, the
+	axis no longer counts as homed.
+ ====================================================================== */
+
+bool MotorControl :: stallStopped() {
+
+	if (!stallGuardArmed || !stall.calibrated || _stallCaseNum != 0 || _homeCaseNum != 0) {
+		return false;
+	}
+
+	MotorControl :: refreshStatusFlags(STATUS_FLAGS_MAX_AGE_MS);
+
+	bool parked = IsPositionMode ? snapshot.get(STATUS_BIT_POSITION_REACHED) : (VMAX.data == 0);
+	if (parked) {
+		_stallChecked = true;							// nothing to watch until the next move
+	}
+	if (_stallChecked || !snapshot.get(STATUS_BIT_STANDSTILL)) {
+		return false;
+	}
+
+	_stallChecked = true;
+
+	if ((MotorControl :: readRegister(ADDRESS_RAMPSTAT) & ADDRESS_RS_EV_STOP_SG) == 0) {
+		return false;
+	}
+
+	MotorControl :: _releaseStall();
+	_isHomed = false;
+	stallStops++;
+
+	#ifdef DEBUG_MOTOR
+	Serial.print(motorID);
+	Serial.println(F(" : Stall stop."));
+	#endif
+
+	return true;
+}
+
+/* ======================================================================
+	SGT and the TSTEP of velocity (VMAX units) as TCOOLTHRS, below that
+	speed StallGuard neither flags nor stops, see _setChopper. velocity 0
+	turns stall detection off.
+ ====================================================================== */
+
+void MotorControl :: _setStallThreshold(int8_t sgt, unsigned long velocity) {
+
+	COOLCONF.data = TMC5130::COOLCONF::sgt::set(COOLCONF.data, (uint32_t)(int32_t)sgt);
+	_stallVelocity = velocity;
+	MotorControl :: _setChopper();
+}
+
+void MotorControl :: _setStallStop(bool enable) {
+
+	SW_MODE.data = enable ? (SW_MODE.data | ADDRESS_SW_SG_STOP) : (SW_MODE.data & ~ADDRESS_SW_SG_STOP);
+	MotorControl :: sendData(&SW_MODE);
+}
+
+/* ======================================================================
+	Stall detection as the guard wants it once a calibration or homing
+	is over: from stall.velocity up with sg_stop if armed, off if not.
+ ====================================================================== */
+
+void MotorControl :: _restoreStallGuard() {
+
+	bool guard = stallGuardArmed && stall.calibrated;
+
+	MotorControl :: _setStallThreshold(stall.calibrated ? stall.sgt : 0, guard ? stall.velocity : 0);
+	MotorControl :: _setStallStop(guard);
+}
+
+/* ======================================================================
+	Frees the motor after a stall stop without letting it move. Clearing
+	the event releases the ramp, which would head for the old target
+	again, so it is parked first: VMAX 0 and XTARGET at XACTUAL. sg_stop
+	is dropped while clearing (datasheet SW_MODE) and set again after if
+	the guard is armed.
+ ====================================================================== */
+
+void MotorControl :: _releaseStall() {
+
+	MotorControl :: setVelocity(0);
+	MotorControl :: setXtarget(MotorControl :: getXactual());
+	MotorControl :: _setStallStop(false);
+
+	datagram clearStall;
+	clearStall.rw = WRITE;
+	clearStall.address = ADDRESS_RAMPSTAT;
+	clearStall.data = ADDRESS_RS_EV_STOP_SG;
+	MotorControl :: sendData(&clearStall);
+
+	MotorControl :: _setStallStop(stallGuardArmed && stall.calibrated);
+
+	// Steps lost against the obstacle, the count follows the rotor instead
+	if (encoder.enabled) {
+		MotorControl :: readEncoder();
+		MotorControl :: setXtarget(encoder.xenc);
+		MotorControl :: setXactual(encoder.xenc);
+	}
+}
+
+//==============================================================
+//========================== ENCODER ===========================
+//==============================================================
+
+/* ======================================================================
+	Sets up the ABN encoder of the axis. XENC gains ENC_CONST for every
+	encoder count, so ENC_CONST is usteps per count: the usteps per degree
+	of the current resolution over countsPerDegree, in 16.16 binary fixed
+	point. A negative countsPerDegree flips an encoder that counts the
+	other way. XENC starts at XACTUAL, call it with the axis at rest.
+	0 turns the encoder off, ENCMODE stays as it is.
+ ====================================================================== */
+
+void MotorControl :: setEncoder(float countsPerDegree) {
+
+	encoder = encoderState();
+
+	if (countsPerDegree == 0.0f) {
+		return;
+	}
+
+	float stepsPerCount = (float)(MOTOR_STEPS_PER_DEGREE / _resolutionNum) / countsPerDegree;
+
+	datagram out;
+	out.rw = WRITE;
+
+	out.address = ADDRESS_ENCMODE;
+	out.data = 0x00000000;				// A/B as wired, N ignored, binary ENC_CONST
+	MotorControl :: sendData(&out);
+
+	out.address = ADDRESS_ENC_CONST;
+	out.data = (uint32_t)(int32_t)lroundf(stepsPerCount * 65536.0f);
+	MotorControl :: sendData(&out);
+
+	out.address = ADDRESS_XENC;
+	out.data = MotorControl :: getXactual();
+	MotorControl :: sendData(&out);
+
+	encoder.enabled = true;
+	encoder.tolerance = max(1UL, (unsigned long)lroundf(fabsf(stepsPerCount) * ENC_TOLERANCE_COUNTS));
+	_encoderChecked = false;
+	_encoderTarget = XTARGET.data;
+}
+
+/* ======================================================================
+	XACTUAL and XENC in one batch, three transfers, so both belong to the
+	same moment. The deviation is how far the rotor is behind the steps
+	given; running it is the load angle, within a full step, at rest it
+	is lost steps.
+ ====================================================================== */
+
+signed long MotorControl :: readEncoder() {
+
+	static const byte encoderRegisters[2] = {ADDRESS_XACTUAL, ADDRESS_XENC};
+	unsigned long values[2];
+
+	MotorControl :: readRegisters(encoderRegisters, values, 2);
+	_encoderTime = millis();
+
+	encoder.xactual = TMC5130::XACTUAL::value::getSigned(values[0]);
+	encoder.xenc = TMC5130::X_ENC::value::getSigned(values[1]);
+	encoder.deviation = encoder.xactual - encoder.xenc;
+	encoder.maxDeviation = max(encoder.maxDeviation, labs(encoder.deviation));
+
+	return encoder.deviation;
+}
+
+/* ======================================================================
+	Call it from the main loop. Refreshes the deviation every
+	ENC_SAMPLE_MS, and once per move, when the motor stands at its
+	target, checks it against the tolerance. Steps lost on the way are
+	made good then: XACTUAL is set to XENC, which in position mode starts
+	the move to XTARGET again from where the rotor really is. That is
+	done at most ENC_MAX_CORRECTIONS times for one target, an axis that
+	is blocked is left alone after. Returns true for each correction.
+ ====================================================================== */
+
+bool MotorControl :: verifyPosition() {
+
+	if (!encoder.enabled) {
+		return false;
+	}
+
+	MotorControl :: refreshStatusFlags(STATUS_FLAGS_MAX_AGE_MS);
+
+	bool settled = IsPositionMode && snapshot.get(STATUS_BIT_POSITION_REACHED) && snapshot.get(STATUS_BIT_STANDSTILL);
+	bool check = settled && !_encoderChecked;
+
+	if (!check && (millis() - _encoderTime < ENC_SAMPLE_MS)) {
+		return false;
+	}
+
+	MotorControl :: readEncoder();
+
+	if (!check) {
+		return false;
+	}
+	_encoderChecked = true;
+
+	if (XTARGET.data != _encoderTarget) {
+		_encoderTarget = XTARGET.data;
+		encoder.retries = 0;
+	}
+
+	if ((unsigned long)labs(encoder.deviation) <= encoder.tolerance || encoder.retries >= ENC_MAX_CORRECTIONS) {
+		return false;
+	}
+
+	#ifdef DEBUG_MOTOR
+	Serial.print(motorID);
+	Serial.print(F(" : Lost steps: "));
+	Serial.println(encoder.deviation);
+	#endif
+
+	encoder.retries++;
+	encoder.corrections++;
+	MotorControl :: setXactual(encoder.xenc);
+	return true;
+}
+
+//==============================================================
+//======================= DRIVER PROFILE =======================
+//==============================================================
+
+/* ======================================================================
+	Sets the chopper bands of the axis, see _setChopper. A profile that
+	is not enabled leaves the driver as begin() set it, spreadCycle at
+	IRUN at every speed. stealthChop is switched on and off through
+	GCONF, which the datasheet only allows at standstill: call it with
+	the motor at rest.
+ ====================================================================== */
+
+void MotorControl :: setDriverProfile(const driverProfile & profile) {
+
+	driver = profile;
+	MotorControl :: _setChopper();
+}
+
+uint8_t MotorControl :: getCurrentScale() {
+	return TMC5130::DRV_STATUS::CS_ACTUAL::get(MotorControl :: readRegister<TMC5130::DRV_STATUS>());
+}
+
+/* ======================================================================
+	Loads the driver profile, within what stall detection needs. The
+	chip picks the chopper by TSTEP, with a little hysteresis:
+		below stealthVelocity	stealthChop, quiet and cool at tracking
+								speeds, no StallGuard2 and no coolStep.
+		coolVelocity and up		spreadCycle with coolStep, the current
+								follows SG_RESULT between IRUN and half
+								(or a quarter) of it, low at light load.
+		highVelocity and up		spreadCycle at IRUN, coolStep off, the
+								torque a fast slew needs.
+	Other speeds run spreadCycle at IRUN. TCOOLTHRS gates coolStep and
+	StallGuard2 alike, so while stall detection is on it stays at
+	_stallVelocity or above, stealthChop ends there, and THIGH is 0 for
+	the guard to see the whole slew. A calibration sweep runs on plain
+	spreadCycle at IRUN, a changing current would move SG_RESULT. The
+	register shadow drops what did not change, calls are cheap.
+ ====================================================================== */
+
+void MotorControl :: _setChopper() {
+
+	bool tuned = driver.enabled && _stallCaseNum == 0;
+	unsigned long stealth = tuned ? driver.stealthVelocity : 0;
+	unsigned long cool = tuned ? driver.coolVelocity : 0;
+	unsigned long high = tuned ? driver.highVelocity : 0;
+	bool coolStep = cool > 0;
+
+	if (_stallVelocity > 0) {
+		cool = max(cool, _stallVelocity);
+		high = 0;
+	}
+	if (cool > 0 && stealth > cool) {
+		stealth = cool;
+	}
+
+	if (stealth > 0) {
+		PWMCONF.data = PWMCONF_STEALTH;
+		MotorControl :: sendData(&PWMCONF);
+	}
+	GCONF.data = TMC5130::GCONF::en_pwm_mode::set(GCONF.data, stealth > 0);
+	MotorControl :: sendData(&GCONF);
+
+	TPWMTHRS.data = TMC5130::TPWMTHRS::value::encode(MotorControl :: _tstep(stealth));
+	MotorControl :: sendData(&TPWMTHRS);
+
+	// semin 0 turns coolStep off, SGT stays
+	COOLCONF.data = TMC5130::COOLCONF::semin::set(COOLCONF.data, coolStep ? DRV_SEMIN : 0);
+	COOLCONF.data = TMC5130::COOLCONF::semax::set(COOLCONF.data, DRV_SEMAX);
+	COOLCONF.data = TMC5130::COOLCONF::seup::set(COOLCONF.data, DRV_SEUP);
+	COOLCONF.data = TMC5130::COOLCONF::sedn::set(COOLCONF.data, DRV_SEDN);
+	COOLCONF.data = TMC5130::COOLCONF::seimin::set(COOLCONF.data, driver.quarterCurrent);
+	MotorControl :: sendData(&COOLCONF);
+
+	TCOOLTHRS.data = TMC5130::TCOOLTHRS::value::encode(MotorControl :: _tstep(cool));
+	MotorControl :: sendData(&TCOOLTHRS);
+
+	THIGH.data = TMC5130::THIGH::value::encode(MotorControl :: _tstep(high));
+	MotorControl :: sendData(&THIGH);
+}
+
+/* ======================================================================
+	TSTEP counts clocks per 1/256 microstep, 2^24 / VMAX at full
+	resolution. The thresholds compare against it, a higher speed is a
+	lower TSTEP.
+ ====================================================================== */
+
+unsigned long MotorControl :: _tstep(unsigned long velocity) {
+
+	if (velocity == 0) {
+		return 0;
+	}
+	return min(16777216UL / (velocity * _resolutionNum), (unsigned long)TMC5130::TSTEP::value::max);
+}
+
+//==============================================================
+//====================== POSITION COMPARE ======================
+//==============================================================
+
+/* ======================================================================
+	Loads X_COMPARE. The chip drives SWP_DIAG1 active while XACTUAL
+	equals it, a pulse of one microstep when the axis runs through, at
+	the exact position whatever the bus and the main loop are doing.
+	SCAN_COMPARE_PARKED puts it where the axis never gets.
+ ====================================================================== */
+
+void MotorControl :: setCompare(signed long position) {
+
+	datagram out;
+	out.rw = WRITE;
+	out.address = ADDRESS_X_COMPARE;
+	out.data = TMC5130::X_COMPARE::value::encode((unsigned long)position);
+	MotorControl :: sendData(&out);
+}
+
+/* ======================================================================
+	DIAG1 carries only the compare pulse while the other diag1 sources
+	(stall, index, onstate, steps skipped) stay off, begin() leaves them
+	so. Open collector it pulls low and needs a pull-up at the trigger
+	input, push-pull it drives high.
+ ====================================================================== */
+
+void MotorControl :: setCompareOutput(bool pushPull) {
+
+	GCONF.data = TMC5130::GCONF::diag1_pushpull::set(GCONF.data, pushPull);
+	MotorControl :: sendData(&GCONF);
+}
+
+/* ======================================================================
+	DIAG0 as an interrupt line: open collector, pulled low on a driver
+	error (overtemperature, short, undervoltage) and on a stall, see
+	armStallGuard. Needs a pull-up at the input.
+ ====================================================================== */
+
+void MotorControl :: setDiag0Events(bool enable) {
+
+	GCONF.data = TMC5130::GCONF::diag0_error::set(GCONF.data, enable);
+	GCONF.data = TMC5130::GCONF::diag0_stall::set(GCONF.data, enable);
+	GCONF.data = TMC5130::GCONF::diag0_int_pushpull::set(GCONF.data, 0);
+	MotorControl :: sendData(&GCONF);
+}
+
+//==============================================================
+//====================== POSITION ESTIMATE =====================
+//==============================================================
+
+// Register units to usteps/s and usteps/s^2 (datasheet chp. 14)
+static const float EST_V_UNIT = TMC5130_FCLK / 16777216.0;
+static const float EST_A_UNIT = TMC5130_FCLK * TMC5130_FCLK / 2199023255552.0;
+
+/* ======================================================================
+	XACTUAL without the bus where that is good enough. The estimate
+	starts from XACTUAL and VACTUAL read in one batch and follows the
+	ramp the chip runs from there, see _extrapolate. Ramp writes carry it
+	along (_estimateWrite), so joystick speed changes cost no read.
+	XACTUAL is read again once the error bound is over maxError, and at
+	least every XEST_MAX_AGE_MS: switch and stall stops are sudden, no
+	ramp predicts them.
+ ====================================================================== */
+
+signed long MotorControl :: estimateXactual(unsigned long maxError) {
+
+	unsigned long now = micros();
+
+	if (estimate.valid && (now - estimate.readTime) < XEST_MAX_AGE_MS * 1000UL) {
+
+		signed long x;
+		float v;
+		if (MotorControl :: _extrapolate(now, x, v) <= maxError) {
+			estimate.served++;
+			return x;
+		}
+	}
+
+	static const byte estimateRegisters[2] = {ADDRESS_XACTUAL, ADDRESS_VACTUAL};
+	unsigned long values[2];
+
+	MotorControl :: readRegisters(estimateRegisters, values, 2);
+	snapshot.xactual = values[0];
+	snapshot.vactual = values[1];
+
+	estimate.xactual = TMC5130::XACTUAL::value::getSigned(values[0]);
+	estimate.velocity = TMC5130::VACTUAL::value::getSigned(values[1]) * EST_V_UNIT;
+	estimate.bound = 0.0f;
+	estimate.stamp = micros();
+	estimate.readTime = estimate.stamp;
+	estimate.valid = true;
+	estimate.reads++;
+
+	return estimate.xactual;
+}
+
+/* ======================================================================
+	The estimate moved on to now, x and v, and how far x may be off. The
+	ramp is the one in the register shadow:
+		velocity modes	the speed heads for VMAX at AMAX, exact.
+		hold			the speed stays, exact.
+		position		at rest on XTARGET it stays there, exact. Moving,
+						the last speed is kept, not past XTARGET, and the
+						error grows by what the largest of A1, AMAX, DMAX
+						and D1 could have changed since.
+	The chip clock may be off TMC5130_FCLK by XEST_CLOCK_TOLERANCE, an
+	exact prediction is good to that share of the distance.
+ ====================================================================== */
+
+float MotorControl :: _extrapolate(unsigned long now, signed long & x, float & v) {
+
+	float dt = (now - estimate.stamp) * 1.0e-6f;
+	float v0 = estimate.velocity;
+	float dx = 0.0f;
+	float bound = 0.0f;
+
+	unsigned long mode = MotorControl :: _shadowValue(ADDRESS_RAMPMODE);
+
+	if (mode == ADDRESS_MODE_VELPOS || mode == ADDRESS_MODE_VELNEG) {
+
+		float target = MotorControl :: _shadowValue(ADDRESS_VMAX) * EST_V_UNIT;
+		float a = MotorControl :: _shadowValue(ADDRESS_AMAX) * EST_A_UNIT;
+		target = (mode == ADDRESS_MODE_VELPOS) ? target : -target;
+
+		// AMAX 0 never changes the speed
+		float change = target - v0;
+		float reach = (a > 0.0f) ? fabsf(change) / a : dt;
+		if (a == 0.0f) {
+			target = v0;
+		}
+
+		if (dt < reach) {
+			v = v0 + ((change > 0.0f) ? a * dt : -a * dt);
+			dx = 0.5f * (v0 + v) * dt;
+		}
+		else {
+			v = target;
+			dx = 0.5f * (v0 + target) * reach + target * (dt - reach);
+		}
+		bound = fabsf(dx) * XEST_CLOCK_TOLERANCE;
+	}
+	else if (mode == ADDRESS_MODE_HOLD) {
+
+		v = v0;
+		dx = v0 * dt;
+		bound = fabsf(dx) * XEST_CLOCK_TOLERANCE;
+	}
+	else if (MotorControl :: _estimateBounded()) {
+
+		float remaining = (float)(TMC5130::XTARGET::value::getSigned(MotorControl :: _shadowValue(ADDRESS_XTARGET)) - estimate.xactual);
+		unsigned long accel = max(max(MotorControl :: _shadowValue(ADDRESS_A1), MotorControl :: _shadowValue(ADDRESS_AMAX)),
+								  max(MotorControl :: _shadowValue(ADDRESS_DMAX), MotorControl :: _shadowValue(ADDRESS_D1)));
+
+		v = v0;
+		dx = v0 * dt;
+		if (dx * remaining > 0.0f && fabsf(dx) > fabsf(remaining)) {
+			dx = remaining;
+		}
+		bound = fabsf(dx) * XEST_CLOCK_TOLERANCE + 0.5f * accel * EST_A_UNIT * dt * dt;
+	}
+	else {
+		v = 0.0f;
+	}
+
+	x = estimate.xactual + lroundf(dx);
+	return estimate.bound + bound;
+}
+
+bool MotorControl :: _estimateBounded() {
+
+	if (MotorControl :: _shadowValue(ADDRESS_RAMPMODE) != ADDRESS_MODE_POSITION) {
+		return false;
+	}
+	signed long target = TMC5130::XTARGET::value::getSigned(MotorControl :: _shadowValue(ADDRESS_XTARGET));
+	return estimate.velocity != 0.0f || estimate.xactual != target;
+}
+
+/* ======================================================================
+	Called with every write before it reaches the shadow, which still
+	holds the ramp the estimate runs on. A change to that ramp moves the
+	estimate on to now first, the new ramp takes over from there, and a
+	write to XACTUAL moves it outright. A position move is only bounded
+	and cannot be carried over to another ramp, the next estimate reads.
+ ====================================================================== */
+
+void MotorControl :: _estimateWrite(const datagram * out) {
+
+	if (out->rw != WRITE || !estimate.valid) {
+		return;
+	}
+
+	switch (out->address) {
+		case ADDRESS_RAMPMODE:
+		case ADDRESS_VMAX:
+		case ADDRESS_AMAX:
+		case ADDRESS_XTARGET:
+		case ADDRESS_A1:
+		case ADDRESS_DMAX:
+		case ADDRESS_D1:
+			if (MotorControl :: _shadowValue(out->address) == out->data) {
+				return;
+			}
+			break;
+		case ADDRESS_XACTUAL:
+			break;
+		default:
+			return;
+	}
+
+	if (MotorControl :: _estimateBounded()) {
+		estimate.valid = false;
+		return;
+	}
+
+	unsigned long now = micros();
+	signed long x;
+	float v;
+
+	estimate.bound = MotorControl :: _extrapolate(now, x, v);
+	estimate.xactual = (out->address == ADDRESS_XACTUAL) ? TMC5130::XACTUAL::value::getSigned(out->data) : x;
+	estimate.velocity = v;
+	estimate.stamp = now;
+}
+
 /* ======================================================================
 	Function sends commands to rotate the motor the number of half-steps
 	specified in the forward direction. Returns true if the commands are 
@@ -1102,7 +2563,7 @@ void MotorControl ::constForward(unsigned long velocity)
 	{
 		MotorControl ::setRampMode(forwardDirection.address);
 	}
- 	currentPosition = MotorControl ::getXactual();
+ 	currentPosition = MotorControl ::estimateXactual(XEST_LIMIT_ERROR);
 	if (MotorControl ::motorID == 1)
 	{
 		if ((currentPosition < (-90*MOTOR_STEPS_PER_DEGREE)) || (currentPosition > (90*MOTOR_STEPS_PER_DEGREE))) // Limit range betwee -90 and 90 degress
@@ -1147,7 +2608,7 @@ void MotorControl ::constReverse(unsigned long velocity)
 	{
 		MotorControl ::setRampMode(backwardDirection.address);
 	}
- 	currentPosition = MotorControl ::getXactual();
+ 	currentPosition = MotorControl ::estimateXactual(XEST_LIMIT_ERROR);
 	if (MotorControl ::motorID == 0)
 	{
 		if ((currentPosition < -4582400) || (currentPosition >= 4608000)) // Limit range between -179 and 180 degrees
@@ -1189,6 +2650,25 @@ void MotorControl ::constReverse(unsigned long velocity)
 
 
 
+/* ======================================================================
+	Runs in velocity mode at velocity usteps/s, positive towards higher
+	XACTUAL whatever swapDirection set. The speed is clamped to the VMAX
+	limit of the planner. No range check, the caller keeps the axis in
+	its travel.
+ ====================================================================== */
+
+void MotorControl :: runAt(double velocity) {
+
+	double vmax = fabs(velocity) * 16777216.0 / TMC5130_FCLK;
+	if (vmax > planner.limits.vmax) {
+		vmax = planner.limits.vmax;
+	}
+
+	// You must set velocity after ramp mode otherwise will go in the positive direction
+	MotorControl :: setRampMode((velocity < 0.0) ? ADDRESS_MODE_VELNEG : ADDRESS_MODE_VELPOS);
+	MotorControl :: setVelocity(lround(vmax));
+}
+
 /* ======================================================================
 	Function sends commands to stop the motor when it is in a constant reverse
 	or in a constant forward movement.
@@ -14,68 +14,74 @@
 #include <SPI.h>
 #include "Arduino.h"
 #include "Joystick.h"
-
-
-
-
-// Define Registers for TMC5130
-#define ADDRESS_GCONF      	0x00
-#define ADDRESS_GSTAT      	0x01
-#define ADDRESS_IFCNT      	0x02
-#define ADDRESS_SLAVECONF  	0x03
-#define ADDRESS_INP_OUT    	0x04
-#define ADDRESS_X_COMPARE  	0x05
-#define ADDRESS_IHOLD_IRUN 	0x10
-#define ADDRESS_TZEROWAIT  	0x11
-#define ADDRESS_TSTEP  		0x12
-#define ADDRESS_TPWMTHRS  	0x13
-#define ADDRESS_TCOOLTHRS  	0x14
-#define ADDRESS_THIGH      	0x15
-
-#define ADDRESS_RAMPMODE   	0x20
-#define ADDRESS_XACTUAL    	0x21
-#define ADDRESS_VACTUAL    	0x22
-#define ADDRESS_VSTART     	0x23
-#define ADDRESS_A1         	0x24
-#define ADDRESS_V1         	0x25
-#define ADDRESS_AMAX       	0x26
-#define ADDRESS_VMAX       	0x27
-#define ADDRESS_DMAX       	0x28
-#define ADDRESS_D1         	0x2A
-#define ADDRESS_VSTOP      	0x2B
-#define ADDRESS_TZEROCROSS 	0x2C
-#define ADDRESS_XTARGET    	0x2D
-
-#define ADDRESS_VDCMIN     	0x33
-#define ADDRESS_SWMODE     	0x34
-#define ADDRESS_RAMPSTAT   	0x35
-#define ADDRESS_XLATCH     	0x36
-#define ADDRESS_ENCMODE    	0x38
-#define ADDRESS_XENC       	0x39
-#define ADDRESS_ENC_CONST  	0x3A
-#define ADDRESS_ENC_STATUS 	0x3B
-#define ADDRESS_ENC_LATCH  	0x3C
-
-#define ADDRESS_MSLUT0     	0x60
-#define ADDRESS_MSLUT1     	0x61
-#define ADDRESS_MSLUT2     	0x62
-#define ADDRESS_MSLUT3     	0x63
-#define ADDRESS_MSLUT4     	0x64
-#define ADDRESS_MSLUT5     	0x65
-#define ADDRESS_MSLUT6     	0x66
-#define ADDRESS_MSLUT7     	0x67
-#define ADDRESS_MSLUTSEL   	0x68
-#define ADDRESS_MSLUTSTART 	0x69
-#define ADDRESS_MSCNT      	0x6A
-#define ADDRESS_MSCURACT   	0x6B
-#define ADDRESS_CHOPCONF   	0x6C
-#define ADDRESS_COOLCONF   	0x6D
-#define ADDRESS_DCCTRL     	0x6E
-#define ADDRESS_DRVSTATUS  	0x6F
-#define ADDRESS_PWMCONF  	0x70
-#define ADDRESS_PWMSTATUS 	0x71
-#define ADDRESS_EN_CTRL 	0x72
-#define ADDRESS_LOST_STEPS 	0x73
+#include "TMC5130_Registers.h"
+#include "CycleCounter.h"
+#include "RampPlanner.h"
+
+
+
+
+// Register addresses for TMC5130, see TMC5130_Registers.h for the map
+#define ADDRESS_GCONF      	TMC5130::GCONF::address
+#define ADDRESS_GSTAT      	TMC5130::GSTAT::address
+#define ADDRESS_IFCNT      	TMC5130::IFCNT::address
+#define ADDRESS_SLAVECONF  	TMC5130::SLAVECONF::address
+#define ADDRESS_INP_OUT    	TMC5130::IOIN::address
+#define ADDRESS_X_COMPARE  	TMC5130::X_COMPARE::address
+#define ADDRESS_IHOLD_IRUN 	TMC5130::IHOLD_IRUN::address
+#define ADDRESS_TPOWERDOWN 	TMC5130::TPOWERDOWN::address
+#define ADDRESS_TZEROWAIT  	TMC5130::TPOWERDOWN::address	// historical name of 0x11
+#define ADDRESS_TSTEP  		TMC5130::TSTEP::address
+#define ADDRESS_TPWMTHRS  	TMC5130::TPWMTHRS::address
+#define ADDRESS_TCOOLTHRS  	TMC5130::TCOOLTHRS::address
+#define ADDRESS_THIGH      	TMC5130::THIGH::address
+
+#define ADDRESS_RAMPMODE   	TMC5130::RAMPMODE::address
+#define ADDRESS_XACTUAL    	TMC5130::XACTUAL::address
+#define ADDRESS_VACTUAL    	TMC5130::VACTUAL::address
+#define ADDRESS_VSTART     	TMC5130::VSTART::address
+#define ADDRESS_A1         	TMC5130::A1::address
+#define ADDRESS_V1         	TMC5130::V1::address
+#define ADDRESS_AMAX       	TMC5130::AMAX::address
+#define ADDRESS_VMAX       	TMC5130::VMAX::address
+#define ADDRESS_DMAX       	TMC5130::DMAX::address
+#define ADDRESS_D1         	TMC5130::D1::address
+#define ADDRESS_VSTOP      	TMC5130::VSTOP::address
+#define ADDRESS_TZEROCROSS 	TMC5130::TZEROWAIT::address		// historical name of 0x2C
+#define ADDRESS_XTARGET    	TMC5130::XTARGET::address
+
+#define ADDRESS_VDCMIN     	TMC5130::VDCMIN::address
+#define ADDRESS_SWMODE     	TMC5130::SW_MODE::address
+#define ADDRESS_RAMPSTAT   	TMC5130::RAMP_STAT::address
+#define ADDRESS_XLATCH     	TMC5130::XLATCH::address
+#define ADDRESS_ENCMODE    	TMC5130::ENCMODE::address
+#define ADDRESS_XENC       	TMC5130::X_ENC::address
+#define ADDRESS_ENC_CONST  	TMC5130::ENC_CONST::address
+#define ADDRESS_ENC_STATUS 	TMC5130::ENC_STATUS::address
+#define ADDRESS_ENC_LATCH  	TMC5130::ENC_LATCH::address
+
+#define ADDRESS_MSLUT0     	TMC5130::MSLUT0::address
+#define ADDRESS_MSLUT1     	TMC5130::MSLUT1::address
+#define ADDRESS_MSLUT2     	TMC5130::MSLUT2::address
+#define ADDRESS_MSLUT3     	TMC5130::MSLUT3::address
+#define ADDRESS_MSLUT4     	TMC5130::MSLUT4::address
+#define ADDRESS_MSLUT5     	TMC5130::MSLUT5::address
+#define ADDRESS_MSLUT6     	TMC5130::MSLUT6::address
+#define ADDRESS_MSLUT7     	TMC5130::MSLUT7::address
+#define ADDRESS_MSLUTSEL   	TMC5130::MSLUTSEL::address
+#define ADDRESS_MSLUTSTART 	TMC5130::MSLUTSTART::address
+#define ADDRESS_MSCNT      	TMC5130::MSCNT::address
+#define ADDRESS_MSCURACT   	TMC5130::MSCURACT::address
+#define ADDRESS_CHOPCONF   	TMC5130::CHOPCONF::address
+#define ADDRESS_COOLCONF   	TMC5130::COOLCONF::address
+#define ADDRESS_DCCTRL     	TMC5130::DCCTRL::address
+#define ADDRESS_DRVSTATUS  	TMC5130::DRV_STATUS::address
+#define ADDRESS_PWMCONF  	TMC5130::PWMCONF::address
+#define ADDRESS_PWMSTATUS 	TMC5130::PWM_SCALE::address
+#define ADDRESS_EN_CTRL 	TMC5130::ENCM_CTRL::address
+#define ADDRESS_LOST_STEPS 	TMC5130::LOST_STEPS::address
+
+#define TMC5130_REGISTER_COUNT	0x80
 
 // Register ADDRESS_RAMPMODE
 #define ADDRESS_MODE_POSITION   0
@@ -84,35 +90,58 @@
 #define ADDRESS_MODE_HOLD       3
 
 // Register ADDRESS_SWMODE
-#define ADDRESS_SW_STOPL_ENABLE   0x0001
-#define ADDRESS_SW_STOPR_ENABLE   0x0002
-#define ADDRESS_SW STOPL_POLARITY 0x0004
-#define ADDRESS_SW_STOPR_POLARITY 0x0008
-#define ADDRESS_SW_SWAP_LR        0x0010
-#define ADDRESS_SW_LATCH_L_ACT    0x0020
-#define ADDRESS_SW_LATCH_L_INACT  0x0040
-#define ADDRESS_SW_LATCH_R_ACT    0x0080
-#define ADDRESS_SW_LATCH_R_INACT  0x0100
-#define ADDRESS_SW_LATCH_ENC      0x0200
-#define ADDRESS_SW_SG_STOP        0x0400
-#define ADDRESS_SW_SOFTSTOP       0x0800
+#define ADDRESS_SW_STOPL_ENABLE   TMC5130::SW_MODE::stop_l_enable::mask
+#define ADDRESS_SW_STOPR_ENABLE   TMC5130::SW_MODE::stop_r_enable::mask
+#define ADDRESS_SW_STOPL_POLARITY TMC5130::SW_MODE::pol_stop_l::mask
+#define ADDRESS_SW_STOPR_POLARITY TMC5130::SW_MODE::pol_stop_r::mask
+#define ADDRESS_SW_SWAP_LR        TMC5130::SW_MODE::swap_lr::mask
+#define ADDRESS_SW_LATCH_L_ACT    TMC5130::SW_MODE::latch_l_active::mask
+#define ADDRESS_SW_LATCH_L_INACT  TMC5130::SW_MODE::latch_l_inactive::mask
+#define ADDRESS_SW_LATCH_R_ACT    TMC5130::SW_MODE::latch_r_active::mask
+#define ADDRESS_SW_LATCH_R_INACT  TMC5130::SW_MODE::latch_r_inactive::mask
+#define ADDRESS_SW_LATCH_ENC      TMC5130::SW_MODE::en_latch_encoder::mask
+#define ADDRESS_SW_SG_STOP        TMC5130::SW_MODE::sg_stop::mask
+#define ADDRESS_SW_SOFTSTOP       TMC5130::SW_MODE::en_softstop::mask
 
 
 // Register ADDRESS_RAMPSTAT
-#define ADDRESS_RS_STOPL          0x0001
-#define ADDRESS_RS_STOPR          0x0002
-#define ADDRESS_RS_LATCHL         0x0004
-#define ADDRESS_RS_LATCHR         0x0008
-#define ADDRESS_RS_EV_STOPL       0x0010
-#define ADDRESS_RS_EV_STOPR       0x0020
-#define ADDRESS_RS_EV_STOP_SG     0x0040
-#define ADDRESS_RS_EV_POSREACHED  0x0080
-#define ADDRESS_RS_VELREACHED     0x0100
-#define ADDRESS_RS_POSREACHED     0x0200
-#define ADDRESS_RS_VZERO          0x0400
-#define ADDRESS_RS_ZEROWAIT       0x0800
-#define ADDRESS_RS_SECONDMOVE     0x1000
-#define ADDRESS_RS_SG             0x2000
+#define ADDRESS_RS_STOPL          TMC5130::RAMP_STAT::status_stop_l::mask
+#define ADDRESS_RS_STOPR          TMC5130::RAMP_STAT::status_stop_r::mask
+#define ADDRESS_RS_LATCHL         TMC5130::RAMP_STAT::status_latch_l::mask
+#define ADDRESS_RS_LATCHR         TMC5130::RAMP_STAT::status_latch_r::mask
+#define ADDRESS_RS_EV_STOPL       TMC5130::RAMP_STAT::event_stop_l::mask
+#define ADDRESS_RS_EV_STOPR       TMC5130::RAMP_STAT::event_stop_r::mask
+#define ADDRESS_RS_EV_STOP_SG     TMC5130::RAMP_STAT::event_stop_sg::mask
+#define ADDRESS_RS_EV_POSREACHED  TMC5130::RAMP_STAT::event_pos_reached::mask
+#define ADDRESS_RS_VELREACHED     TMC5130::RAMP_STAT::velocity_reached::mask
+#define ADDRESS_RS_POSREACHED     TMC5130::RAMP_STAT::position_reached::mask
+#define ADDRESS_RS_VZERO          TMC5130::RAMP_STAT::vzero::mask
+#define ADDRESS_RS_ZEROWAIT       TMC5130::RAMP_STAT::t_zerowait_active::mask
+#define ADDRESS_RS_SECONDMOVE     TMC5130::RAMP_STAT::second_move::mask
+#define ADDRESS_RS_SG             TMC5130::RAMP_STAT::status_sg::mask
+
+// SPI_STATUS, first byte of every reply (datasheet chp. 4.1.2)
+#define SPI_STATUS_RESET_FLAG       0x01
+#define SPI_STATUS_DRIVER_ERROR     0x02
+#define SPI_STATUS_SG2              0x04
+#define SPI_STATUS_STANDSTILL       0x08
+#define SPI_STATUS_VELOCITY_REACHED 0x10
+#define SPI_STATUS_POSITION_REACHED 0x20
+#define SPI_STATUS_STOP_L           0x40
+#define SPI_STATUS_STOP_R           0x80
+
+// Harvested status flags younger than this are served without a transfer
+#define STATUS_FLAGS_MAX_AGE_MS     50
+
+// SPI interface timing, see datasheet chp. 4.3. CSN setup/hold (tCC, 10ns)
+// is covered by the digitalWrite latency on the SAM3X, the CSN high time
+// (tCSH, 2 tCLK + 10ns at the internal 12MHz clock) by a 1us wait.
+#define TMC5130_SPI_CLOCK         4000000
+#define TMC5130_CSN_HIGH_US       1
+
+// Register/direction pairs whose SPI traffic is kept per motor. begin()
+// alone fills about 20, further pairs are only counted in spiStatsLost.
+#define SPI_STATS_SLOTS           24
 
 enum : uint8_t {
     // 1-9 reserved for variables
@@ -146,11 +175,46 @@ enum : uint8_t {
     JS_TOGGLE_CNTRL         = 40, // D Mtrl Control
     JS_ENABLE              	= 41, //joystick
     MOTOR_STOP              = 42, //emergency stop
-    MOTOR_HOME              = 43, //DONT USE THIS
+    MOTOR_HOME              = 43, //home on the forward switch, runs in the background
     SEEK                    = 44, //DONT USE THIS
     RESOLUTION              = 45,
     ACTIVESETTINGS          = 46,
-    PCPING                  = 49
+    MOTOR_HOME_SENSORLESS   = 47, //home on the forward hard stop by StallGuard, needs STALL_CALIBRATE
+    PCPING                  = 49,
+    // 50-59 reserved for diagnostics
+    REQUEST_SPI_BENCH       = 50,
+    GET_SPI_RATE            = 51,
+    GET_SPI_STATS           = 52,
+    RESET_SPI_STATS         = 53,
+    STALL_CALIBRATE         = 54, //sweeps SGT and speed for a StallGuard threshold, moves the axis a little
+    GET_STALL_PROFILE       = 55,
+    SET_STALL_GUARD         = 56, //(motor, enable) hardware stop on a stall while slewing
+    SET_ENCODER             = 57, //(motor, encoder counts per degree of the axis) 0 turns it off
+    GET_ENCODER             = 58,
+    GET_TASK_STATS          = 59, //(reset) lateness of the scheduled tasks, reset clears it after the reply
+    // 60-69 reserved for coordinated motion and tracking
+    SET_MOVE_SYNC           = 60, //move motors 0 and 1 to absolute pos, arriving together
+    SET_MOVE_PLANNED        = 61, //move to absolute pos on the planned six point ramp
+    SET_RAMP_LOAD           = 62, //load on the axis in % of its own inertia, for the planner
+    START_TRACKING          = 63, //motors 0 and 1 follow the star they point at (latitude)
+    STOP_TRACKING           = 64,
+    SET_TRACK_SYNC          = 65, //re-sync tracking, the star is at (altitude, azimuth) now
+    SET_SITE                = 66, //observer (latitude, longitude), degrees north and east
+    SET_TIME                = 67, //UTC now, unix seconds
+    SET_MOVE_RADEC          = 68, //goto a J2000 star (ra hours, dec degrees), arriving together
+    // 70-79 reserved for trajectory streaming
+    PVT_START               = 70, //run the queued points, their times count from now
+    PVT_UPLOAD              = 71, //(count, binary pvtPoint...) appended to the queue
+    PVT_STOP                = 72,
+    GET_PVT_STATUS          = 73,
+    SCAN_START              = 74, //(columns, rows, spacing degrees, velocity) raster around the pointing, DIAG1 of motor 0 triggers at the points
+    SCAN_STOP               = 75,
+    GET_SCAN_STATUS         = 76,
+    // 80-89 reserved for driver tuning
+    SET_DRIVER_PROFILE      = 80, //(motor, stealth velocity, cool velocity, high velocity, quarter current) all 0 = plain spreadCycle
+    GET_DRIVER_PROFILE      = 81,
+    // 90-99 reserved for profiling
+    GET_LOOP_PROFILE        = 90  //(reset) cycle histograms of the loop stages and tasks, binary reply, reset clears them after it
 };
 
 struct datagram {
@@ -161,6 +225,134 @@ struct datagram {
 		byte responseFlags = 0x0;
 };
 
+// Bus settings shared by every TMC5130 transfer, blocking or queued
+extern const SPISettings TMC5130_SPI_SETTINGS;
+
+// Called once the reply of a queued datagram has been clocked in. On the
+// Due this runs in the DMAC interrupt, keep it short.
+typedef void (*datagramCallback)(uint8_t motorID, const datagram * reply);
+
+struct spiTransaction {
+	public:
+		byte csPin = 0;
+		bool legacyTiming = false;				// replays the old 1ms CS delays, benchmarking only
+
+		unsigned long transfers = 0;			// datagrams sent since power up
+
+		void begin();							// claim the bus and pull CS low
+		void end();								// release CS and the bus, count the transfer
+		unsigned long transfersPerSecond();		// datagrams sent in the last full second
+
+	private:
+		unsigned long _windowStart = 0;
+		unsigned long _windowTransfers = 0;
+		unsigned long _lastWindowTransfers = 0;
+};
+
+// SPI traffic on one register in one direction, see MotorControl::spiStats
+struct spiRegisterStats {
+	public:
+		byte header = 0;						// rw << 7 | address, as sent on the wire
+		unsigned long transfers = 0;
+		unsigned long maxCycles = 0;			// slowest single transfer
+		unsigned long long totalCycles = 0;
+};
+
+// Bits of MotorSnapshot::statusBits, in the order of the 25 bit motor
+// status word the host already decodes (REQUEST_MOTOR_STATUS)
+enum : uint8_t {
+	STATUS_BIT_SG2                  = 0,
+	STATUS_BIT_SG2_EVENT            = 1,
+	STATUS_BIT_STANDSTILL           = 2,
+	STATUS_BIT_VELOCITY_REACHED     = 3,
+	STATUS_BIT_POSITION_REACHED     = 4,
+	STATUS_BIT_POSITION_EVENT       = 5,
+	STATUS_BIT_STOP_L               = 6,
+	STATUS_BIT_STOP_R               = 7,
+	STATUS_BIT_STOP_L_EVENT         = 8,
+	STATUS_BIT_STOP_R_EVENT         = 9,
+	STATUS_BIT_LATCH_L              = 10,
+	STATUS_BIT_LATCH_R              = 11,
+	STATUS_BIT_OPEN_LOAD_A          = 12,
+	STATUS_BIT_OPEN_LOAD_B          = 13,
+	STATUS_BIT_SHORT_GND_A          = 14,
+	STATUS_BIT_SHORT_GND_B          = 15,
+	STATUS_BIT_OT_WARNING           = 16,
+	STATUS_BIT_OT_SHUTDOWN          = 17,
+	STATUS_BIT_IS_REVERSE           = 18,
+	STATUS_BIT_RESET                = 19,
+	STATUS_BIT_DRIVER_ERROR         = 20,
+	STATUS_BIT_UNDERVOLTAGE         = 21,
+	STATUS_BIT_IS_FORWARD           = 22,
+	STATUS_BIT_IS_POSITION_MODE     = 23,
+	STATUS_BIT_IS_HOMED             = 24
+};
+
+// Everything known about the motor's state in one copyable block. The raw
+// registers are kept next to the packed flags so callers needing more than
+// a flag don't have to go back to the bus.
+struct MotorSnapshot {
+	public:
+		unsigned long time = 0;					// micros() of the last readStatus()
+		unsigned long rampStat = 0;
+		unsigned long drvStatus = 0;
+		unsigned long xactual = 0;
+		unsigned long vactual = 0;
+		uint32_t statusBits = 0;				// packed flags, see STATUS_BIT_*
+		byte gstat = 0;
+		byte spiStatus = 0;						// SPI_STATUS byte of the last reply
+
+		bool get(uint8_t bit) const { return (statusBits >> bit) & 1; }
+		void set(uint8_t bit, bool value) {
+			statusBits = value ? (statusBits | (1UL << bit)) : (statusBits & ~(1UL << bit));
+		}
+};
+
+// StallGuard2 setting of an axis, found by MotorControl :: calibrateStall
+struct stallProfile {
+	public:
+		bool calibrated = false;
+		int8_t sgt = 0;							// COOLCONF.sgt
+		unsigned long velocity = 0;				// VMAX, slowest speed stalls are detected at
+		unsigned int sgFree = 0;				// lowest SG_RESULT running free at that speed
+};
+
+// Chopper bands of an axis by speed, see MotorControl :: setDriverProfile
+struct driverProfile {
+	public:
+		bool enabled = false;
+		unsigned long stealthVelocity = 0;		// VMAX, stealthChop below, 0 never
+		unsigned long coolVelocity = 0;			// VMAX, coolStep from here up, 0 never
+		unsigned long highVelocity = 0;			// VMAX, full run current from here up, 0 never
+		bool quarterCurrent = false;			// coolStep may go down to 1/4 of IRUN, else 1/2
+};
+
+// Where XACTUAL should be, see MotorControl :: estimateXactual
+struct positionEstimate {
+	public:
+		bool valid = false;
+		signed long xactual = 0;				// at stamp
+		float velocity = 0.0f;					// usteps/s at stamp
+		float bound = 0.0f;						// usteps xactual may be off at stamp
+		unsigned long stamp = 0;				// micros()
+		unsigned long readTime = 0;				// micros() of the last XACTUAL read
+		unsigned long reads = 0;				// estimates that had to read XACTUAL
+		unsigned long served = 0;				// estimates served without the bus
+};
+
+// Encoder on an axis, see MotorControl :: setEncoder
+struct encoderState {
+	public:
+		bool enabled = false;
+		unsigned long tolerance = 0;			// usteps, ENC_TOLERANCE_COUNTS counts
+		signed long xactual = 0;				// read in one batch with xenc
+		signed long xenc = 0;
+		signed long deviation = 0;				// xactual - xenc, steps the rotor is behind
+		signed long maxDeviation = 0;			// largest |deviation| since setEncoder
+		unsigned long corrections = 0;			// moves repeated from the encoder position
+		uint8_t retries = 0;					// corrections of the current target
+};
+
 struct directionControl {
 	public: 
 		int activeEnableNum;
@@ -211,6 +403,10 @@ class MotorControl {
 		datagram DMAX;
 		datagram VSTOP;
 		datagram SW_MODE;
+		datagram COOLCONF;
+		datagram TCOOLTHRS;
+		datagram TPWMTHRS;
+		datagram THIGH;
 
 		datagram XACTUAL_READ;
 		datagram VACTUAL_READ;
@@ -225,38 +421,44 @@ class MotorControl {
 	    // SPI Reads
 	    datagram i_datagram;
 
-	    // Status Bits read in from registers
+	    // Plans goPosPlanned ramps within the limits of this axis
+	    RampPlanner planner;
+
+	    // SPI bus access for this motor's chip select
+	    spiTransaction spi;
+
+	    // Status read in from the registers and the SPI status byte
 	    // to check condition of the motor
-	    bool status_sg2;
-	    bool status_sg2_event;
-	    bool status_standstill;
-
-	    bool status_velocity_reached;
-	    bool status_position_reached;
-	    bool status_position_reached_event;
-
-	    bool status_stop_l;
-	    bool status_stop_r;
-	    bool status_stop_l_event;
-	    bool status_stop_r_event;
-	    bool status_latch_l;
-	    bool status_latch_r;
-
-	    bool status_openLoad_A;
-	    bool status_openLoad_B;
-	    bool status_shortToGround_A;
-	    bool status_shortToGround_B;
-
-	    bool status_overtemperatureWarning;
-	    bool status_overtemperatureShutdown;
-
-	    bool status_isReverse;
-	    bool status_resetDetected;
-	    bool status_driverError;
-	    bool status_underVoltage;
+	    MotorSnapshot snapshot;
 
 	    unsigned long sgStatusBits;
 
+	    // StallGuard threshold of this axis and whether stalls stop it in hardware
+	    stallProfile stall;
+	    bool stallGuardArmed;
+	    unsigned long stallStops;					// collisions stopped by the guard
+
+	    // Chopper and current control by speed
+	    driverProfile driver;
+
+	    // XACTUAL extrapolated along the ramp, see estimateXactual
+	    positionEstimate estimate;
+
+	    // Encoder reading and deviation, kept up to date by verifyPosition
+	    encoderState encoder;
+
+	    // Writes skipped because the register already held the value
+	    unsigned long droppedWrites;
+
+	    // Age of snapshot.spiStatus, see _harvestStatus
+	    unsigned long statusFlagsTime;				// micros() of the transfer it came from
+	    unsigned long statusReadsSaved;				// readStatus() round trips replaced by the harvest
+
+	    // Per register traffic of sendData(), in order of first use
+	    spiRegisterStats spiStats[SPI_STATS_SLOTS];
+	    uint8_t spiStatsUsed;
+	    unsigned long spiStatsLost;					// transfers on pairs beyond SPI_STATS_SLOTS
+
 	    bool forwardSwitch;
 	    bool backwardSwitch;
 
@@ -264,11 +466,22 @@ class MotorControl {
 		//======================= HELPER FUNCTIONS =====================
 
 		void sendData(datagram * datagram);
+		bool queueData(datagram * out, datagramCallback callback);	// non-blocking, sent by DMA
 		void getMotorData();
-		void readStatus();
+		void readRegisters(const byte * addresses, unsigned long * values, uint8_t count);	// count reads in count+1 transfers
+		unsigned long readRegister(byte address);
+
+		// Typed read, write only registers are served from the shadow
+		template <class REG> unsigned long readRegister() {
+			return REG::readable ? MotorControl :: readRegister(REG::address) : MotorControl :: _shadowValue(REG::address);
+		}
+		void readStatus();									// refreshes the whole snapshot
+		bool refreshStatusFlags(unsigned long maxAgeMs);	// true if served without a transfer
 		void sgStatus();
 		void buttonStatus();
 		void switchReference(bool rightIsREFR);
+		unsigned long benchmarkSpi(unsigned int count, bool legacyTiming);	// time count GCONF reads (us)
+		void resetSpiStats();
 
 
 		//================= ENABLE AND DISABLE FUNCTIONS ===============
@@ -299,6 +512,7 @@ class MotorControl {
 		unsigned long getDeceleration();
 		signed long getXtarget();
 		unsigned long getXactual();
+		signed long estimateXactual(unsigned long maxError);	// XACTUAL within maxError usteps, the bus only when needed
 		unsigned long getHomeXtarget();
 		unsigned long getRampMode();
 		bool getIsForward();
@@ -309,12 +523,35 @@ class MotorControl {
 		//===================== MOVEMENT FUNCTIONS ==================
 
 		bool goPos(unsigned long position); 				// brings the motor back to its home position
-		bool setHome(); 									// sets the home position using the right hand switch
+		bool goPosAt(unsigned long position, unsigned long velocity);	// goPos at VMAX velocity
+		bool queueMove(unsigned long position, datagramCallback callback); // goPos without waiting on the bus
+		rampProfile nominalRamp();							// the ramp goPos moves with
+		bool goPosPlanned(unsigned long position);			// goPos on the fastest ramp the planner finds
+		void armMove(const rampProfile & ramp);				// position mode with this ramp, setXtarget starts the move
+		bool setHome(); 									// one homing step on the forward switch, true once homed
+		void abortHome();									// stops a homing sequence in progress
+		bool isHoming();
+		bool setHomeSensorless();							// one homing step against the forward hard stop, true once homed
+		bool calibrateStall();								// one StallGuard calibration step, true once done
+		void abortCalibration();
+		bool isCalibrating();
+		void armStallGuard(bool enable);					// stop on a stall above stall.velocity, needs a calibration
+		bool stallStopped();								// the guard stopped the motor, the ramp is parked again
+		void setEncoder(float countsPerDegree);				// encoder counts per degree of the axis, 0 turns it off
+		signed long readEncoder();							// XACTUAL and XENC in one batch, returns the deviation
+		bool verifyPosition();								// true if it had to correct lost steps after a move
+		bool checksPending();								// a stall or encoder check waits for the end of a move
+		void setDriverProfile(const driverProfile & profile);	// chopper and coolStep bands, call at rest
+		uint8_t getCurrentScale();							// DRV_STATUS CS_ACTUAL, 0..31
+		void setCompare(signed long position);				// X_COMPARE, DIAG1 pulses as XACTUAL runs through it
+		void setCompareOutput(bool pushPull);				// DIAG1 push-pull active high or open collector active low
+		void setDiag0Events(bool enable);					// DIAG0 pulls low on a driver error or a stall
 		bool stop();
 		// bool movement(bool direction, bool type, unsigned long speed, unsigned long steps);
 		void swapDirection(bool swapDirection, bool swapSwitch);
 		void constForward(unsigned long velocity);							// moves the motor forward constantly
 		void constReverse(unsigned long velocity);							// moves the motor backwards constantly
+		void runAt(double velocity);										// velocity mode at usteps/s, the sign picks the direction
 		void forward(unsigned long stepsForward, unsigned long velocity); 	// push forward at the specified velocity
 		void reverse(unsigned long stepsBackward, unsigned long velocity);	// moves motor in reverse direction
 
@@ -324,12 +561,66 @@ class MotorControl {
 		int _enablePin;
 		int _microSteps;
 		int _homeCaseNum;
+		int _stallCaseNum;
 		int _resolutionNum;
 
 		datagram _outputDatagram;
 
 		bool _isHomed;
 		bool _checkBit(datagram * dg, int targetBit);
+		unsigned long _homeLatchEnableMask();				// SW_MODE latch bit of the home switch
+		unsigned long _homeLatchStatusMask();				// RAMP_STAT latch event of the home switch
+		void _zeroPosition();								// home becomes coordinate 0
+
+		// Calibration sweep state, see calibrateStall
+		uint8_t _stallStep;									// index into the swept speeds
+		int8_t _stallSgt;
+		uint8_t _stallSamples;
+		unsigned int _stallMin;
+		unsigned int _stallMax;
+		unsigned long _stallTime;							// of the last SG_RESULT read
+		unsigned long _stallInterval;						// ms per full step at the speed of the step, between reads
+		bool _stallForward;
+		bool _stallChecked;									// RAMP_STAT looked at since the last move, see stallStopped
+		unsigned long _stallVelocity;						// TCOOLTHRS must not go below it, 0 stall detection off
+		void _setStallThreshold(int8_t sgt, unsigned long velocity);
+		void _setStallStop(bool enable);
+		void _restoreStallGuard();
+		void _releaseStall();
+
+		void _setChopper();									// driver profile and stall detection to the chip
+		unsigned long _tstep(unsigned long velocity);		// TSTEP at VMAX velocity, 0 for 0
+
+		// End of move check, see verifyPosition
+		bool _encoderChecked;								// this move was checked already
+		unsigned long _encoderTarget;						// XTARGET the retries count for
+		unsigned long _encoderTime;							// millis() of the last readEncoder
+
+		bool _rampScaled;									// armMove left a ramp other than the nominal one
+		void _restoreRamp();
+
+		// Shadow of the last value written to each register, see _isRedundantWrite
+		unsigned long _shadow[TMC5130_REGISTER_COUNT];
+		unsigned long _shadowValid[TMC5130_REGISTER_COUNT / 32];
+
+		void _estimateWrite(const datagram * out);			// carries the estimate over a ramp change
+		float _extrapolate(unsigned long now, signed long & x, float & v);	// estimate at now, returns the error bound
+		bool _estimateBounded();							// a position move, only bounded, not followed
+
+		bool _statusFlagsValid;
+		unsigned long _queueReplies;						// DatagramQueue replies already harvested
+		unsigned long _queueReplyMark;						// last queued reply older than a motion write
+		bool _affectsMotion(byte address);
+		void _harvestStatus(byte flags, unsigned long stamp);
+
+		byte _spiStatsSlot[256];							// header -> spiStats index + 1, 0 unused
+		void _countTransfer(byte header, unsigned long cycles);
+
+		bool _isShadowed(datagram * out);					// a write the shadow keeps
+		bool _isRedundantWrite(datagram * out);
+		void _commitShadow(datagram * out);
+		void _invalidateShadow();
+		unsigned long _shadowValue(byte address);
 };
 
 #endif
\ No newline at end of file
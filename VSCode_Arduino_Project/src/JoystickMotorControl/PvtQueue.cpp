@@ -0,0 +1,150 @@
+#include "PvtQueue.h"
+
+PvtQueue :: PvtQueue(CombinedControl & control) : _control(control) {
+	underruns = 0;
+	overruns = 0;
+	latePoints = 0;
+	_head = 0;
+	_count = 0;
+	_lastTime = 0;
+	_epoch = 0;
+	_endTime = 0;
+	_running = false;
+}
+
+/* ======================================================================
+	Adds a point behind the others. Points must come in time order, a
+	full ring counts an overrun and drops the point.
+ ====================================================================== */
+
+bool PvtQueue :: push(const pvtPoint & point) {
+
+	if (_count >= PVT_QUEUE_DEPTH) {
+		overruns++;
+		return false;
+	}
+	if ((_count > 0 || _running) && point.time <= _lastTime) {
+		return false;
+	}
+
+	_points[(_head + _count) % PVT_QUEUE_DEPTH] = point;
+	_count++;
+	_lastTime = point.time;
+	return true;
+}
+
+void PvtQueue :: start(unsigned long now) {
+	_epoch = now;
+	_running = true;
+}
+
+void PvtQueue :: stop() {
+	_running = false;
+	_count = 0;
+	_lastTime = 0;
+}
+
+/* ======================================================================
+	Runs the point that is due, call it as often as possible, the delay
+	until the next call is the timing error. Returns true once per
+	underrun so the caller can report it. With no points left the stream
+	ends once the last segment is over.
+ ====================================================================== */
+
+bool PvtQueue :: service(unsigned long now) {
+
+	if (!_running) {
+		return false;
+	}
+
+	unsigned long elapsed = now - _epoch;
+	if (_count == 0) {
+		if ((long)(elapsed - _endTime) >= 0) {
+			PvtQueue :: stop();
+		}
+		return false;
+	}
+	if (_points[_head].time > elapsed) {
+		return false;
+	}
+
+	while (_count > 1 && _points[(_head + 1) % PVT_QUEUE_DEPTH].time <= elapsed) {
+		_head = (_head + 1) % PVT_QUEUE_DEPTH;
+		_count--;
+		latePoints++;
+	}
+
+	pvtPoint point = _points[_head];
+	_head = (_head + 1) % PVT_QUEUE_DEPTH;
+	_count--;
+	_endTime = elapsed + PVT_UNDERRUN_MS;
+
+	if (PvtQueue :: _run(point, elapsed)) {
+		underruns++;
+		return true;
+	}
+	return false;
+}
+
+/* ======================================================================
+	Starts the segment from point to the next one, which has to arrive by
+	its time even if this point ran late. True if there is no next one
+	and the axes still move.
+ ====================================================================== */
+
+bool PvtQueue :: _run(const pvtPoint & point, unsigned long elapsed) {
+
+	if (_count > 0) {
+		const pvtPoint & next = _points[_head];
+		_control.goPosTimed(0, next.position0, next.time - elapsed, PvtQueue :: _runEnd(0, point.position0));
+		_control.goPosTimed(1, next.position1, next.time - elapsed, PvtQueue :: _runEnd(1, point.position1));
+		return false;
+	}
+	if (point.velocity0 == 0 && point.velocity1 == 0) {
+		_control.goPosTimed(0, point.position0, PVT_UNDERRUN_MS, point.position0);
+		_control.goPosTimed(1, point.position1, PVT_UNDERRUN_MS, point.position1);
+		return false;
+	}
+	signed long coast0 = point.position0 + point.velocity0 * PVT_UNDERRUN_MS / 1000;
+	signed long coast1 = point.position1 + point.velocity1 * PVT_UNDERRUN_MS / 1000;
+	_control.goPosTimed(0, coast0, PVT_UNDERRUN_MS, coast0);
+	_control.goPosTimed(1, coast1, PVT_UNDERRUN_MS, coast1);
+	return true;
+}
+
+/* ======================================================================
+	Last queued position of axis before it turns back or stands still,
+	starting from the one at position. Aiming there, the ramp only brakes
+	where the trajectory really stops.
+ ====================================================================== */
+
+static signed long _axisPosition(const pvtPoint & point, uint8_t axis) {
+	return (axis == 0) ? point.position0 : point.position1;
+}
+
+signed long PvtQueue :: _runEnd(uint8_t axis, signed long position) {
+
+	signed long end = _axisPosition(_points[_head], axis);
+	bool forward = (end > position);
+
+	for (uint8_t i = 1; i < _count; i++) {
+		signed long next = _axisPosition(_points[(_head + i) % PVT_QUEUE_DEPTH], axis);
+		if ((next == end) || ((next > end) != forward)) {
+			break;
+		}
+		end = next;
+	}
+	return end;
+}
+
+bool PvtQueue :: isRunning() {
+	return _running;
+}
+
+uint8_t PvtQueue :: queued() {
+	return _count;
+}
+
+uint8_t PvtQueue :: freeSlots() {
+	return PVT_QUEUE_DEPTH - _count;
+}
@@ -0,0 +1,78 @@
+#ifndef PvtQueue_H
+
+/* ========================================================================
+   $File: PvtQueue.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Ring of timestamped position-velocity points for motors 0 and 1, in
+	front of CombinedControl. Once started, each point is executed at its
+	time: both axes head for the position of the next point at the speed
+	that gets them there on its time. Points already overtaken by a later
+	due one are skipped. The segment speed comes from the positions and
+	times alone, the ramp cannot be made to meet a velocity at both ends
+	of a segment. The velocities only count at the last point, they carry
+	the axes past it: running out of points while they are not 0 is an
+	underrun, the axes then coast on them for PVT_UNDERRUN_MS and stop. A
+	last point with both velocities 0 ends the stream cleanly. Either way
+	the stream stops running PVT_UNDERRUN_MS after its last point unless
+	more points come in by then.
+====================================================================== */
+
+#define PvtQueue_H
+#include "Arduino.h"
+#include "CombinedControl.h"
+
+#define PVT_QUEUE_DEPTH			64		// points, 20 bytes each
+#define PVT_UNDERRUN_MS			100		// coasting past the last point on an underrun
+
+// One trajectory point, the binary layout PVT_UPLOAD sends (little endian)
+struct pvtPoint {
+	public:
+		uint32_t time;							// ms after start()
+		int32_t position0;						// usteps
+		int32_t velocity0;						// usteps/s, only used at the last point
+		int32_t position1;
+		int32_t velocity1;
+};
+
+class PvtQueue {
+
+	public:
+
+		PvtQueue(CombinedControl & control);
+
+		bool push(const pvtPoint & point);					// false if full (overrun) or not later than the last point
+		void start(unsigned long now);						// point times count from now
+		void stop();										// drops all points, the axes finish the last segment
+		bool service(unsigned long now);					// runs due points, true on a new underrun
+
+		bool isRunning();
+		uint8_t queued();
+		uint8_t freeSlots();
+
+		unsigned long underruns;
+		unsigned long overruns;
+		unsigned long latePoints;							// skipped, a later point was already due
+
+	private:
+
+		CombinedControl & _control;
+		pvtPoint _points[PVT_QUEUE_DEPTH];
+		uint8_t _head;										// next point to run
+		uint8_t _count;
+		unsigned long _lastTime;							// time of the newest point pushed
+		unsigned long _epoch;
+		unsigned long _endTime;								// elapsed ms the last segment ends at
+		bool _running;
+
+		bool _run(const pvtPoint & point, unsigned long elapsed);
+		signed long _runEnd(uint8_t axis, signed long position);
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "RampPlanner.h"
+
+RampPlanner :: RampPlanner() {
+	loadPercent = 0;
+}
+
+/* ======================================================================
+	Splits the ramp into the segment below the knee (A1/D1) and the one
+	above it (AMAX/DMAX). V1 = 0 disables the first one, the chip then
+	ramps on AMAX/DMAX alone.
+ ====================================================================== */
+
+static void _lowSegment(const rampProfile & ramp, double * knee, double * aLow, double * dLow) {
+
+	if (ramp.v1 == 0) {
+		*knee = 0.0;
+		*aLow = ramp.amax;
+		*dLow = ramp.dmax;
+	}
+	else {
+		*knee = ramp.v1;
+		*aLow = ramp.a1;
+		*dLow = ramp.d1;
+	}
+}
+
+/* ======================================================================
+	Fastest ramp for a move of distance usteps. Accelerations are the
+	limits scaled down by the load, VMAX is the peak the move actually
+	reaches so velocity_reached still means "at speed". A hop that would
+	never get past V1 runs on AMAX/DMAX only: after a short hop the
+	settling is set by how hard the mount was kicked, not by the few ms
+	the stronger A1/D1 would save.
+ ====================================================================== */
+
+rampProfile RampPlanner :: plan(unsigned long distance) {
+
+	double load = 100.0 / (100.0 + loadPercent);
+
+	rampProfile ramp;
+	ramp.a1 = max(1L, lround(limits.a1 * load));
+	ramp.v1 = limits.v1;
+	ramp.amax = max(1L, lround(limits.amax * load));
+	ramp.vmax = limits.vmax;
+	ramp.dmax = max(1L, lround(limits.dmax * load));
+	ramp.d1 = max(1L, lround(limits.d1 * load));
+	ramp.vstop = limits.vstop;
+
+	if (RampPlanner :: peakVelocity(ramp, distance) <= ramp.v1) {
+		ramp.v1 = 0;
+	}
+
+	unsigned long peak = (unsigned long)ceil(RampPlanner :: peakVelocity(ramp, distance));
+	ramp.vmax = max(max(peak, ramp.vstop), 1UL);
+	return ramp;
+}
+
+/* ======================================================================
+	Scales every velocity and acceleration by ratio. The scaled ramp has
+	the same timing and covers ratio times the distance. Values never drop
+	to 0 since the chip needs D1 and VSTOP above 0 in position mode.
+ ====================================================================== */
+
+rampProfile RampPlanner :: scale(const rampProfile & ramp, double ratio) {
+
+	rampProfile scaled;
+	scaled.a1 = max(1L, lround(ramp.a1 * ratio));
+	scaled.v1 = (ramp.v1 == 0) ? 0 : max(1L, lround(ramp.v1 * ratio));
+	scaled.amax = max(1L, lround(ramp.amax * ratio));
+	scaled.vmax = max(1L, lround(ramp.vmax * ratio));
+	scaled.dmax = max(1L, lround(ramp.dmax * ratio));
+	scaled.d1 = max(1L, lround(ramp.d1 * ratio));
+	scaled.vstop = max(1L, lround(ramp.vstop * ratio));
+	return scaled;
+}
+
+/* ======================================================================
+	Highest velocity the chip reaches on this ramp over distance, VMAX if
+	the move is long enough to cruise. VSTART/VSTOP are left out, they
+	only shift the result by a few units.
+ ====================================================================== */
+
+double RampPlanner :: peakVelocity(const rampProfile & ramp, unsigned long distance) {
+
+	double knee, aLow, dLow;
+	_lowSegment(ramp, &knee, &aLow, &dLow);
+
+	// Distance covered ramping 0 -> v -> 0 is v^2 / 256 * (1/a + 1/d)
+	double span = 256.0 * distance;
+	double peak = sqrt(span / (1.0 / aLow + 1.0 / dLow));
+
+	if (peak > knee) {
+		double lowSpan = knee * knee * (1.0 / aLow - 1.0 / ramp.amax + 1.0 / dLow - 1.0 / ramp.dmax);
+		peak = sqrt((span - lowSpan) / (1.0 / ramp.amax + 1.0 / ramp.dmax));
+	}
+
+	return (peak < ramp.vmax) ? peak : (double)ramp.vmax;
+}
+
+/* ======================================================================
+	Time of a move of distance usteps on this ramp, from rest to rest.
+ ====================================================================== */
+
+double RampPlanner :: slewTime(const rampProfile & ramp, unsigned long distance) {
+
+	if (distance == 0) {
+		return 0.0;
+	}
+
+	double knee, aLow, dLow;
+	_lowSegment(ramp, &knee, &aLow, &dLow);
+
+	double peak = RampPlanner :: peakVelocity(ramp, distance);
+	double low = (peak < knee) ? peak : knee;
+
+	// Ramp phases in v / a units, 2^17 / fCLK seconds each
+	double rampTime = low / aLow + low / dLow;
+	double rampSpan = low * low / 256.0 * (1.0 / aLow + 1.0 / dLow);
+
+	if (peak > knee) {
+		rampTime += (peak - knee) / ramp.amax + (peak - knee) / ramp.dmax;
+		rampSpan += (peak * peak - knee * knee) / 256.0 * (1.0 / ramp.amax + 1.0 / ramp.dmax);
+	}
+
+	double cruiseSpan = (distance > rampSpan) ? distance - rampSpan : 0.0;
+
+	return rampTime * 131072.0 / TMC5130_FCLK + cruiseSpan / (peak * TMC5130_FCLK / 16777216.0);
+}
+
+/* ======================================================================
+	slewTime without a double, the Cortex-M3 would run it in soft double.
+	Only a lead time for the goto target, where a float's 24 bits are
+	plenty: 1 ms of error is 0.015 arcsec of sky.
+ ====================================================================== */
+
+float RampPlanner :: slewTimef(const rampProfile & ramp, unsigned long distance) {
+
+	if (distance == 0) {
+		return 0.0f;
+	}
+
+	float knee = (ramp.v1 == 0) ? 0.0f : (float)ramp.v1;
+	float aLow = (ramp.v1 == 0) ? (float)ramp.amax : (float)ramp.a1;
+	float dLow = (ramp.v1 == 0) ? (float)ramp.dmax : (float)ramp.d1;
+	float aHigh = 1.0f / ramp.amax + 1.0f / ramp.dmax;
+
+	float span = 256.0f * distance;
+	float peak = sqrtf(span / (1.0f / aLow + 1.0f / dLow));
+
+	if (peak > knee) {
+		float lowSpan = knee * knee * (1.0f / aLow + 1.0f / dLow - aHigh);
+		peak = sqrtf((span - lowSpan) / aHigh);
+	}
+
+	if (peak > ramp.vmax) {
+		peak = ramp.vmax;
+	}
+
+	float low = (peak < knee) ? peak : knee;
+	float rampTime = low / aLow + low / dLow;
+	float rampSpan = low * low / 256.0f * (1.0f / aLow + 1.0f / dLow);
+
+	if (peak > knee) {
+		rampTime += (peak - knee) * aHigh;
+		rampSpan += (peak * peak - knee * knee) / 256.0f * aHigh;
+	}
+
+	float cruiseSpan = (distance > rampSpan) ? distance - rampSpan : 0.0f;
+
+	return rampTime * (131072.0f / (float)TMC5130_FCLK) + cruiseSpan / (peak * ((float)TMC5130_FCLK / 16777216.0f));
+}
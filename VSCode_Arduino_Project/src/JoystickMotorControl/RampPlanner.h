@@ -0,0 +1,69 @@
+#ifndef RampPlanner_H
+
+/* ========================================================================
+   $File: RampPlanner.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Plans the TMC5130 six point ramp (VSTART, A1, V1, AMAX, VMAX, DMAX,
+	D1, VSTOP) of a position move from its distance and the limits of the
+	axis. All values are in register units: distances in usteps, v in
+	2^24 / fCLK usteps/s, a in 2^41 / fCLK^2 usteps/s^2. Ramping from 0 to
+	v at a covers v^2 / (256 a) usteps, whatever fCLK is.
+====================================================================== */
+
+#define RampPlanner_H
+#include "Arduino.h"
+#include "System_definitions.h"
+
+// Internal clock of the TMC5130, only needed to turn ramps into seconds
+#define TMC5130_FCLK			12000000.0
+
+// Ramp generator settings of a position move (datasheet chp. 14.2)
+struct rampProfile {
+	public:
+		unsigned long a1 = 0;
+		unsigned long v1 = 0;
+		unsigned long amax = 0;
+		unsigned long vmax = 0;
+		unsigned long dmax = 0;
+		unsigned long d1 = 0;
+		unsigned long vstop = 0;
+};
+
+// What an axis can take. a1/d1 apply below v1, where the motor has the
+// most torque, amax/dmax above it.
+struct rampLimits {
+	public:
+		unsigned long vmax = RAMP_LIMIT_VMAX;
+		unsigned long a1 = RAMP_LIMIT_A1;
+		unsigned long v1 = RAMP_LIMIT_V1;
+		unsigned long amax = RAMP_LIMIT_AMAX;
+		unsigned long dmax = RAMP_LIMIT_DMAX;
+		unsigned long d1 = RAMP_LIMIT_D1;
+		unsigned long vstop = RAMP_LIMIT_VSTOP;
+};
+
+class RampPlanner {
+
+	public:
+
+		RampPlanner();
+
+		rampLimits limits;
+		uint8_t loadPercent;							// inertia added to the axis, scales the accelerations down
+
+		rampProfile plan(unsigned long distance);		// fastest ramp for distance within the limits
+
+		static rampProfile scale(const rampProfile & ramp, double ratio);		// same timing, ratio times the distance
+		static double peakVelocity(const rampProfile & ramp, unsigned long distance);
+		static double slewTime(const rampProfile & ramp, unsigned long distance);	// seconds, from rest to rest
+		static float slewTimef(const rampProfile & ramp, unsigned long distance);	// slewTime in float, for the target side of a goto
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "RasterScan.h"
+
+RasterScan :: RasterScan(CombinedControl & control) : _control(control) {
+	points = 0;
+	missed = 0;
+	_center0 = 0;
+	_center1 = 0;
+	_runup = 0;
+	_caseNum = 0;
+	_row = 0;
+	_point = 0;
+	_lastRow = 0;
+	_lastColumn = 0;
+	_lastFired = false;
+	_armed = false;
+}
+
+/* ======================================================================
+	Starts a scan around where motors 0 and 1 stand now, with the motors
+	at rest. Two points have to be more than twice SCAN_POSITION_ERROR
+	apart, the loop cannot tell them apart otherwise. The run up covers
+	the ramp from rest to velocity (v^2 / (256 a) in register units, see
+	RampPlanner.h) at the lowest acceleration of the goPos ramp.
+ ====================================================================== */
+
+bool RasterScan :: start(const scanGrid & grid) {
+
+	if (grid.columns == 0 || grid.rows == 0 || grid.columns > SCAN_MAX_SIZE || grid.rows > SCAN_MAX_SIZE ||
+		labs(grid.spacing0) <= 2 * SCAN_POSITION_ERROR ||
+		grid.velocity == 0 || grid.velocity > RAMP_LIMIT_VMAX) {
+		return false;
+	}
+
+	RasterScan :: stop();
+
+	_grid = grid;
+	_center0 = _control.estimateXactual(0, 0);
+	_center1 = _control.estimateXactual(1, 0);
+
+	rampProfile ramp = _control.getRamp(0);
+	unsigned long slowest = min(ramp.amax, ramp.dmax);
+	if (ramp.v1 > 0) {
+		slowest = min(slowest, min(ramp.a1, ramp.d1));
+	}
+	_runup = grid.velocity * grid.velocity / (256UL * max(slowest, 1UL)) + SCAN_RUNUP_MARGIN;
+
+	_row = 0;
+	points = 0;
+	missed = 0;
+
+	// Both ends of the first and the last row have to be in range
+	signed long first = RasterScan :: _position0(0);
+	signed long last = RasterScan :: _position0(grid.columns - 1);
+	signed long reach = (first < last) ? _runup : -_runup;
+	if (!_control.inRange(0, first - reach) || !_control.inRange(0, last + reach) ||
+		!_control.inRange(1, RasterScan :: _position1(0)) || !_control.inRange(1, RasterScan :: _position1(grid.rows - 1))) {
+		return false;
+	}
+
+	_control.setCompareOutput(0, SCAN_TRIGGER_PUSHPULL);
+	_control.setCompare(0, SCAN_COMPARE_PARKED);
+
+	if (!RasterScan :: _moveToRow()) {
+		return false;
+	}
+	_caseNum = 1;
+	return true;
+}
+
+void RasterScan :: stop() {
+
+	if (_caseNum != 0) {
+		_control.setCompare(0, SCAN_COMPARE_PARKED);
+	}
+	_caseNum = 0;
+}
+
+/* ======================================================================
+	Advances the scan by one step.
+		case(1): 	waits for both axes to stand at the start of the row,
+					then loads the first point and runs motor 0 to the
+					end of the row at the scan speed.
+		case(2): 	once motor 0 is SCAN_POSITION_ERROR past the point in
+					X_COMPARE, reports it and loads the next one.
+		case(3): 	all points of the row passed, X_COMPARE parked. Once
+					motor 0 stands at the end of the row, which is the
+					start of the next one (the rows alternate), motor 1
+					steps to it. After the last row both go back to the
+					centre.
+		case(4): 	waits for the centre and ends the scan.
+ ====================================================================== */
+
+scanEvent RasterScan :: service() {
+
+	switch (_caseNum) {
+
+		case 1:
+			if (!_control.syncMoveDone()) {
+				return SCAN_NO_EVENT;
+			}
+			_point = 0;
+			RasterScan :: _arm();
+			_control.goPosAt(0, RasterScan :: _position0(RasterScan :: _column(_grid.columns - 1)) + RasterScan :: _direction() * _runup, _grid.velocity);
+			_caseNum = 2;
+			return SCAN_NO_EVENT;
+
+		case 2: {
+			uint8_t column = RasterScan :: _column(_point);
+			signed long past = (_control.estimateXactual(0, SCAN_POSITION_ERROR) - RasterScan :: _position0(column)) * RasterScan :: _direction();
+
+			if (past <= SCAN_POSITION_ERROR) {
+				return SCAN_NO_EVENT;
+			}
+
+			_lastRow = _row;
+			_lastColumn = column;
+			_lastFired = _armed;
+			if (_armed) {
+				points++;
+			}
+			else {
+				missed++;
+			}
+
+			_point++;
+			if (_point < _grid.columns) {
+				RasterScan :: _arm();
+			}
+			else {
+				_control.setCompare(0, SCAN_COMPARE_PARKED);
+				_caseNum = 3;
+			}
+			return SCAN_POINT;
+		}
+
+		case 3:
+			_control.refreshStatusFlags(0);
+			if (!_control.atPosition(0) || !_control.standstill(0)) {
+				return SCAN_NO_EVENT;
+			}
+			_row++;
+			if (_row < _grid.rows) {
+				RasterScan :: _moveToRow();
+				_caseNum = 1;
+			}
+			else {
+				_control.goPosSync(_center0, _center1);
+				_caseNum = 4;
+			}
+			return SCAN_NO_EVENT;
+
+		case 4:
+			if (!_control.syncMoveDone()) {
+				return SCAN_NO_EVENT;
+			}
+			_caseNum = 0;
+			return SCAN_DONE;
+
+		default:
+			return SCAN_NO_EVENT;
+	}
+}
+
+/* ======================================================================
+	Loads the next point into X_COMPARE. It only counts as armed if the
+	axis is surely short of it, a pulse is missed otherwise.
+ ====================================================================== */
+
+void RasterScan :: _arm() {
+
+	signed long position = RasterScan :: _position0(RasterScan :: _column(_point));
+
+	_control.setCompare(0, position);
+	_armed = (position - _control.estimateXactual(0, SCAN_POSITION_ERROR)) * RasterScan :: _direction() > SCAN_POSITION_ERROR;
+}
+
+/* ======================================================================
+	Both axes to the run up before the first point of the row. Along a
+	row motor 0 is already there, but for the first one.
+ ====================================================================== */
+
+bool RasterScan :: _moveToRow() {
+
+	signed long start = RasterScan :: _position0(RasterScan :: _column(0)) - RasterScan :: _direction() * _runup;
+	return _control.goPosSync(start, RasterScan :: _position1(_row));
+}
+
+// Even rows run the columns up, odd rows down
+uint8_t RasterScan :: _column(uint8_t point) {
+	return (_row % 2 == 0) ? point : _grid.columns - 1 - point;
+}
+
+signed long RasterScan :: _position0(uint8_t column) {
+	return _center0 + ((signed long)column - _grid.columns / 2) * _grid.spacing0;
+}
+
+signed long RasterScan :: _position1(uint8_t row) {
+	return _center1 + ((signed long)row - _grid.rows / 2) * _grid.spacing1;
+}
+
+signed long RasterScan :: _direction() {
+	return ((_row % 2 == 0) == (_grid.spacing0 > 0)) ? 1 : -1;
+}
+
+bool RasterScan :: isRunning() {
+	return _caseNum != 0;
+}
+
+uint8_t RasterScan :: row() {
+	return _lastRow;
+}
+
+uint8_t RasterScan :: column() {
+	return _lastColumn;
+}
+
+bool RasterScan :: fired() {
+	return _lastFired;
+}
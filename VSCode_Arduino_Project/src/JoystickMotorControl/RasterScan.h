@@ -0,0 +1,85 @@
+#ifndef RasterScan_H
+
+/* ========================================================================
+   $File: RasterScan.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Serpentine scan of a grid around where motors 0 and 1 point, without
+	stopping at the cells. Motor 1 steps from row to row, motor 0 runs
+	each row at one speed, run up before the first point and on past the
+	last. X_COMPARE of motor 0 holds the next point of the row, so the
+	driver pulses DIAG1 (the camera or IMU capture trigger) at the exact
+	position and the main loop only has to move it on once the axis is
+	past. A point the axis reached before X_COMPARE got there is passed
+	without a pulse and counted missed: the spacing or the speed leave
+	the loop too little time. Ends back at the centre.
+====================================================================== */
+
+#define RasterScan_H
+#include "Arduino.h"
+#include "CombinedControl.h"
+
+// Grid of a scan, the points are spacing apart and centred on the start
+struct scanGrid {
+	public:
+		uint8_t columns = 0;						// points along a row, motor 0
+		uint8_t rows = 0;							// motor 1
+		signed long spacing0 = 0;					// usteps between columns, the sign picks the order
+		signed long spacing1 = 0;					// usteps between rows
+		unsigned long velocity = 0;					// VMAX along a row
+};
+
+enum scanEvent {
+	SCAN_NO_EVENT,
+	SCAN_POINT,										// a point was passed, see row()/column()/fired()
+	SCAN_DONE										// back at the centre
+};
+
+class RasterScan {
+
+	public:
+
+		RasterScan(CombinedControl & control);
+
+		bool start(const scanGrid & grid);					// false if the grid is invalid or leaves the range
+		void stop();										// X_COMPARE parked, the axes finish their move
+		scanEvent service();								// one step, call it as often as possible
+
+		bool isRunning();
+		uint8_t row();										// of the point passed last
+		uint8_t column();
+		bool fired();										// X_COMPARE was on it in time
+
+		unsigned long points;								// passed since start, with a pulse
+		unsigned long missed;								// passed without one
+
+	private:
+
+		CombinedControl & _control;
+		scanGrid _grid;
+		signed long _center0;
+		signed long _center1;
+		signed long _runup;									// usteps motor 0 needs to reach the scan speed
+		uint8_t _caseNum;
+		uint8_t _row;
+		uint8_t _point;										// next point of the row, in the order it is run
+		uint8_t _lastRow;
+		uint8_t _lastColumn;
+		bool _lastFired;
+		bool _armed;										// X_COMPARE was ahead of the axis when loaded
+
+		uint8_t _column(uint8_t point);
+		signed long _position0(uint8_t column);
+		signed long _position1(uint8_t row);
+		signed long _direction();							// +1 or -1, motor 0 along this row
+		void _arm();
+		bool _moveToRow();
+};
+
+#endif
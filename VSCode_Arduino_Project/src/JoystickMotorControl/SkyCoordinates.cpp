@@ -0,0 +1,109 @@
+#include "SkyCoordinates.h"
+
+// Float versions of DEG_TO_RAD/RAD_TO_DEG, the core ones are double
+static const float DEG_RAD = 0.017453292f;
+static const float RAD_DEG = 57.29578f;
+
+// Yearly precession terms m = 3.075 s and n = 1.336 s (20.04"), in degrees
+static const float PRECESSION_M = 0.0128125f;
+static const float PRECESSION_N = 0.0055667f;
+
+static float _wrap360(float angle) {
+	angle = fmodf(angle, 360.0f);
+	return (angle < 0.0f) ? angle + 360.0f : angle;
+}
+
+SkyCoordinates :: SkyCoordinates() {
+	_latitude = 0.0f;
+	_longitude = 0.0f;
+	_epochSeconds = 0;
+	_epochMillis = 0;
+	_siteSet = false;
+	_timeSet = false;
+}
+
+void SkyCoordinates :: setSite(float latitude, float longitude) {
+	_latitude = latitude;
+	_longitude = longitude;
+	_siteSet = true;
+}
+
+void SkyCoordinates :: setTime(unsigned long unixTime, unsigned long now) {
+	_epochSeconds = (signed long)(unixTime - J2000_UNIX);
+	_epochMillis = now;
+	_timeSet = true;
+}
+
+bool SkyCoordinates :: isReady() {
+	return _siteSet && _timeSet;
+}
+
+/* ======================================================================
+	Time since J2000 at millis() now, as whole days and seconds of the
+	day (0..86400, with the ms).
+ ====================================================================== */
+
+void SkyCoordinates :: _sinceJ2000(unsigned long now, signed long & days, float & seconds) {
+
+	unsigned long elapsed = now - _epochMillis;
+	signed long total = _epochSeconds + (signed long)(elapsed / 1000);
+
+	days = total / 86400;
+	signed long rest = total % 86400;
+	if (rest < 0) {
+		rest += 86400;
+		days--;
+	}
+	seconds = rest + (elapsed % 1000) / 1000.0f;
+}
+
+/* ======================================================================
+	Local mean sidereal time, degrees. GMST grows by 360.98564736629 deg
+	per day, the whole turns are dropped before going to float: days
+	times 0.98564736629 is days - 0.01435263371 days, and days mod 360
+	is exact in integers.
+ ====================================================================== */
+
+float SkyCoordinates :: siderealTime(unsigned long now) {
+
+	signed long days;
+	float seconds;
+	SkyCoordinates :: _sinceJ2000(now, days, seconds);
+
+	float gmst = 280.46061837f + (float)(days % 360) - 0.01435263371f * days + 360.98564736629f * (seconds / 86400.0f);
+	return _wrap360(gmst + _longitude);
+}
+
+/* ======================================================================
+	Where a J2000 star is seen at millis() now. Precession is the first
+	order one (good to a few arcsec for decades from J2000), refraction
+	Saemundsson's formula for 10 C and 1010 hPa.
+ ====================================================================== */
+
+void SkyCoordinates :: toHorizontal(float rightAscension, float declination, unsigned long now, float & altitude, float & azimuth) {
+
+	signed long days;
+	float seconds;
+	SkyCoordinates :: _sinceJ2000(now, days, seconds);
+	float years = (days + seconds / 86400.0f) / 365.25f;
+
+	float ra = rightAscension * 15.0f * DEG_RAD;
+	float dec = declination * DEG_RAD;
+	float shiftRa = (PRECESSION_M + PRECESSION_N * sinf(ra) * tanf(dec)) * years * DEG_RAD;
+	dec += PRECESSION_N * cosf(ra) * years * DEG_RAD;
+	ra += shiftRa;
+
+	float hourAngle = SkyCoordinates :: siderealTime(now) * DEG_RAD - ra;
+	float lat = _latitude * DEG_RAD;
+	float sinLat = sinf(lat);
+	float cosLat = cosf(lat);
+	float sinDec = sinf(dec);
+	float cosDec = cosf(dec);
+
+	altitude = asinf(sinLat * sinDec + cosLat * cosDec * cosf(hourAngle)) * RAD_DEG;
+	azimuth = _wrap360(atan2f(-cosDec * sinf(hourAngle), cosLat * sinDec - sinLat * cosDec * cosf(hourAngle)) * RAD_DEG);
+
+	if (altitude > -1.0f) {
+		altitude += 1.02f / tanf((altitude + 10.3f / (altitude + 5.11f)) * DEG_RAD) / 60.0f;
+	}
+}
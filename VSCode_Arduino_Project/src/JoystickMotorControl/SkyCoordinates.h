@@ -0,0 +1,54 @@
+#ifndef SkyCoordinates_H
+
+/* ========================================================================
+   $File: SkyCoordinates.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Turns catalog (J2000) right ascension and declination into the
+	altitude and azimuth seen from the site at a given time, so a goto
+	needs no host. Float only, the Cortex-M3 has no FPU and soft double
+	costs about twice as much. Time is split in whole days and seconds of
+	the day since J2000 so a float never has to hold it whole, which
+	keeps sidereal time within a few arcsec. Corrects for precession and
+	refraction, ignores nutation and aberration (< 30 arcsec).
+	Angles are in degrees, azimuth from north through east in 0..360.
+====================================================================== */
+
+#define SkyCoordinates_H
+#include "Arduino.h"
+
+// Unix time of J2000.0, 2000-01-01 12:00 UTC
+#define J2000_UNIX				946728000L
+
+class SkyCoordinates {
+
+	public:
+
+		SkyCoordinates();
+
+		void setSite(float latitude, float longitude);						// degrees, north and east positive
+		void setTime(unsigned long unixTime, unsigned long now);			// UTC seconds at millis() now
+		bool isReady();														// site and time are both set
+
+		float siderealTime(unsigned long now);								// local mean sidereal time at millis() now
+		void toHorizontal(float rightAscension, float declination, unsigned long now, float & altitude, float & azimuth);	// ra in hours
+
+	private:
+
+		float _latitude;
+		float _longitude;
+		signed long _epochSeconds;							// seconds since J2000 at _epochMillis
+		unsigned long _epochMillis;
+		bool _siteSet;
+		bool _timeSet;
+
+		void _sinceJ2000(unsigned long now, signed long & days, float & seconds);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "SkyTracker.h"
+
+SkyTracker :: SkyTracker() {
+	_latitude = 0.0;
+	_hourAngle = 0.0;
+	_declination = 0.0;
+	_epoch = 0;
+}
+
+void SkyTracker :: setLatitude(double latitude) {
+	_latitude = latitude * DEG_TO_RAD;
+}
+
+double SkyTracker :: getLatitude() {
+	return _latitude * RAD_TO_DEG;
+}
+
+/* ======================================================================
+	Takes the target from where it is seen now. Altitude and azimuth give
+	its hour angle and declination, only the hour angle changes after.
+	Call setLatitude first, the conversion depends on it.
+ ====================================================================== */
+
+void SkyTracker :: setTarget(double altitude, double azimuth, unsigned long now) {
+
+	double alt = altitude * DEG_TO_RAD;
+	double az = azimuth * DEG_TO_RAD;
+	double sinLat = sin(_latitude);
+	double cosLat = cos(_latitude);
+
+	_declination = asin(sinLat * sin(alt) + cosLat * cos(alt) * cos(az));
+	_hourAngle = atan2(-sin(az) * cos(alt), cosLat * sin(alt) - sinLat * cos(alt) * cos(az));
+	_epoch = now;
+}
+
+/* ======================================================================
+	Altitude and azimuth of the target at millis() now. Azimuth is in
+	-180..180, the caller picks the turn that suits the mount.
+ ====================================================================== */
+
+void SkyTracker :: position(unsigned long now, double & altitude, double & azimuth) {
+
+	double hourAngle = _hourAngle + SIDEREAL_RATE * ((now - _epoch) / 1000.0);
+	double sinLat = sin(_latitude);
+	double cosLat = cos(_latitude);
+	double sinDec = sin(_declination);
+	double cosDec = cos(_declination);
+
+	altitude = asin(sinLat * sinDec + cosLat * cosDec * cos(hourAngle)) * RAD_TO_DEG;
+	azimuth = atan2(-cosDec * sin(hourAngle), cosLat * sinDec - sinLat * cosDec * cos(hourAngle)) * RAD_TO_DEG;
+}
+
+/* ======================================================================
+	Angular speed of a fixed star seen at altitude/azimuth:
+		dAlt/dt = w cos(lat) sin(az)
+		dAz/dt  = w (sin(lat) - cos(lat) cos(az) tan(alt))
+	The azimuth rate grows without bound towards the zenith, the motor
+	clamps it to what the axis can do.
+ ====================================================================== */
+
+void SkyTracker :: rates(double altitude, double azimuth, double & altitudeRate, double & azimuthRate) {
+
+	double alt = altitude * DEG_TO_RAD;
+	double az = azimuth * DEG_TO_RAD;
+	double w = SIDEREAL_RATE * RAD_TO_DEG;
+
+	altitudeRate = w * cos(_latitude) * sin(az);
+	azimuthRate = w * (sin(_latitude) - cos(_latitude) * cos(az) * tan(alt));
+}
@@ -0,0 +1,48 @@
+#ifndef SkyTracker_H
+
+/* ========================================================================
+   $File: SkyTracker.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Follows a fixed star across the sky of an alt/az mount. The target is
+	kept as hour angle and declination, the hour angle grows at the
+	sidereal rate, and position() turns it back into altitude and azimuth
+	at any time. rates() gives the angular speed of both axes there, what
+	the motors have to run at in velocity mode. Angles are in degrees,
+	azimuth from north through east, rates in degrees per second.
+====================================================================== */
+
+#define SkyTracker_H
+#include "Arduino.h"
+
+// Earth rotation against the stars, rad/s (one turn per 86164.0905 s)
+#define SIDEREAL_RATE			7.2921158553e-5
+
+class SkyTracker {
+
+	public:
+
+		SkyTracker();
+
+		void setLatitude(double latitude);									// observer latitude, degrees north
+		double getLatitude();
+		void setTarget(double altitude, double azimuth, unsigned long now);		// target seen at alt/az at millis() now
+
+		void position(unsigned long now, double & altitude, double & azimuth);		// where the target is at millis() now
+		void rates(double altitude, double azimuth, double & altitudeRate, double & azimuthRate);
+
+	private:
+
+		double _latitude;									// radians
+		double _hourAngle;									// radians, at _epoch
+		double _declination;								// radians
+		unsigned long _epoch;								// millis() of the hour angle
+};
+
+#endif
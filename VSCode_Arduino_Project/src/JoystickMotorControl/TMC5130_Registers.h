@@ -0,0 +1,404 @@
+#ifndef TMC5130_Registers_H
+
+/* ========================================================================
+   $File: TMC5130_Registers.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+#define TMC5130_Registers_H
+#include <stdint.h>
+
+/* ======================================================================
+	Compile time description of the TMC5130 register map (datasheet
+	chp. 6). Every register carries its address and access mode, every
+	field its offset and width, so encoding and decoding a field folds to
+	a single shift and mask. Constant values are range checked by the
+	compiler with Field::of<value>(); runtime values are masked to the
+	field width by encode().
+
+		IHOLD_IRUN.data = TMC5130::IHOLD_IRUN::IRUN::encode(runPower);
+		bool stst = TMC5130::DRV_STATUS::stst::get(value);
+====================================================================== */
+
+namespace TMC5130 {
+
+// Access modes as listed in the datasheet register tables
+enum : uint8_t {
+	ACCESS_R    = 0x01,			// read only
+	ACCESS_W    = 0x02,			// write only, reads back as 0
+	ACCESS_RW   = 0x03,
+	ACCESS_RC   = 0x05,			// read, flags clear on read
+	ACCESS_RWC  = 0x07			// read, write 1 to clear flags
+};
+
+template <uint8_t ADDRESS, uint8_t ACCESS>
+struct Register {
+	static_assert(ADDRESS < 0x80, "TMC5130 register addresses are 7 bit");
+
+	static constexpr uint8_t address = ADDRESS;
+	static constexpr uint8_t access = ACCESS;
+	static constexpr bool readable = (ACCESS & ACCESS_R) != 0;
+	static constexpr bool writable = (ACCESS & ACCESS_W) != 0;
+	static constexpr bool clearsOnRead = ACCESS == ACCESS_RC;
+};
+
+template <uint8_t ADDRESS, uint8_t ACCESS> constexpr uint8_t Register<ADDRESS, ACCESS>::address;
+template <uint8_t ADDRESS, uint8_t ACCESS> constexpr uint8_t Register<ADDRESS, ACCESS>::access;
+template <uint8_t ADDRESS, uint8_t ACCESS> constexpr bool Register<ADDRESS, ACCESS>::readable;
+template <uint8_t ADDRESS, uint8_t ACCESS> constexpr bool Register<ADDRESS, ACCESS>::writable;
+template <uint8_t ADDRESS, uint8_t ACCESS> constexpr bool Register<ADDRESS, ACCESS>::clearsOnRead;
+
+template <class REG, uint8_t OFFSET, uint8_t WIDTH>
+struct Field {
+	static_assert(WIDTH > 0 && OFFSET + WIDTH <= 32, "TMC5130 field does not fit its 32 bit register");
+
+	typedef REG reg;
+	static constexpr uint8_t offset = OFFSET;
+	static constexpr uint8_t width = WIDTH;
+	static constexpr uint32_t max = 0xFFFFFFFFUL >> (32 - WIDTH);
+	static constexpr uint32_t mask = max << OFFSET;
+
+	// Field value out of a register value
+	static constexpr uint32_t get(uint32_t regValue) {
+		return (regValue >> OFFSET) & max;
+	}
+
+	// Two's complement fields (VACTUAL, SGT), sign extended to 32 bit
+	static constexpr int32_t getSigned(uint32_t regValue) {
+		return (int32_t)(get(regValue) << (32 - WIDTH)) >> (32 - WIDTH);
+	}
+
+	// Runtime value placed in the field, cut to the field width
+	static constexpr uint32_t encode(uint32_t value) {
+		return (value & max) << OFFSET;
+	}
+
+	// Register value with only this field replaced
+	static constexpr uint32_t set(uint32_t regValue, uint32_t value) {
+		return (regValue & ~mask) | encode(value);
+	}
+
+	// Constant value placed in the field, too wide a value fails to compile
+	template <uint32_t VALUE>
+	static constexpr uint32_t of() {
+		static_assert(VALUE <= max, "value does not fit the TMC5130 field");
+		return VALUE << OFFSET;
+	}
+};
+
+template <class REG, uint8_t OFFSET, uint8_t WIDTH> constexpr uint8_t Field<REG, OFFSET, WIDTH>::offset;
+template <class REG, uint8_t OFFSET, uint8_t WIDTH> constexpr uint8_t Field<REG, OFFSET, WIDTH>::width;
+template <class REG, uint8_t OFFSET, uint8_t WIDTH> constexpr uint32_t Field<REG, OFFSET, WIDTH>::max;
+template <class REG, uint8_t OFFSET, uint8_t WIDTH> constexpr uint32_t Field<REG, OFFSET, WIDTH>::mask;
+
+//======================= GENERAL CONFIGURATION =====================
+
+struct GCONF : Register<0x00, ACCESS_RW> {
+	typedef Field<GCONF, 0, 1> I_scale_analog;
+	typedef Field<GCONF, 1, 1> internal_Rsense;
+	typedef Field<GCONF, 2, 1> en_pwm_mode;
+	typedef Field<GCONF, 3, 1> enc_commutation;
+	typedef Field<GCONF, 4, 1> shaft;
+	typedef Field<GCONF, 5, 1> diag0_error;
+	typedef Field<GCONF, 6, 1> diag0_otpw;
+	typedef Field<GCONF, 7, 1> diag0_stall;
+	typedef Field<GCONF, 8, 1> diag1_stall;
+	typedef Field<GCONF, 9, 1> diag1_index;
+	typedef Field<GCONF, 10, 1> diag1_onstate;
+	typedef Field<GCONF, 11, 1> diag1_steps_skipped;
+	typedef Field<GCONF, 12, 1> diag0_int_pushpull;
+	typedef Field<GCONF, 13, 1> diag1_pushpull;
+	typedef Field<GCONF, 14, 1> small_hysteresis;
+	typedef Field<GCONF, 15, 1> stop_enable;
+	typedef Field<GCONF, 16, 1> direct_mode;
+};
+
+struct GSTAT : Register<0x01, ACCESS_RC> {
+	typedef Field<GSTAT, 0, 1> reset;
+	typedef Field<GSTAT, 1, 1> drv_err;
+	typedef Field<GSTAT, 2, 1> uv_cp;
+};
+
+struct IFCNT : Register<0x02, ACCESS_R> {
+	typedef Field<IFCNT, 0, 8> value;
+};
+
+struct SLAVECONF : Register<0x03, ACCESS_W> {
+	typedef Field<SLAVECONF, 0, 8> SLAVEADDR;
+	typedef Field<SLAVECONF, 8, 4> SENDDELAY;
+};
+
+struct IOIN : Register<0x04, ACCESS_R> {
+	typedef Field<IOIN, 0, 1> REFL_STEP;
+	typedef Field<IOIN, 1, 1> REFR_DIR;
+	typedef Field<IOIN, 4, 1> DRV_ENN_CFG6;
+	typedef Field<IOIN, 24, 8> VERSION;
+};
+
+struct X_COMPARE : Register<0x05, ACCESS_W> {
+	typedef Field<X_COMPARE, 0, 32> value;
+};
+
+//========================= VELOCITY DEPENDENT ======================
+
+struct IHOLD_IRUN : Register<0x10, ACCESS_W> {
+	typedef Field<IHOLD_IRUN, 0, 5> IHOLD;
+	typedef Field<IHOLD_IRUN, 8, 5> IRUN;
+	typedef Field<IHOLD_IRUN, 16, 4> IHOLDDELAY;
+};
+
+struct TPOWERDOWN : Register<0x11, ACCESS_W> {
+	typedef Field<TPOWERDOWN, 0, 8> value;
+};
+
+struct TSTEP : Register<0x12, ACCESS_R> {
+	typedef Field<TSTEP, 0, 20> value;
+};
+
+struct TPWMTHRS : Register<0x13, ACCESS_W> {
+	typedef Field<TPWMTHRS, 0, 20> value;
+};
+
+struct TCOOLTHRS : Register<0x14, ACCESS_W> {
+	typedef Field<TCOOLTHRS, 0, 20> value;
+};
+
+struct THIGH : Register<0x15, ACCESS_W> {
+	typedef Field<THIGH, 0, 20> value;
+};
+
+//========================== RAMP GENERATOR =========================
+
+struct RAMPMODE : Register<0x20, ACCESS_RW> {
+	typedef Field<RAMPMODE, 0, 2> value;
+};
+
+struct XACTUAL : Register<0x21, ACCESS_RW> {
+	typedef Field<XACTUAL, 0, 32> value;
+};
+
+struct VACTUAL : Register<0x22, ACCESS_R> {
+	typedef Field<VACTUAL, 0, 24> value;				// signed
+};
+
+struct VSTART : Register<0x23, ACCESS_W> {
+	typedef Field<VSTART, 0, 18> value;
+};
+
+struct A1 : Register<0x24, ACCESS_W> {
+	typedef Field<A1, 0, 16> value;
+};
+
+struct V1 : Register<0x25, ACCESS_W> {
+	typedef Field<V1, 0, 20> value;
+};
+
+struct AMAX : Register<0x26, ACCESS_W> {
+	typedef Field<AMAX, 0, 16> value;
+};
+
+struct VMAX : Register<0x27, ACCESS_W> {
+	typedef Field<VMAX, 0, 23> value;
+};
+
+struct DMAX : Register<0x28, ACCESS_W> {
+	typedef Field<DMAX, 0, 16> value;
+};
+
+struct D1 : Register<0x2A, ACCESS_W> {
+	typedef Field<D1, 0, 16> value;
+};
+
+struct VSTOP : Register<0x2B, ACCESS_W> {
+	typedef Field<VSTOP, 0, 18> value;
+};
+
+struct TZEROWAIT : Register<0x2C, ACCESS_W> {
+	typedef Field<TZEROWAIT, 0, 16> value;
+};
+
+struct XTARGET : Register<0x2D, ACCESS_RW> {
+	typedef Field<XTARGET, 0, 32> value;
+};
+
+//===================== SWITCH MODE AND RAMP STATUS =================
+
+struct VDCMIN : Register<0x33, ACCESS_W> {
+	typedef Field<VDCMIN, 0, 23> value;
+};
+
+struct SW_MODE : Register<0x34, ACCESS_RW> {
+	typedef Field<SW_MODE, 0, 1> stop_l_enable;
+	typedef Field<SW_MODE, 1, 1> stop_r_enable;
+	typedef Field<SW_MODE, 2, 1> pol_stop_l;
+	typedef Field<SW_MODE, 3, 1> pol_stop_r;
+	typedef Field<SW_MODE, 4, 1> swap_lr;
+	typedef Field<SW_MODE, 5, 1> latch_l_active;
+	typedef Field<SW_MODE, 6, 1> latch_l_inactive;
+	typedef Field<SW_MODE, 7, 1> latch_r_active;
+	typedef Field<SW_MODE, 8, 1> latch_r_inactive;
+	typedef Field<SW_MODE, 9, 1> en_latch_encoder;
+	typedef Field<SW_MODE, 10, 1> sg_stop;
+	typedef Field<SW_MODE, 11, 1> en_softstop;
+};
+
+struct RAMP_STAT : Register<0x35, ACCESS_RWC> {
+	typedef Field<RAMP_STAT, 0, 1> status_stop_l;
+	typedef Field<RAMP_STAT, 1, 1> status_stop_r;
+	typedef Field<RAMP_STAT, 2, 1> status_latch_l;
+	typedef Field<RAMP_STAT, 3, 1> status_latch_r;
+	typedef Field<RAMP_STAT, 4, 1> event_stop_l;
+	typedef Field<RAMP_STAT, 5, 1> event_stop_r;
+	typedef Field<RAMP_STAT, 6, 1> event_stop_sg;
+	typedef Field<RAMP_STAT, 7, 1> event_pos_reached;
+	typedef Field<RAMP_STAT, 8, 1> velocity_reached;
+	typedef Field<RAMP_STAT, 9, 1> position_reached;
+	typedef Field<RAMP_STAT, 10, 1> vzero;
+	typedef Field<RAMP_STAT, 11, 1> t_zerowait_active;
+	typedef Field<RAMP_STAT, 12, 1> second_move;
+	typedef Field<RAMP_STAT, 13, 1> status_sg;
+};
+
+struct XLATCH : Register<0x36, ACCESS_R> {
+	typedef Field<XLATCH, 0, 32> value;
+};
+
+//============================== ENCODER ============================
+
+struct ENCMODE : Register<0x38, ACCESS_RW> {
+	typedef Field<ENCMODE, 0, 1> pol_A;
+	typedef Field<ENCMODE, 1, 1> pol_B;
+	typedef Field<ENCMODE, 2, 1> pol_N;
+	typedef Field<ENCMODE, 3, 1> ignore_AB;
+	typedef Field<ENCMODE, 4, 1> clr_cont;
+	typedef Field<ENCMODE, 5, 1> clr_once;
+	typedef Field<ENCMODE, 6, 2> sensitivity;
+	typedef Field<ENCMODE, 8, 1> clr_enc_x;
+	typedef Field<ENCMODE, 9, 1> latch_x_act;
+	typedef Field<ENCMODE, 10, 1> enc_sel_decimal;
+};
+
+struct X_ENC : Register<0x39, ACCESS_RW> {
+	typedef Field<X_ENC, 0, 32> value;
+};
+
+struct ENC_CONST : Register<0x3A, ACCESS_W> {
+	typedef Field<ENC_CONST, 0, 16> fraction;
+	typedef Field<ENC_CONST, 16, 16> integer;
+};
+
+struct ENC_STATUS : Register<0x3B, ACCESS_RWC> {
+	typedef Field<ENC_STATUS, 0, 1> n_event;
+};
+
+struct ENC_LATCH : Register<0x3C, ACCESS_R> {
+	typedef Field<ENC_LATCH, 0, 32> value;
+};
+
+//========================= MOTOR DRIVER ============================
+
+struct MSLUT0 : Register<0x60, ACCESS_W> {};
+struct MSLUT1 : Register<0x61, ACCESS_W> {};
+struct MSLUT2 : Register<0x62, ACCESS_W> {};
+struct MSLUT3 : Register<0x63, ACCESS_W> {};
+struct MSLUT4 : Register<0x64, ACCESS_W> {};
+struct MSLUT5 : Register<0x65, ACCESS_W> {};
+struct MSLUT6 : Register<0x66, ACCESS_W> {};
+struct MSLUT7 : Register<0x67, ACCESS_W> {};
+struct MSLUTSEL : Register<0x68, ACCESS_W> {};
+struct MSLUTSTART : Register<0x69, ACCESS_W> {};
+
+struct MSCNT : Register<0x6A, ACCESS_R> {
+	typedef Field<MSCNT, 0, 10> value;
+};
+
+struct MSCURACT : Register<0x6B, ACCESS_R> {
+	typedef Field<MSCURACT, 0, 9> CUR_A;				// signed
+	typedef Field<MSCURACT, 16, 9> CUR_B;				// signed
+};
+
+struct CHOPCONF : Register<0x6C, ACCESS_RW> {
+	typedef Field<CHOPCONF, 0, 4> TOFF;
+	typedef Field<CHOPCONF, 4, 3> HSTRT;
+	typedef Field<CHOPCONF, 7, 4> HEND;
+	typedef Field<CHOPCONF, 11, 1> fd3;
+	typedef Field<CHOPCONF, 12, 1> disfdcc;
+	typedef Field<CHOPCONF, 13, 1> rndtf;
+	typedef Field<CHOPCONF, 14, 1> chm;
+	typedef Field<CHOPCONF, 15, 2> TBL;
+	typedef Field<CHOPCONF, 17, 1> vsense;
+	typedef Field<CHOPCONF, 18, 1> vhighfs;
+	typedef Field<CHOPCONF, 19, 1> vhighchm;
+	typedef Field<CHOPCONF, 20, 4> sync;
+	typedef Field<CHOPCONF, 24, 4> MRES;
+	typedef Field<CHOPCONF, 28, 1> intpol;
+	typedef Field<CHOPCONF, 29, 1> dedge;
+	typedef Field<CHOPCONF, 30, 1> diss2g;
+};
+
+struct COOLCONF : Register<0x6D, ACCESS_W> {
+	typedef Field<COOLCONF, 0, 4> semin;
+	typedef Field<COOLCONF, 5, 2> seup;
+	typedef Field<COOLCONF, 8, 4> semax;
+	typedef Field<COOLCONF, 13, 2> sedn;
+	typedef Field<COOLCONF, 15, 1> seimin;
+	typedef Field<COOLCONF, 16, 7> sgt;					// signed
+	typedef Field<COOLCONF, 24, 1> sfilt;
+};
+
+struct DCCTRL : Register<0x6E, ACCESS_W> {
+	typedef Field<DCCTRL, 0, 10> DC_TIME;
+	typedef Field<DCCTRL, 16, 8> DC_SG;
+};
+
+struct DRV_STATUS : Register<0x6F, ACCESS_R> {
+	typedef Field<DRV_STATUS, 0, 10> SG_RESULT;
+	typedef Field<DRV_STATUS, 15, 1> fsactive;
+	typedef Field<DRV_STATUS, 16, 5> CS_ACTUAL;
+	typedef Field<DRV_STATUS, 24, 1> stallGuard;
+	typedef Field<DRV_STATUS, 25, 1> ot;
+	typedef Field<DRV_STATUS, 26, 1> otpw;
+	typedef Field<DRV_STATUS, 27, 1> s2ga;
+	typedef Field<DRV_STATUS, 28, 1> s2gb;
+	typedef Field<DRV_STATUS, 29, 1> ola;
+	typedef Field<DRV_STATUS, 30, 1> olb;
+	typedef Field<DRV_STATUS, 31, 1> stst;
+};
+
+struct PWMCONF : Register<0x70, ACCESS_W> {
+	typedef Field<PWMCONF, 0, 8> PWM_AMPL;
+	typedef Field<PWMCONF, 8, 8> PWM_GRAD;
+	typedef Field<PWMCONF, 16, 2> pwm_freq;
+	typedef Field<PWMCONF, 18, 1> pwm_autoscale;
+	typedef Field<PWMCONF, 19, 1> pwm_symmetric;
+	typedef Field<PWMCONF, 20, 2> freewheel;
+};
+
+struct PWM_SCALE : Register<0x71, ACCESS_R> {
+	typedef Field<PWM_SCALE, 0, 8> value;
+};
+
+struct ENCM_CTRL : Register<0x72, ACCESS_W> {
+	typedef Field<ENCM_CTRL, 0, 1> inv;
+	typedef Field<ENCM_CTRL, 1, 1> maxspeed;
+};
+
+struct LOST_STEPS : Register<0x73, ACCESS_R> {
+	typedef Field<LOST_STEPS, 0, 20> value;
+};
+
+// Encodings the driver relies on, checked on every build
+static_assert(IHOLD_IRUN::IRUN::mask == 0x00001F00UL, "IRUN is bits 8-12");
+static_assert(CHOPCONF::MRES::encode(8) == 0x08000000UL, "MRES is bits 24-27");
+static_assert(VACTUAL::value::getSigned(0x00FFFFFFUL) == -1, "VACTUAL is 24 bit two's complement");
+static_assert(COOLCONF::sgt::getSigned(COOLCONF::sgt::encode((uint32_t)-64)) == -64, "SGT is 7 bit two's complement");
+static_assert(RAMPMODE::value::encode(7) == 3, "encode() masks to the field width");
+static_assert(!AMAX::readable && XTARGET::readable && GSTAT::clearsOnRead, "access modes");
+
+}
+
+#endif
@@ -17,16 +17,25 @@
 #include "System_Control_App.h"
 #include "HWT906_App.h"
 #include "LED_App.h"
-#include <AsyncTask.h>
+#include "LoopProfiler.h"
+#include <TaskScheduler.h>
+#include <EventDispatcher.h>
 
 /***************************************************************************************************
  * CONSTANTS AND DEFINITIONS
  **************************************************************************************************/
+#define EVENT_USB_RX        (1UL << 0)  /* command bytes on Serial */
+#define EVENT_BLE_RX        (1UL << 1)  /* frame bytes from the BLE link */
+#define EVENT_TIMER         (1UL << 2)  /* a scheduled task or coroutine is due */
+#define EVENT_MOTOR         (1UL << 3)  /* DIAG0 of a driver, or the motor services have work left */
+#define EVENT_IMU_FRAME     (1UL << 4)  /* the HWT906 delivered a good frame */
 
 /***************************************************************************************************
  * MODULE VARIABLES
  **************************************************************************************************/
-AsyncTask asyncTask;                 /* Handles asynchronous tasks */
+TaskScheduler scheduler;             /* Runs the periodic services, no heap */
+EventDispatcher events;              /* Runs the services whose events fired, sleeps otherwise */
+taskHandle imuCheck = TASK_NONE;     /* IMU watchdog, pushed back by every frame */
 HWT906_App HWT906App;                /* IMU application object */
 BLE_Bridge_App BLE_App;            /* Bluetooth application object */
 System_Control_App SystemControlApp; /* System control application object */
@@ -40,6 +49,17 @@ void Mtr3PowerDisableCheck(void);   /* Checks if motor 3 should be powered down
 void ServiceIMUapp(void);           /* Handles periodic IMU data servicing */
 void ServiceLEDapp(void);           /* Handles periodic LED service */
 void ServiceJSswitch(void);
+void ServiceTracking(void);         /* Recomputes the sidereal tracking rates */
+void ServiceCommands(void);         /* EVENT_USB_RX */
+void ServiceBLE(void);              /* EVENT_BLE_RX */
+void ServiceScheduler(void);        /* EVENT_TIMER */
+void ServiceMotors(void);           /* EVENT_MOTOR and whatever may start a move */
+void ServiceIMUframe(void);         /* EVENT_IMU_FRAME */
+bool UsbRxWaiting(void);
+bool BleRxWaiting(void);
+bool TaskDue(void);
+void PostIMUframe(void);            /* USART0 interrupt */
+void PostMotorEvent(void);          /* DIAG0 pin interrupt */
 
 /***********************************************************************************************//**
  * @details     Setup for main program. Initialize all subsystems and report any failures
@@ -54,6 +74,7 @@ void setup()
     digitalWrite(MTR_ENA_0, HIGH);
     digitalWrite(MTR_ENA_1, HIGH);
     delay(200);
+    cycleCounterBegin();                    /* Clock for the loop profiler */
     LEDApp.Init();
 
     if (HWT906App.Init() != 0)              /* Initialize HWT906 IMU module */
@@ -93,10 +114,39 @@ void setup()
     LEDApp.Set_LED_Code(SystemInitState);                           /* Enunciate system intialization state*/
 
     /* Schedule periodic tasks for motor power check and IMU servicing */
-    asyncTask.repeat(Mtr3PowerDisableCheck, 1000);                  /* Check motor power every second */
-    asyncTask.repeat(ServiceIMUapp, IMU_DATA_ACQUSITION_PERIOD);    /* Service IMU periodically */
-    asyncTask.repeat(ServiceLEDapp, LED_FREQ_RATE_MS);              /* Service LED periodically */
-    asyncTask.repeat(ServiceJSswitch, JS_SWITCH_CHK);              /* Service JS swtich periodically */
+    scheduler.repeat(Mtr3PowerDisableCheck, 1000);                  /* Check motor power every second */
+    imuCheck = scheduler.repeat(ServiceIMUapp, IMU_DATA_ACQUSITION_PERIOD);    /* Service IMU when frames stop */
+    scheduler.repeat(ServiceLEDapp, LED_FREQ_RATE_MS);              /* Service LED periodically */
+    scheduler.repeat(ServiceJSswitch, JS_SWITCH_CHK);              /* Service JS swtich periodically */
+    scheduler.repeat(ServiceTracking, TRACK_PERIOD_MS);            /* Service sidereal tracking periodically */
+
+    /* Sources without an interrupt of their own are tested every pass and before sleeping */
+    events.source(EVENT_USB_RX, UsbRxWaiting);
+    events.source(EVENT_BLE_RX, BleRxWaiting);
+    events.source(EVENT_TIMER, TaskDue);
+
+    /* Handlers run in this order, the commands first so the motor services see what they started */
+    events.on(EVENT_USB_RX, ServiceCommands);
+    events.on(EVENT_BLE_RX, ServiceBLE);
+    events.on(EVENT_TIMER, ServiceScheduler);
+    events.on(EVENT_IMU_FRAME, ServiceIMUframe);
+    events.on(EVENT_MOTOR | EVENT_USB_RX | EVENT_BLE_RX | EVENT_TIMER, ServiceMotors);
+
+    HWT906App.OnFrame(PostIMUframe);
+
+    /* DIAG0 of the drivers wired to inputs report errors and stalls without polling */
+    const int8_t diagPins[3] = {MTR_DIAG0_0, MTR_DIAG0_1, MTR_DIAG0_2};
+    for (uint8_t motor = 0; motor < 3; motor++)
+    {
+        if (diagPins[motor] >= 0)
+        {
+            pinMode(diagPins[motor], INPUT_PULLUP);
+            attachInterrupt(digitalPinToInterrupt(diagPins[motor]), PostMotorEvent, FALLING);
+            SystemControlApp.SetDiagEvents(motor, true);
+        }
+    }
+
+    events.post(EVENT_MOTOR);
 }
 
 /***********************************************************************************************//**
@@ -104,9 +154,92 @@ void setup()
  **************************************************************************************************/
 void loop()
 {
-    SystemControlApp.ServiceSystemResponseApp();        /* Process system responses */
-    BLE_App.Service_BLE_UART();                         /* Handle BLE communication */
-    asyncTask.loop();                                   /* Execute other async scheduled tasks */
+    events.dispatch();                                  /* Run the services whose events fired */
+
+    uint32_t start = cycleCount();                      /* Each service is booked to the profiler, see GET_LOOP_PROFILE */
+    events.idle();                                      /* Sleep until an interrupt if none is pending */
+    profileLap(PROFILE_SLEEP, start);
+}
+
+/***********************************************************************************************//**
+ * @details     Process the commands received over USB
+ **************************************************************************************************/
+void ServiceCommands(void)
+{
+    ProfileScope probe(PROFILE_SYSTEM_RESPONSE);
+
+    SystemControlApp.ServiceCommands();
+}
+
+/***********************************************************************************************//**
+ * @details     Handle BLE communication
+ **************************************************************************************************/
+void ServiceBLE(void)
+{
+    ProfileScope probe(PROFILE_BLE_UART);
+
+    BLE_App.Service_BLE_UART();
+}
+
+/***********************************************************************************************//**
+ * @details     Execute the scheduled tasks that are due
+ **************************************************************************************************/
+void ServiceScheduler(void)
+{
+    ProfileScope probe(PROFILE_SCHEDULER);
+
+    scheduler.loop();
+}
+
+/***********************************************************************************************//**
+ * @details     Background motor operations and checks. They keep posting themselves while they
+ *              have work, the loop only sleeps once all of them are done.
+ **************************************************************************************************/
+void ServiceMotors(void)
+{
+    ProfileScope probe(PROFILE_MOTORS);
+
+    if (SystemControlApp.ServiceMotors())
+    {
+        events.post(EVENT_MOTOR);
+    }
+}
+
+/***********************************************************************************************//**
+ * @details     A frame came in, push the IMU check back by a period. It only runs, and counts an
+ *              error, once the frames stop.
+ **************************************************************************************************/
+void ServiceIMUframe(void)
+{
+    ProfileScope probe(PROFILE_IMU_FRAME);
+
+    scheduler.cancel(imuCheck);
+    imuCheck = scheduler.repeat(ServiceIMUapp, IMU_DATA_ACQUSITION_PERIOD);
+}
+
+bool UsbRxWaiting(void)
+{
+    return Serial.available() > 0;
+}
+
+bool BleRxWaiting(void)
+{
+    return BLE_App.available();
+}
+
+bool TaskDue(void)
+{
+    return scheduler.isDue();
+}
+
+void PostIMUframe(void)
+{
+    events.post(EVENT_IMU_FRAME);
+}
+
+void PostMotorEvent(void)
+{
+    events.post(EVENT_MOTOR);
 }
 
 /***********************************************************************************************//**
@@ -115,14 +248,28 @@ void loop()
  **************************************************************************************************/
 void Mtr3PowerDisableCheck(void) 
 {
+	ProfileScope probe(PROFILE_MTR3_POWER);
+
 	SystemControlApp.ServiceMotor3PowerDisable();
 }
 
+/***********************************************************************************************//**
+ * @details     Keeps the tracking rates of motors 0 and 1 current, does nothing unless tracking
+ **************************************************************************************************/
+void ServiceTracking(void)
+{
+    ProfileScope probe(PROFILE_TRACKING);
+
+    SystemControlApp.ServiceTracking();
+}
+
 /***********************************************************************************************//**
  * @details     HWT906 data is collected using an interrupt, this checks for new data and sets errors
  **************************************************************************************************/
 void ServiceIMUapp(void)
 {
+    ProfileScope probe(PROFILE_IMU);
+
     if ((SystemInitState & (1 << INIT_HWT906_STAT_FAILED)) == 0 ) /*ONly run if init passed for device*/
     {
         HWT906App.CheckIMUDataCollection();	
@@ -134,6 +281,8 @@ void ServiceIMUapp(void)
  **************************************************************************************************/
 void ServiceLEDapp(void)
 {
+    ProfileScope probe(PROFILE_LED);
+
     LEDApp.Service_LED();
 }
 
@@ -144,6 +293,8 @@ void ServiceLEDapp(void)
  **************************************************************************************************/
 void ServiceJSswitch(void)
 {
+    ProfileScope probe(PROFILE_JS_SWITCH);
+
     // static int lastJSstate = HIGH;
     // int JSstate = PIOB->PIO_PDSR & PIO_PDSR_P27;
 
@@ -28,6 +28,9 @@
  //#define BLUEFRUIT_INTERRUPT (4)
  #define MTR_ENA_2           (3)
  #define MTR_CS2             (2) 
+ #define MTR_DIAG0_0         (-1)    /* DIAG0 of the drivers, -1 while not wired to an input */
+ #define MTR_DIAG0_1         (-1)
+ #define MTR_DIAG0_2         (-1)
  /* UART RX and TX pins 0 and 1 are reserved*/
  
 
@@ -54,10 +57,65 @@
  // Additional constants
  #define STAND_MTR_VELOCITY 	  (45000)
  #define STAND_MTR3_VELOCITY    (250)
+ #define HOME_BACKOFF_VELOCITY  (STAND_MTR_VELOCITY / 8) // leaving the home switch, slow so the overshoot is short
  #define MTR3_HOLD_POWER        (1)
  #define MTR3_RUN_POWER         (20)
  #define MTR3_ACCELERATION      (20)
 
+ // Ramp planner limits of an axis, register units (see RampPlanner.h)
+ #define RAMP_LIMIT_VMAX        (STAND_MTR_VELOCITY)
+ #define RAMP_LIMIT_A1          (4000)
+ #define RAMP_LIMIT_V1          (15000)
+ #define RAMP_LIMIT_AMAX        (1000)
+ #define RAMP_LIMIT_DMAX        (1400)
+ #define RAMP_LIMIT_D1          (5600)
+ #define RAMP_LIMIT_VSTOP       (10)
+
+ // Sidereal tracking, a position error is closed over this many seconds
+ #define TRACK_CATCHUP_S        (5.0)
+
+ // StallGuard2 calibration, SGT is swept upwards until SG_RESULT running free stays above the margin
+ #define STALL_CAL_SGT_MIN      (-10)
+ #define STALL_CAL_SGT_MAX      (20)
+ #define STALL_CAL_SPEEDS       (5)   // STAND_MTR_VELOCITY, then halved 4 times
+ #define STALL_CAL_SETTLE_MS    (100) // after a speed or SGT change, before sampling
+ #define STALL_CAL_SAMPLES      (16)  // SG_RESULT reads per step
+ #define STALL_SG_MARGIN        (100) // lowest SG_RESULT allowed running free
+ #define STALL_SG_SPREAD        (128) // noisier than this the speed is too low to detect stalls
+ #define STALL_HOME_BACKOFF     (1024) // usteps from the hard stop to home, 4 full steps
+
+ // Encoder position check, see MotorControl :: verifyPosition
+ #define ENC_SAMPLE_MS          (50)  // deviation refresh while the axis has an encoder
+ #define ENC_TOLERANCE_COUNTS   (2)   // deviation allowed at rest, encoder counts
+ #define ENC_MAX_CORRECTIONS    (3)   // per move, a blocked axis is not pushed for ever
+
+ // Driver profile of axes 0 and 1, chopper bands by VMAX, see MotorControl :: setDriverProfile
+ #define DRV_STEALTH_VELOCITY   (STAND_MTR_VELOCITY / 32)    // stealthChop below, tracking and fine moves
+ #define DRV_COOL_VELOCITY      (STAND_MTR_VELOCITY / 16)    // spreadCycle with coolStep from here up
+ #define DRV_HIGH_VELOCITY      (STAND_MTR_VELOCITY * 3 / 4) // full run current from here up
+ #define DRV_SEMIN              (2)   // coolStep raises the current below SG_RESULT 32 * SEMIN
+ #define DRV_SEMAX              (2)   // and lowers it above 32 * (SEMIN + SEMAX + 1)
+ #define DRV_SEUP               (3)   // 8 current steps up per low reading, a load is met at once
+ #define DRV_SEDN               (1)   // 1 step down per 8 high readings
+
+ // XACTUAL estimator, see MotorControl :: estimateXactual
+ #define XEST_CLOCK_TOLERANCE   (0.02f) // TMC5130 clock against TMC5130_FCLK
+ #define XEST_MAX_AGE_MS        (500)   // read at least this often, switch and stall stops are not predicted
+ #define XEST_LIMIT_ERROR       (256)   // usteps, a full step, for the joystick range checks
+ #define XEST_REPORT_ERROR      (16)    // usteps, about 2 arcsec, for reported positions
+
+ // Continuous raster scan, see RasterScan.h
+ #define SCAN_MAX_SIZE          (64)    // columns and rows of a grid
+ #define SCAN_POSITION_ERROR    (64)    // usteps, a point counts as passed this far beyond it
+ #define SCAN_RUNUP_MARGIN      (256)   // usteps at scan speed before the first and after the last point
+ #define SCAN_TRIGGER_PUSHPULL  (1)     // DIAG1 pulses high, 0 leaves it open collector pulling low
+ #define SCAN_COMPARE_PARKED    (0x7FFFFFFFL) // X_COMPARE no axis gets to, no pulse
+
+ // Long commands run as coroutines, see Coroutine.h
+ #define POS_NO_MOVE_SETTLE_MS  (30)    // longest wait for standstill before XACTUAL is overwritten
+ #define STATUS_REPORT_COUNT    (20)    // REQUEST_MOTOR_STATUS reports
+ #define STATUS_REPORT_MS       (1600)  // between them
+
  #define MTR_STATUS_SIZE	      (25)
  #define MOTOR_MICRO_STEPS      (200) //Motor is (1.8) 360/1.8
  #define MOTOR_STEPS_PER_DEGREE (25600)
@@ -0,0 +1,960 @@
+/* ========================================================================
+   $File: NativeBench.cpp$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Host benchmark for the motor stack (pio run -e native -t exec). The
+	unchanged MotorControl/CombinedControl drive three TMC5130Sim chips on
+	their CS pins. For every operation it reports the SPI bus time and the
+	datagrams it costs (virtual clock, exact) and the host CPU time per
+	call (indicative only), then runs a few end to end moves and exits
+	non zero if one of them ends in the wrong place.
+====================================================================== */
+
+#include <time.h>
+#include "Arduino.h"
+#include "AsyncTask.h"
+#include "TaskScheduler.h"
+#include "EventDispatcher.h"
+#include "LoopProfiler.h"
+#include "CombinedControl.h"
+#include "DatagramQueue.h"
+#include "PvtQueue.h"
+#include "RasterScan.h"
+#include "TMC5130Sim.h"
+
+#define BENCH_CALLS			1000
+#define MOVE_TIMEOUT_MS		30000
+#define SLEW_TIMEOUT_MS		120000
+#define TRACK_TICK_MS		500
+#define TRACK_LATITUDE		33.1424
+#define SITE_LONGITUDE		-96.8600
+#define SKY_UNIX_TIME		1792206000UL		// 2026-10-17 03:00 UTC
+#define PVT_STEP_MS			50
+#define PVT_POINTS			400
+#define TASK_RUN_MS			10000
+
+static TMC5130Sim chip[3];
+static CombinedControl control;
+static PvtQueue pvtQueue(control);
+
+static AsyncTask asyncTask;
+static TaskScheduler scheduler;
+
+// The services Main.cpp schedules, by their periods
+static const unsigned long taskPeriods[5] = {1000, 233, 250, 500, 500};
+static unsigned long taskRuns[5];
+
+static int failures = 0;
+static volatile bool moveQueued = false;
+
+static double _hostNs() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long _datagrams() {
+	return chip[0].datagrams + chip[1].datagrams + chip[2].datagrams;
+}
+
+static void _check(const char * name, bool ok) {
+
+	printf("  %-44s %s\n", name, ok ? "ok" : "FAILED");
+	if (!ok) {
+		failures++;
+	}
+}
+
+/* ======================================================================
+	Runs op BENCH_CALLS times and prints the per call cost.
+====================================================================== */
+
+static void _bench(const char * name, void (*op)(unsigned int i)) {
+
+	unsigned long startUs = micros();
+	unsigned long startDatagrams = _datagrams();
+	double startNs = _hostNs();
+
+	for (unsigned int i = 0; i < BENCH_CALLS; i++) {
+		op(i);
+	}
+
+	double hostNs = (_hostNs() - startNs) / BENCH_CALLS;
+	double busUs = (double)(micros() - startUs) / BENCH_CALLS;
+	double datagrams = (double)(_datagrams() - startDatagrams) / BENCH_CALLS;
+
+	printf("  %-28s %10.2f %10.2f %12.0f\n", name, busUs, datagrams, hostNs);
+}
+
+static void _opStatus(unsigned int) { control.status(0); }
+static void _opXactual(unsigned int) { control.getXactual(0); }
+static void _opVelocity(unsigned int) { control.getVelocity(0); }
+static void _opAcceleration(unsigned int) { control.getAcceleration(0); }
+static void _opRefreshFlags(unsigned int) { control.refreshStatusFlags(0); }
+static void _opSetVelocity(unsigned int i) { control.setVelocity(0, 40000 + (i & 1)); }
+static void _opSetVelocitySame(unsigned int) { control.setVelocity(0, 40000); }
+static void _opAsyncTask(unsigned int) { asyncTask.loop(); }
+static void _opScheduler(unsigned int) { scheduler.loop(); }
+static void _opProfileLap(unsigned int) { profileLap(PROFILE_LED, cycleCount()); }
+static void _opGoPos(unsigned int i) { control.goPos(0, (i & 1) ? 25600 : 0); }
+
+static void _opQueueMove(unsigned int i) {
+	control.queueMove(0, (i & 1) ? 25600 : 0, nullptr);
+	datagramQueue.service();
+}
+
+static void _onMoveQueued(uint8_t, const datagram *) {
+	moveQueued = true;
+}
+
+static void _task0() { taskRuns[0]++; }
+static void _task1() { taskRuns[1]++; }
+static void _task2() { taskRuns[2]++; }
+static void _task3() { taskRuns[3]++; }
+static void _task4() { taskRuns[4]++; }
+static void (* const tasks[5])() = {_task0, _task1, _task2, _task3, _task4};
+
+// Sleeps, then awaits a flag with and without a timeout, stamping when it got past each
+class BenchCoroutine : public Coroutine {
+	public:
+		bool flag = false;
+		unsigned long woke = 0;
+		unsigned long flagged = 0;
+		unsigned long timedOut = 0;
+		unsigned long resume() {
+			CO_BEGIN();
+			CO_SLEEP(100);
+			woke = millis();
+			CO_AWAIT(flag);
+			flagged = millis();
+			CO_AWAIT_FOR(!flag, 50);
+			timedOut = millis();
+			CO_END();
+		}
+};
+static BenchCoroutine benchCoroutine;
+
+// Records the order the handlers run in, the busy one posts itself while busyPasses lasts
+static EventDispatcher events;
+static char eventTrace[16];
+static uint8_t eventTraceLength = 0;
+static uint8_t busyPasses = 0;
+static bool rxWaiting = false;
+static void _onRx() { eventTrace[eventTraceLength++] = 'r'; rxWaiting = false; }
+static void _onTimer() { eventTrace[eventTraceLength++] = 't'; }
+static void _onBusy() {
+	eventTrace[eventTraceLength++] = 'b';
+	if (busyPasses != 0) {
+		busyPasses--;
+		events.post(1UL << 2);
+	}
+}
+static bool _rxWaiting() { return rxWaiting; }
+
+/* ======================================================================
+	Advances the clock in 1ms ticks, as the main loop would poll, until the
+	motor reports standstill at its target. Returns the move time in ms.
+====================================================================== */
+
+static unsigned long _waitForMove(uint8_t motor_id) {
+
+	unsigned long start = millis();
+
+	// Let the ramp start before trusting standstill
+	delay(5);
+
+	while (millis() - start < MOVE_TIMEOUT_MS) {
+		delay(1);
+		control.refreshStatusFlags(motor_id);
+		if (control.atPosition(motor_id) && control.standstill(motor_id)) {
+			break;
+		}
+	}
+	return millis() - start;
+}
+
+/* ======================================================================
+	Services homing once per 1ms tick like the main loop does. Returns the
+	homing time in ms, worstUs gets the longest single setHome() call.
+====================================================================== */
+
+static unsigned long _home(uint8_t motor_id, unsigned long * worstUs) {
+
+	unsigned long start = millis();
+	*worstUs = 0;
+
+	while (millis() - start < MOVE_TIMEOUT_MS) {
+		unsigned long callStart = micros();
+		bool done = control.setHome(motor_id);
+		unsigned long callUs = micros() - callStart;
+
+		if (callUs > *worstUs) {
+			*worstUs = callUs;
+		}
+		if (done) {
+			break;
+		}
+		delay(1);
+	}
+	return millis() - start;
+}
+
+/* ======================================================================
+	Watches chips 0 and 1 in 1ms ticks until both rest at their targets
+	and returns the arrival time of each, in ms from the call.
+====================================================================== */
+
+static void _arrivals(signed long target0, signed long target1, unsigned long * arrival0, unsigned long * arrival1) {
+
+	unsigned long start = millis();
+	*arrival0 = 0;
+	*arrival1 = 0;
+
+	while ((*arrival0 == 0 || *arrival1 == 0) && millis() - start < MOVE_TIMEOUT_MS) {
+		delay(1);
+		if (*arrival0 == 0 && chip[0].position() == target0 && chip[0].velocity() == 0.0) {
+			*arrival0 = millis() - start;
+		}
+		if (*arrival1 == 0 && chip[1].position() == target1 && chip[1].velocity() == 0.0) {
+			*arrival1 = millis() - start;
+		}
+	}
+}
+
+/* ======================================================================
+	Advances the clock in 1ms ticks until the chip rests at target and
+	returns the time it took in ms.
+====================================================================== */
+
+static unsigned long _restAt(uint8_t motor_id, signed long target) {
+
+	unsigned long start = millis();
+
+	while (!(chip[motor_id].position() == target && chip[motor_id].velocity() == 0.0) &&
+		   millis() - start < SLEW_TIMEOUT_MS) {
+		delay(1);
+	}
+	return millis() - start;
+}
+
+/* ======================================================================
+	Calls a one step per call sequence (calibrateStall, setHomeSensorless)
+	once per 1ms tick, as the main loop would, until it reports done.
+	Returns the time it took in ms.
+====================================================================== */
+
+static unsigned long _runSteps(bool (CombinedControl::*step)(uint8_t), uint8_t motor_id) {
+
+	unsigned long start = millis();
+
+	while (!(control.*step)(motor_id) && millis() - start < SLEW_TIMEOUT_MS) {
+		delay(1);
+	}
+	return millis() - start;
+}
+
+/* ======================================================================
+	Moves motor 1 from 0 to target, with goPosPlanned or the fixed goPos
+	ramp, and returns the time until the chip rests at target in ms.
+====================================================================== */
+
+static unsigned long _slew(signed long target, bool planned) {
+
+	control.goPos(1, 0);
+	_restAt(1, 0);
+
+	if (planned) {
+		control.goPosPlanned(1, target);
+	}
+	else {
+		control.goPos(1, target);
+	}
+	return _restAt(1, target);
+}
+
+/* ======================================================================
+	Runs tracking for seconds in TRACK_TICK_MS updates and returns the
+	worst distance of the chips from where sky says the star is, arcsec.
+====================================================================== */
+
+static double _track(SkyTracker & sky, unsigned long seconds) {
+
+	double worst = 0.0;
+
+	for (unsigned long tick = 0; tick < seconds * 1000 / TRACK_TICK_MS; tick++) {
+		delay(TRACK_TICK_MS);
+		control.serviceTracking();
+
+		double altitude, azimuth;
+		sky.position(millis(), altitude, azimuth);
+		double error0 = fabs(chip[0].position() + azimuth * MOTOR_STEPS_PER_DEGREE);
+		double error1 = fabs(chip[1].position() - altitude * MOTOR_STEPS_PER_DEGREE);
+		worst = max(worst, max(error0, error1) * 3600.0 / MOTOR_STEPS_PER_DEGREE);
+	}
+	return worst;
+}
+
+/* ======================================================================
+	SkyCoordinates :: toHorizontal in double and from the whole Julian
+	date, the reference the float version is held against.
+====================================================================== */
+
+static void _horizontalReference(double ra, double dec, double unixTime, double & altitude, double & azimuth) {
+
+	double days = (unixTime - J2000_UNIX) / 86400.0;
+	double years = days / 365.25;
+	double lat = TRACK_LATITUDE * DEG_TO_RAD;
+
+	ra *= 15.0 * DEG_TO_RAD;
+	dec *= DEG_TO_RAD;
+	double shiftRa = (0.0128125 + 0.0055667 * sin(ra) * tan(dec)) * years * DEG_TO_RAD;
+	dec += 0.0055667 * cos(ra) * years * DEG_TO_RAD;
+	ra += shiftRa;
+
+	double hourAngle = fmod(280.46061837 + 360.98564736629 * days + SITE_LONGITUDE, 360.0) * DEG_TO_RAD - ra;
+	altitude = asin(sin(lat) * sin(dec) + cos(lat) * cos(dec) * cos(hourAngle)) * RAD_TO_DEG;
+	azimuth = atan2(-cos(dec) * sin(hourAngle), cos(lat) * sin(dec) - sin(lat) * cos(dec) * cos(hourAngle)) * RAD_TO_DEG;
+	azimuth = fmod(azimuth + 360.0, 360.0);
+	altitude += 1.02 / tan((altitude + 10.3 / (altitude + 5.11)) * DEG_TO_RAD) / 60.0;
+}
+
+/* ======================================================================
+	Point i of the bench trajectory: motor 0 swings 2 deg either way in
+	20 s, motor 1 climbs at 0.5 deg/s.
+====================================================================== */
+
+static pvtPoint _pvtPoint(unsigned int i) {
+
+	double t = i * PVT_STEP_MS / 1000.0;
+	double w = 2.0 * M_PI / 20.0;
+
+	pvtPoint point;
+	point.time = i * PVT_STEP_MS;
+	point.position0 = lround(2.0 * MOTOR_STEPS_PER_DEGREE * sin(w * t));
+	point.velocity0 = lround(2.0 * MOTOR_STEPS_PER_DEGREE * w * cos(w * t));
+	point.position1 = lround(0.5 * MOTOR_STEPS_PER_DEGREE * t);
+	point.velocity1 = lround(0.5 * MOTOR_STEPS_PER_DEGREE);
+	return point;
+}
+
+int main() {
+
+	hal::reset();
+	hal::attachSpiDevice(MTR_CS0, &chip[0]);
+	hal::attachSpiDevice(MTR_CS1, &chip[1]);
+	hal::attachSpiDevice(MTR_CS2, &chip[2]);
+
+	for (uint8_t i = 0; i < 3; i++) {
+		chip[i].powerOn();
+	}
+
+	SPI.begin();
+	datagramQueue.begin();
+
+	unsigned long startUs = micros();
+	control.begin();
+
+	printf("begin(): %lu us bus time, %lu datagrams\n\n", micros() - startUs, _datagrams());
+
+	printf("  %-28s %10s %10s %12s\n", "operation", "bus us", "datagrams", "host ns");
+	_bench("status()", _opStatus);
+	_bench("getXactual()", _opXactual);
+	_bench("getVelocity()", _opVelocity);
+	_bench("getAcceleration() (shadow)", _opAcceleration);
+	_bench("refreshStatusFlags()", _opRefreshFlags);
+	_bench("setVelocity() changing", _opSetVelocity);
+	_bench("setVelocity() redundant", _opSetVelocitySame);
+	_bench("goPos()", _opGoPos);
+	_bench("queueMove() + service()", _opQueueMove);
+
+	for (uint8_t i = 0; i < 5; i++) {
+		asyncTask.repeat(tasks[i], taskPeriods[i]);
+		scheduler.repeat(tasks[i], taskPeriods[i]);
+	}
+	asyncTask.loop();
+	_bench("AsyncTask loop, none due", _opAsyncTask);
+	_bench("TaskScheduler loop, none due", _opScheduler);
+	_bench("profileLap()", _opProfileLap);
+	asyncTask.clearAllTasks();
+
+	// Park motor 0 at 0 before the end to end checks
+	control.goPos(0, 0);
+	_waitForMove(0);
+
+	printf("\nend to end\n");
+
+	_check("power on reset flag cleared by begin()", !control.status(0).get(STATUS_BIT_RESET));
+
+	control.setAcceleration(1, 1234);
+	_check("write only AMAX reads back from the shadow", control.getAcceleration(1) == 1234);
+	control.setAcceleration(1, 0x0000C350);
+
+	signed long target = 10L * MOTOR_STEPS_PER_DEGREE;
+	unsigned long moveMs;
+
+	control.goPos(0, target);
+	moveMs = _waitForMove(0);
+	printf("  goPos(0, 10 deg) settled after %lu ms\n", moveMs);
+	_check("chip 0 at target", chip[0].position() == target);
+	_check("getXactual(0) reports target", control.getXactual(0) == (double)target);
+
+	control.goPos(0, -target);
+	_waitForMove(0);
+	_check("chip 0 at negative target", chip[0].position() == -target);
+
+	moveQueued = false;
+	control.queueMove(1, target / 2, _onMoveQueued);
+	datagramQueue.service();
+	_check("queueMove callback fired", moveQueued);
+	moveMs = _waitForMove(1);
+	printf("  queueMove(1, 5 deg) settled after %lu ms\n", moveMs);
+	_check("chip 1 at target", chip[1].position() == target / 2);
+
+	moveQueued = false;
+	control.queueMove(1, target / 2, _onMoveQueued);
+	datagramQueue.service();
+	_check("queueMove to the present target still calls back", moveQueued);
+
+	unsigned long worstUs;
+	signed long home = 2L * MOTOR_STEPS_PER_DEGREE;
+	signed long tolerance = (signed long)(STAND_MTR_VELOCITY * TMC5130_SIM_STEP_US / 1000000.0 * TMC5130_SIM_FCLK / 16777216.0) + 1;
+
+	chip[0].refFromPosition = true;
+	chip[0].refRPosition = home;
+	moveMs = _home(0, &worstUs);
+	printf("  setHome(0) from -10 deg done after %lu ms, longest call %lu us\n", moveMs, worstUs);
+	_check("motor 0 homed", control.status(0).get(STATUS_BIT_IS_HOMED));
+	_check("motor 0 parked on the latched switch edge", fabs(chip[0].rotor() - home) <= tolerance);
+	_check("motor 0 home is coordinate 0", control.getXactual(0) == 0);
+	_check("setHome() never blocks for the travel", worstUs < 1000);
+
+	chip[2].refFromPosition = true;
+	chip[2].refRPosition = -home;
+	moveMs = _home(2, &worstUs);
+	printf("  setHome(2) starting on the switch done after %lu ms\n", moveMs);
+	_check("motor 2 parked on the latched switch edge", fabs(chip[2].rotor() + home) <= tolerance);
+	_check("motor 2 home is coordinate 0", control.getXactual(2) == 0);
+
+	unsigned long arrival0;
+	unsigned long arrival1;
+
+	// Start both moves from the same state, clear of the switches
+	chip[0].refFromPosition = false;
+	chip[2].refFromPosition = false;
+	control.goPos(0, 0);
+	control.goPos(1, 0);
+	_arrivals(0, 0, &arrival0, &arrival1);
+
+	control.goPos(0, 12L * MOTOR_STEPS_PER_DEGREE);
+	control.goPos(1, 3L * MOTOR_STEPS_PER_DEGREE);
+	_arrivals(12L * MOTOR_STEPS_PER_DEGREE, 3L * MOTOR_STEPS_PER_DEGREE, &arrival0, &arrival1);
+	printf("  goPos 12/3 deg: arrivals %lu / %lu ms\n", arrival0, arrival1);
+
+	control.goPos(0, 0);
+	control.goPos(1, 0);
+	_arrivals(0, 0, &arrival0, &arrival1);
+
+	control.goPosSync(12L * MOTOR_STEPS_PER_DEGREE, 3L * MOTOR_STEPS_PER_DEGREE);
+	_arrivals(12L * MOTOR_STEPS_PER_DEGREE, 3L * MOTOR_STEPS_PER_DEGREE, &arrival0, &arrival1);
+	printf("  goPosSync 12/3 deg: arrivals %lu / %lu ms\n", arrival0, arrival1);
+	_check("synchronized arrival within 2% of the move", labs((long)arrival0 - (long)arrival1) * 50 <= (long)max(arrival0, arrival1));
+
+	unsigned long waitedMs = 0;
+	while (!control.syncMoveDone() && waitedMs < 1000) {
+		delay(1);
+		waitedMs++;
+	}
+	_check("syncMoveDone() reports both axes settled", waitedMs < 1000);
+
+	control.goPos(1, 0);
+	_waitForMove(1);
+	_check("goPos after goPosSync restores the nominal ramp", chip[1].registerValue(ADDRESS_AMAX) == 0x0000C350);
+
+	static const double slewDegrees[] = {0.05, 0.5, 2.0, 10.0, 45.0, 90.0};
+	RampPlanner planner;
+	bool plannedFaster = true;
+	bool modelMatches = true;
+	bool floatMatches = true;
+
+	printf("  %-10s %12s %12s %12s\n", "slew deg", "goPos ms", "planned ms", "model ms");
+	for (uint8_t i = 0; i < sizeof(slewDegrees) / sizeof(slewDegrees[0]); i++) {
+		signed long target = lround(slewDegrees[i] * MOTOR_STEPS_PER_DEGREE);
+		unsigned long fixedMs = _slew(target, false);
+		unsigned long plannedMs = _slew(target, true);
+		double modelMs = 1000.0 * RampPlanner :: slewTime(planner.plan(target), target);
+
+		printf("  %-10.2f %12lu %12lu %12.0f\n", slewDegrees[i], fixedMs, plannedMs, modelMs);
+		plannedFaster = plannedFaster && (plannedMs <= fixedMs);
+		modelMatches = modelMatches && (fabs(plannedMs - modelMs) <= 5.0 + 0.02 * modelMs);
+		floatMatches = floatMatches && (fabs(1000.0 * RampPlanner :: slewTimef(planner.plan(target), target) - modelMs) <= 1.0 + 0.001 * modelMs);
+	}
+	_check("planned slews are never slower than goPos", plannedFaster);
+	_check("planner slew time model matches the chip", modelMatches);
+	_check("float slew time matches the double one", floatMatches);
+
+	control.goPos(0, -120L * MOTOR_STEPS_PER_DEGREE);
+	control.goPos(1, 40L * MOTOR_STEPS_PER_DEGREE);
+	_restAt(0, -120L * MOTOR_STEPS_PER_DEGREE);
+	_restAt(1, 40L * MOTOR_STEPS_PER_DEGREE);
+
+	SkyTracker sky;
+	sky.setLatitude(TRACK_LATITUDE);
+	sky.setTarget(40.0, 120.0, millis());
+	control.startTracking(TRACK_LATITUDE);
+
+	unsigned long trackDatagrams = chip[0].datagrams + chip[1].datagrams;
+	double trackError = _track(sky, 600);
+	trackDatagrams = chip[0].datagrams + chip[1].datagrams - trackDatagrams;
+	printf("  tracking 600 s: worst error %.2f arcsec, %.1f datagrams per update\n",
+		trackError, trackDatagrams * (double)TRACK_TICK_MS / 600000.0);
+	_check("tracking stays within 2 arcsec of the star", trackError <= 2.0);
+	_check("tracking runs in velocity mode", chip[0].registerValue(ADDRESS_RAMPMODE) != ADDRESS_MODE_POSITION &&
+											 chip[1].registerValue(ADDRESS_RAMPMODE) != ADDRESS_MODE_POSITION);
+
+	double altitude, azimuth;
+	sky.position(millis(), altitude, azimuth);
+	sky.setTarget(altitude + 0.05, azimuth - 0.05, millis());
+	control.syncTracking(altitude + 0.05, azimuth - 0.05);
+	_track(sky, 30);
+	trackError = _track(sky, 30);
+	printf("  re-sync by 0.05/0.05 deg: error %.2f arcsec after 30 s\n", trackError);
+	_check("re-sync offset is taken up within 30 s", trackError <= 2.0);
+
+	control.stopTracking();
+	delay(100);
+	_check("stopTracking leaves the mount at rest", chip[0].velocity() == 0.0 && chip[1].velocity() == 0.0 && !control.isTracking());
+
+	// Meeus, example 12.a: 1987-04-10 0h UT, GMST 13h10m46.3668s
+	SkyCoordinates site;
+	site.setSite(0.0f, 0.0f);
+	site.setTime(545011200UL, millis());
+	double gmstError = fabs(site.siderealTime(millis()) - 197.693195) * 3600.0;
+	printf("  sidereal time 1987-04-10: error %.2f arcsec\n", gmstError);
+	_check("float sidereal time within 2 arcsec", gmstError <= 2.0);
+
+	site.setSite(TRACK_LATITUDE, SITE_LONGITUDE);
+	site.setTime(SKY_UNIX_TIME, millis());
+	double worstSky = 0.0;
+	float gotoRa = 0.0f, gotoDec = 0.0f;
+	for (int ra = 0; ra < 24; ra++) {
+		for (int dec = -30; dec <= 80; dec += 10) {
+			float altitude, azimuth;
+			double refAltitude, refAzimuth;
+			site.toHorizontal(ra + 0.5f, dec + 0.5f, millis(), altitude, azimuth);
+			_horizontalReference(ra + 0.5, dec + 0.5, SKY_UNIX_TIME, refAltitude, refAzimuth);
+			if (refAltitude < 5.0) {
+				continue;
+			}
+			double azimuthError = fmod(fabs(azimuth - refAzimuth) + 180.0, 360.0) - 180.0;
+			worstSky = max(worstSky, max(fabs(altitude - refAltitude), fabs(azimuthError) * cos(refAltitude * DEG_TO_RAD)) * 3600.0);
+			if (refAltitude > 40.0 && refAltitude < 60.0) {
+				gotoRa = ra + 0.5f;
+				gotoDec = dec + 0.5f;
+			}
+		}
+	}
+	printf("  float alt/az against double: worst %.2f arcsec\n", worstSky);
+	_check("float alt/az within 5 arcsec of double", worstSky <= 5.0);
+
+	control.goPos(0, 0);
+	control.goPos(1, 0);
+	_restAt(0, 0);
+	_restAt(1, 0);
+	control.setSite(TRACK_LATITUDE, SITE_LONGITUDE);
+	control.setTime(SKY_UNIX_TIME);
+	site.setTime(SKY_UNIX_TIME, millis());
+	bool gotoStarted = control.goRaDec(gotoRa, gotoDec);
+	unsigned long gotoMs = 0;
+	while (gotoStarted && !control.syncMoveDone() && gotoMs < SLEW_TIMEOUT_MS) {
+		delay(1);
+		gotoMs++;
+	}
+	float starAltitude, starAzimuth;
+	site.toHorizontal(gotoRa, gotoDec, millis(), starAltitude, starAzimuth);
+	if (starAzimuth > 180.0f) {
+		starAzimuth -= 360.0f;
+	}
+	double gotoError = max(fabs(chip[0].position() + starAzimuth * MOTOR_STEPS_PER_DEGREE),
+						   fabs(chip[1].position() - starAltitude * MOTOR_STEPS_PER_DEGREE)) * 3600.0 / MOTOR_STEPS_PER_DEGREE;
+	printf("  goRaDec %.1fh %+.1f deg: %lu ms, %.1f arcsec off the star on arrival\n", gotoRa, gotoDec, gotoMs, gotoError);
+	_check("goRaDec arrives within 30 arcsec of the star", gotoStarted && gotoError <= 30.0);
+
+	control.goPos(0, 0);
+	control.goPos(1, 0);
+	_restAt(0, 0);
+	_restAt(1, 0);
+
+	unsigned int pushed = 0;
+	while (pushed < PVT_POINTS && pvtQueue.push(_pvtPoint(pushed))) {
+		pushed++;
+	}
+	pvtQueue.start(millis());
+	unsigned long pvtStart = millis();
+	unsigned long pvtDatagrams = chip[0].datagrams + chip[1].datagrams;
+	double pvtError = 0.0;
+	unsigned int underrunEvents = 0;
+
+	for (unsigned int point = 1; point < PVT_POINTS; ) {
+		while (pushed < PVT_POINTS && pvtQueue.freeSlots() > 0) {
+			pvtQueue.push(_pvtPoint(pushed++));
+		}
+		underrunEvents += pvtQueue.service(millis());
+		delay(1);
+		if (millis() - pvtStart >= _pvtPoint(point).time) {
+			// The start from rest and the stop at the last point cannot follow the trajectory
+			pvtPoint expected = _pvtPoint(point++);
+			if (expected.time >= 1500 && point < PVT_POINTS - 1) {
+				pvtError = max(pvtError, max(fabs((double)chip[0].position() - expected.position0),
+											 fabs((double)chip[1].position() - expected.position1)));
+			}
+		}
+	}
+	pvtDatagrams = chip[0].datagrams + chip[1].datagrams - pvtDatagrams;
+	printf("  pvt %u points every %d ms: worst error after 1.5 s %.0f usteps (%.1f arcsec), %.1f datagrams per point\n",
+		PVT_POINTS, PVT_STEP_MS, pvtError, pvtError * 3600.0 / MOTOR_STEPS_PER_DEGREE, pvtDatagrams / (double)PVT_POINTS);
+	_check("pvt points are hit within 30 arcsec", pvtError * 3600.0 / MOTOR_STEPS_PER_DEGREE <= 30.0);
+	_check("pvt fed in time never underruns until the end", underrunEvents == 0 && pvtQueue.latePoints == 0);
+
+	for (unsigned int i = 0; i < 2 * PVT_STEP_MS; i++) {
+		underrunEvents += pvtQueue.service(millis());
+		delay(1);
+	}
+	_check("pvt reports the underrun past the last point", underrunEvents == 1 && pvtQueue.underruns == 1);
+
+	for (unsigned int i = 0; i < PVT_UNDERRUN_MS && pvtQueue.isRunning(); i++) {
+		pvtQueue.service(millis());
+		delay(1);
+	}
+	_check("pvt stops running once the coast is over", !pvtQueue.isRunning());
+
+	unsigned long overrunsBefore = pvtQueue.overruns;
+	pvtQueue.stop();
+	for (unsigned int i = 0; i <= PVT_QUEUE_DEPTH; i++) {
+		pvtQueue.push(_pvtPoint(i));
+	}
+	_check("pvt counts the overrun of a full queue", pvtQueue.overruns == overrunsBefore + 1);
+	pvtQueue.stop();
+
+	control.goPos(1, 0);
+	_restAt(1, 0);
+
+	unsigned long calibrationMs = _runSteps(&CombinedControl::calibrateStall, 1);
+	const stallProfile & profile = control.getStallProfile(1);
+	signed long calibrationDrift = chip[1].position();
+	printf("  stall calibration: %lu ms, SGT %d from VMAX %lu, SG_RESULT >= %u running free, ends %ld usteps off\n",
+		calibrationMs, profile.sgt, profile.velocity, profile.sgFree, calibrationDrift);
+	_check("stall calibration finds a threshold clear of the noise", profile.calibrated && profile.sgFree >= STALL_SG_MARGIN);
+	_check("stall calibration stays within a degree", labs(calibrationDrift) < MOTOR_STEPS_PER_DEGREE);
+
+	control.goPos(1, 0);
+	_restAt(1, 0);
+	control.armStallGuard(1, true);
+	chip[1].hardStops = true;
+	chip[1].hardStopL = -10L * MOTOR_STEPS_PER_DEGREE;
+	chip[1].hardStopR = 2L * MOTOR_STEPS_PER_DEGREE;
+
+	unsigned long stallStart = millis();
+	unsigned long stallHit = 0;
+	bool stallReported = false;
+	control.goPos(1, 5L * MOTOR_STEPS_PER_DEGREE);
+	while (!stallReported && millis() - stallStart < MOVE_TIMEOUT_MS) {
+		delay(1);
+		if (stallHit == 0 && chip[1].position() >= chip[1].hardStopR) {
+			stallHit = millis();
+		}
+		stallReported = control.stallStopped(1);
+	}
+	signed long stallOvershoot = chip[1].position() - chip[1].hardStopR;
+	printf("  collision at full speed: chip stops %ld usteps into the hard stop, reported %lu ms later\n",
+		stallOvershoot, millis() - stallHit);
+	_check("the guard stops a collision within a full step", stallReported && stallOvershoot >= 0 && stallOvershoot <= 256);
+
+	signed long stalledAt = chip[1].position();
+	delay(500);
+	_check("a stall stop leaves the motor parked", chip[1].position() == stalledAt && chip[1].velocity() == 0.0 &&
+		   !control.stallStopped(1));
+
+	control.goPos(1, 0);
+	bool checkAfterMove = control.checksPending(1);
+	_restAt(1, 0);
+	control.stallStopped(1);
+	_check("an armed guard keeps the loop awake only until the move ends", checkAfterMove && !control.checksPending(1));
+	unsigned long sensorlessMs = _runSteps(&CombinedControl::setHomeSensorless, 1);
+	_restAt(1, 0);			// the model takes one integration step to stop after the rezero
+	printf("  sensorless homing: %lu ms, home %.0f usteps from the hard stop\n",
+		sensorlessMs, chip[1].hardStopR - chip[1].rotor());
+	_check("sensorless homing rests STALL_HOME_BACKOFF short of the hard stop",
+		   fabs(chip[1].hardStopR - STALL_HOME_BACKOFF - chip[1].rotor()) <= 2 && chip[1].velocity() == 0.0);
+	_check("sensorless home is coordinate 0", chip[1].position() == 0 && control.getXactual(1) == 0);
+
+	chip[1].hardStops = false;
+	control.armStallGuard(1, false);
+
+	control.goPos(1, 0);
+	_restAt(1, 0);
+	const double rotorZero = chip[1].rotor();		// homing moved coordinate 0 off the rotor's origin
+	chip[1].encoderResolution = MOTOR_STEPS_PER_DEGREE / 2000.0;
+	control.setEncoder(1, 2000.0f);
+
+	const signed long encoderTarget = 3L * MOTOR_STEPS_PER_DEGREE;
+	unsigned long encoderStart = millis();
+	unsigned int lostStepEvents = 0;
+	bool slipped = false;
+	control.goPos(1, encoderTarget);
+	while (millis() - encoderStart < MOVE_TIMEOUT_MS) {
+		delay(1);
+		if (!slipped && chip[1].position() >= encoderTarget / 2) {
+			chip[1].slip(-800.0);			// a missed full step and then some, mid slew
+			slipped = true;
+		}
+		lostStepEvents += control.verifyPosition(1);
+		if (lostStepEvents > 0 && chip[1].velocity() == 0.0 && fabs(chip[1].rotor() - rotorZero - encoderTarget) < 50.0) {
+			break;
+		}
+	}
+	for (unsigned int i = 0; i < 500; i++) {
+		delay(1);
+		lostStepEvents += control.verifyPosition(1);
+	}
+	const encoderState & encoder = control.getEncoder(1);
+	printf("  lost steps: %lu ms, %ld usteps max deviation, rotor %.0f usteps off after %lu correction(s), tolerance %lu\n",
+		millis() - encoderStart, encoder.maxDeviation, chip[1].rotor() - rotorZero - encoderTarget, encoder.corrections, encoder.tolerance);
+	_check("lost steps are made good once at the end of the move", lostStepEvents == 1 && encoder.corrections == 1);
+	_check("the rotor ends at the target within the encoder tolerance",
+		   fabs(chip[1].rotor() - rotorZero - encoderTarget) <= encoder.tolerance && labs(encoder.deviation) <= (long)encoder.tolerance);
+
+	control.setEncoder(1, 0.0f);
+	chip[1].encoderResolution = 0.0;
+
+	control.goPos(1, 0);
+	_restAt(1, 0);
+	uint8_t irun = TMC5130::IHOLD_IRUN::IRUN::get(chip[1].registerValue(TMC5130::IHOLD_IRUN::address));
+
+	control.constForward(1, DRV_STEALTH_VELOCITY / 8);
+	delay(200);
+	bool trackingStealth = chip[1].stealthChop();
+
+	control.constForward(1, (DRV_COOL_VELOCITY + DRV_HIGH_VELOCITY) / 2);
+	delay(2000);
+	bool slewSpread = !chip[1].stealthChop();
+	uint8_t lightCurrent = control.getCurrentScale(1);
+	chip[1].sgLoad = 250;
+	delay(100);
+	uint8_t loadedCurrent = control.getCurrentScale(1);
+	chip[1].sgLoad = 0;
+
+	control.constForward(1, STAND_MTR_VELOCITY);
+	delay(1000);
+	uint8_t highCurrent = control.getCurrentScale(1);
+	control.stop(1);
+	printf("  driver profile: CS_ACTUAL of IRUN %u light %u, loaded %u, above THIGH %u\n",
+		irun, lightCurrent, loadedCurrent, highCurrent);
+	_check("tracking runs in stealthChop, slews in spreadCycle", trackingStealth && slewSpread);
+	_check("coolStep halves the current at light load", lightCurrent <= (irun + 1) / 2);
+	_check("coolStep restores the current under load", loadedCurrent == irun);
+	_check("full run current above THIGH", highCurrent == irun);
+
+	// Joystick on motor 0: a new speed every 150 ms, a range check every 20 ms
+	static const signed long stickSpeeds[8] = {20000, 45000, 5000, 0, -30000, -45000, -2000, 0};
+	control.goPos(0, 0);
+	_restAt(0, 0);
+	const positionEstimate & estimate = control.getEstimate(0);
+	unsigned long estimateReads = estimate.reads;
+	unsigned long estimateServed = estimate.served;
+	unsigned long stickDatagrams = chip[0].datagrams;
+	double estimateError = 0.0;
+	for (unsigned int tick = 0; tick < 8 * 150 / 20; tick++) {
+		signed long speed = stickSpeeds[tick * 20 / 150];
+		if (speed >= 0) {
+			control.constForward(0, speed);
+		}
+		else {
+			control.constReverse(0, -speed);
+		}
+		signed long estimated = control.estimateXactual(0, XEST_LIMIT_ERROR);
+		estimateError = max(estimateError, fabs((double)(estimated - chip[0].position())));
+		delay(20);
+	}
+	control.stop(0);
+	estimateReads = estimate.reads - estimateReads;
+	estimateServed = estimate.served - estimateServed;
+	stickDatagrams = chip[0].datagrams - stickDatagrams;
+	printf("  joystick 1.2 s: %lu XACTUAL reads for %lu estimates, worst error %.0f usteps, %lu datagrams\n",
+		estimateReads, estimateReads + estimateServed, estimateError, stickDatagrams);
+	_check("the estimate stays within XEST_LIMIT_ERROR", estimateError <= XEST_LIMIT_ERROR);
+	_check("range checks mostly skip the bus", estimateReads * 4 <= estimateReads + estimateServed);
+
+	// Raster scan, 5 x 3 points 0.1 deg apart, DIAG1 pulses without stopping at the points
+	RasterScan scan(control);
+	scanGrid grid;
+	grid.columns = 5;
+	grid.rows = 3;
+	grid.spacing0 = -MOTOR_STEPS_PER_DEGREE / 10;
+	grid.spacing1 = MOTOR_STEPS_PER_DEGREE / 10;
+	grid.velocity = STAND_MTR_VELOCITY / 4;
+	control.goPos(0, 0);
+	control.goPos(1, 0);
+	_restAt(0, 0);
+	_restAt(1, 0);
+	signed long scanCenter0 = chip[0].position();
+	signed long scanCenter1 = chip[1].position();
+	unsigned long pulses = chip[0].comparePulses;
+	unsigned long scanPoints = 0;
+	double pulseSpeed = 1e9;
+	bool scanDone = false;
+	unsigned long scanStart = millis();
+	bool scanStarted = scan.start(grid);
+	while (scanStarted && !scanDone && millis() - scanStart < SLEW_TIMEOUT_MS) {
+		scanEvent event = scan.service();
+		if (event == SCAN_POINT) {
+			scanPoints++;
+			pulseSpeed = min(pulseSpeed, chip[0].compareSpeed);
+		}
+		scanDone = (event == SCAN_DONE);
+		delay(1);
+	}
+	pulses = chip[0].comparePulses - pulses;
+	double scanSpeed = grid.velocity * TMC5130_FCLK / 16777216.0;
+	printf("  raster scan 5x3: %lu ms, %lu points, %lu pulses (%lu missed), slowest pulse at %.0f%% of the scan speed\n",
+		millis() - scanStart, scanPoints, pulses, scan.missed, 100.0 * pulseSpeed / scanSpeed);
+	_check("the scan passes every point with one DIAG1 pulse", scanDone && scanPoints == 15 && pulses == 15 && scan.missed == 0);
+	_check("the pulses come at the scan speed", pulseSpeed >= 0.95 * scanSpeed);
+	_check("the scan ends back at the centre", chip[0].position() == scanCenter0 && chip[1].position() == scanCenter1);
+
+	control.resetSpiStats();
+	unsigned long statusDatagrams = chip[2].datagrams;
+	control.status(2);
+	statusDatagrams = chip[2].datagrams - statusDatagrams;
+
+	unsigned long counted = 0;
+	printf("  status(2) traffic: header transfers total_us max_cycles\n");
+	for (uint8_t slot = 0; slot < control.getSpiStatsUsed(2); slot++) {
+		const spiRegisterStats & stats = control.getSpiStats(2, slot);
+		printf("    0x%02X %6lu %8lu %10lu\n", stats.header, stats.transfers,
+			(unsigned long)(stats.totalCycles / CYCLES_PER_US), stats.maxCycles);
+		counted += stats.transfers;
+	}
+	_check("spi stats count every status() datagram", counted == statusDatagrams);
+
+	// Scheduler: Main.cpp's services for TASK_RUN_MS in 1 ms passes, a once task cancelled
+	for (uint8_t i = 0; i < 5; i++) {
+		taskRuns[i] = 0;
+	}
+	scheduler.clearAllTasks();
+	for (uint8_t i = 0; i < 5; i++) {
+		scheduler.repeat(tasks[i], taskPeriods[i]);
+	}
+	taskHandle cancelled = scheduler.once(_task0, 50);
+	bool wasScheduled = scheduler.isScheduled(cancelled) && scheduler.cancel(cancelled);
+	taskHandle fired = scheduler.once(_task1, 5);
+	for (unsigned long ms = 0; ms < TASK_RUN_MS; ms++) {
+		delay(1);
+		scheduler.loop();
+	}
+	bool runsExact = true;
+	for (uint8_t i = 0; i < 5; i++) {
+		unsigned long expected = TASK_RUN_MS / taskPeriods[i] + (i == 1 ? 1 : 0);
+		runsExact = runsExact && (taskRuns[i] == expected);
+	}
+	printf("  scheduler %lu ms: runs %lu %lu %lu %lu %lu\n", (unsigned long)TASK_RUN_MS,
+		taskRuns[0], taskRuns[1], taskRuns[2], taskRuns[3], taskRuns[4]);
+	_check("every task runs once per period, the once task once", runsExact);
+	_check("a cancelled task never runs, ended handles go stale",
+		   wasScheduled && !scheduler.isScheduled(cancelled) && !scheduler.isScheduled(fired) && !scheduler.cancel(fired));
+	scheduler.clearAllTasks();
+
+	// A 1600 ms block, as onRequestMotorStatus makes: the IMU check skips, the power check catches up
+	taskRuns[0] = 0;
+	taskRuns[1] = 0;
+	scheduler.repeat(tasks[0], taskPeriods[0], TASK_CATCH_UP);
+	scheduler.repeat(tasks[1], taskPeriods[1], TASK_SKIP);
+	for (unsigned long ms = 0; ms < TASK_RUN_MS; ms++) {
+		delay((ms == 3000) ? 1600 : 1);
+		scheduler.loop();
+	}
+	const taskStats * catchUp = scheduler.statsAt(0);
+	const taskStats * skip = scheduler.statsAt(1);
+	unsigned long blockedMs = TASK_RUN_MS + 1599;
+	printf("  1600 ms block: catch up %lu runs %lu skipped, late %lu/%lu/%lu ms; skip %lu runs %lu skipped, late %lu/%lu/%lu ms\n",
+		catchUp->runs, catchUp->skipped, catchUp->lateMin, catchUp->lateTotal / catchUp->runs, catchUp->lateMax,
+		skip->runs, skip->skipped, skip->lateMin, skip->lateTotal / skip->runs, skip->lateMax);
+	_check("periods stay on their deadlines through a block",
+		   catchUp->runs == blockedMs / taskPeriods[0] && catchUp->skipped == 0 &&
+		   skip->runs + skip->skipped == blockedMs / taskPeriods[1] && skip->skipped == 1600 / taskPeriods[1]);
+	scheduler.clearAllTasks();
+
+	// Two probes of known length, 10 us straight and 100 us in a scope
+	profileReset();
+	uint32_t lapStart = cycleCount();
+	hal::advanceMicros(10);
+	profileLap(PROFILE_SYSTEM_RESPONSE, lapStart);
+	{
+		ProfileScope probe(PROFILE_SYSTEM_RESPONSE);
+		hal::advanceMicros(100);
+	}
+	const profileEntry & entry = profileTable[PROFILE_SYSTEM_RESPONSE];
+	uint8_t reply[PROFILE_PAYLOAD_MAX];
+	size_t profileBytes = profileEncode(reply, sizeof(reply));
+	printf("  profile: %lu runs, %lu cycles, max %lu, %u byte reply\n",
+		(unsigned long)entry.count, (unsigned long)entry.total, (unsigned long)entry.max, (unsigned)profileBytes);
+	_check("probes book count, total, max and log2 bucket",
+		   entry.count == 2 && entry.total == 110 * CYCLES_PER_US && entry.max == 100 * CYCLES_PER_US &&
+		   entry.buckets[9] == 1 && entry.buckets[13] == 1);
+	// Total 9240 = 0x98 0x48 and max 8400 = 0xD0 0x41 in LEB128, buckets 9 to 13
+	static const uint8_t expected[] = {PROFILE_VERSION, PROFILE_STAGES, CYCLES_PER_US, 2, 0x98, 0x48, 0xD0, 0x41, 9, 5, 1, 0, 0, 0, 1};
+	_check("profile reply packs the table, empty stages in 5 bytes",
+		   profileBytes == sizeof(expected) + 5 * (PROFILE_STAGES - 1) && memcmp(reply, expected, sizeof(expected)) == 0 &&
+		   profileEncode(reply, sizeof(expected)) == 0);
+
+	// A coroutine interleaves with a 233 ms task instead of blocking it
+	taskRuns[1] = 0;
+	scheduler.repeat(tasks[1], taskPeriods[1]);
+	unsigned long coStart = millis();
+	taskHandle co = scheduler.start(benchCoroutine);
+	for (unsigned long ms = 0; ms < 1000; ms++) {
+		benchCoroutine.flag = (ms >= 300);
+		scheduler.loop();
+		delay(1);
+	}
+	printf("  coroutine: woke %lu ms, flag seen %lu ms, timed out %lu ms, task ran %lu times meanwhile\n",
+		benchCoroutine.woke - coStart, benchCoroutine.flagged - coStart, benchCoroutine.timedOut - coStart, taskRuns[1]);
+	_check("coroutine sleeps, awaits and times out on time",
+		   benchCoroutine.woke - coStart == 100 && benchCoroutine.flagged - coStart == 300 &&
+		   benchCoroutine.timedOut - coStart == 350 && !scheduler.isScheduled(co) && taskRuns[1] == 4);
+	co = scheduler.start(benchCoroutine);
+	taskHandle again = scheduler.start(benchCoroutine);
+	_check("starting a running coroutine restarts it in its slot",
+		   co == again && scheduler.count() == 2 && scheduler.cancel(co) && !scheduler.isScheduled(again));
+	scheduler.clearAllTasks();
+
+	// Handlers run once per pass in their order, only for the events that fired
+	events.source(1UL << 0, _rxWaiting);
+	events.on(1UL << 0, _onRx);
+	events.on(1UL << 1, _onTimer);
+	events.on((1UL << 0) | (1UL << 2), _onBusy);
+	rxWaiting = true;
+	busyPasses = 2;
+	events.post(1UL << 1);
+	unsigned int passes = 0;
+	while (passes < 10 && events.dispatch() != 0) {
+		passes++;
+	}
+	eventTrace[eventTraceLength] = 0;
+	printf("  events: %s in %u passes\n", eventTrace, passes);
+	_check("event handlers run in order, only when posted", strcmp(eventTrace, "rtbbb") == 0 && passes == 3);
+	rxWaiting = true;
+	_check("a source is tested before going idle", !events.idle() && events.dispatch() == (1UL << 0) && !rxWaiting);
+
+	unsigned long partial = chip[0].partialDatagrams + chip[1].partialDatagrams + chip[2].partialDatagrams;
+	_check("no truncated datagrams", partial == 0);
+
+	printf("\n%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,656 @@
+#include "TMC5130Sim.h"
+
+using namespace TMC5130;
+
+// stst is flagged after 2^20 clocks without a step (datasheet DRV_STATUS)
+#define STANDSTILL_US	((unsigned long)(1048576.0 / TMC5130_SIM_FCLK * 1000000.0))
+
+// RAMPMODE values and SPI_STATUS bits (datasheet chp. 4.1.2, 6.3.1)
+enum : uint8_t { MODE_POSITION = 0, MODE_VELPOS = 1, MODE_VELNEG = 2, MODE_HOLD = 3 };
+enum : uint8_t {
+	STATUS_RESET = 0x01, STATUS_DRIVER_ERROR = 0x02, STATUS_SG2 = 0x04, STATUS_STANDSTILL = 0x08,
+	STATUS_VELOCITY_REACHED = 0x10, STATUS_POSITION_REACHED = 0x20, STATUS_STOP_L = 0x40, STATUS_STOP_R = 0x80
+};
+
+// Register units to usteps/s and usteps/s^2 (datasheet chp. 14)
+static const double V_UNIT = TMC5130_SIM_FCLK / 16777216.0;
+static const double A_UNIT = TMC5130_SIM_FCLK * TMC5130_SIM_FCLK / 2199023255552.0;
+
+// SG_RESULT change per SGT count
+#define SG_PER_SGT		32
+
+TMC5130Sim :: TMC5130Sim() {
+
+	stopL = false;
+	stopR = false;
+	refFromPosition = false;
+	refLPosition = 0;
+	refRPosition = 0;
+	sgResult = 300;
+	sgSpeed = 12000.0;
+	sgNoise = 30;
+	sgLoad = 0;
+	hardStops = false;
+	hardStopL = 0;
+	hardStopR = 0;
+	encoderResolution = 0.0;
+	drvFaults = 0;
+	_noise = 1;
+
+	TMC5130Sim :: powerOn();
+}
+
+void TMC5130Sim :: powerOn() {
+
+	for (uint8_t address = 0; address < 0x80; address++) {
+		_regs[address] = 0;
+	}
+
+	_byteIndex = 0;
+	_selected = false;
+	_pendingReply = 0;
+
+	_x = 0.0;
+	_v = 0.0;
+	_rotor = 0.0;
+	_encBase = 0;
+	_encCounts = 0;
+	_events = 0;
+	_reset = true;
+	_atTarget = true;
+	_lastUpdate = micros();
+	_lastStep = _lastUpdate - STANDSTILL_US;
+	_sg = 0;
+	_stallGuard = false;
+	_cs = 0;
+	_sePath = 0.0;
+	_seDown = 0;
+	_switchL = TMC5130Sim :: _switchActive(true);
+	_switchR = TMC5130Sim :: _switchActive(false);
+
+	comparePulses = 0;
+	comparePosition = 0;
+	compareSpeed = 0.0;
+	datagrams = 0;
+	reads = 0;
+	writes = 0;
+	partialDatagrams = 0;
+}
+
+//==============================================================
+//========================= SPI SIDE ===========================
+//==============================================================
+
+/* ======================================================================
+	The reply is fixed when CS goes low: the SPI_STATUS byte as of now and
+	the data latched by the previous datagram.
+====================================================================== */
+
+void TMC5130Sim :: select() {
+
+	TMC5130Sim :: _update();
+
+	_tx[0] = TMC5130Sim :: _spiStatus();
+	_tx[1] = (_pendingReply >> 24) & 0xFF;
+	_tx[2] = (_pendingReply >> 16) & 0xFF;
+	_tx[3] = (_pendingReply >> 8) & 0xFF;
+	_tx[4] = _pendingReply & 0xFF;
+
+	_byteIndex = 0;
+	_selected = true;
+}
+
+uint8_t TMC5130Sim :: transfer(uint8_t out) {
+
+	if (!_selected || _byteIndex >= 5) {
+		return 0;
+	}
+
+	_rx[_byteIndex] = out;
+	return _tx[_byteIndex++];
+}
+
+void TMC5130Sim :: deselect() {
+
+	if (!_selected) {
+		return;
+	}
+	_selected = false;
+
+	if (_byteIndex != 5) {
+		if (_byteIndex > 0) {
+			partialDatagrams++;
+		}
+		return;
+	}
+
+	uint8_t address = _rx[0] & 0x7F;
+	uint32_t value = ((uint32_t)_rx[1] << 24) | ((uint32_t)_rx[2] << 16) | ((uint32_t)_rx[3] << 8) | _rx[4];
+
+	datagrams++;
+	TMC5130Sim :: _update();
+
+	if (_rx[0] & 0x80) {
+		writes++;
+		TMC5130Sim :: _write(address, value);
+		_pendingReply = value;			// a write mirrors its data in the next reply
+	}
+	else {
+		reads++;
+		_pendingReply = TMC5130Sim :: _read(address);
+	}
+}
+
+//==============================================================
+//======================= REGISTER FILE ========================
+//==============================================================
+
+static bool _readable(uint8_t address) {
+
+	switch (address) {
+		case GCONF::address:		return GCONF::readable;
+		case GSTAT::address:		return GSTAT::readable;
+		case IFCNT::address:		return IFCNT::readable;
+		case IOIN::address:			return IOIN::readable;
+		case TSTEP::address:		return TSTEP::readable;
+		case RAMPMODE::address:		return RAMPMODE::readable;
+		case XACTUAL::address:		return XACTUAL::readable;
+		case VACTUAL::address:		return VACTUAL::readable;
+		case XTARGET::address:		return XTARGET::readable;
+		case SW_MODE::address:		return SW_MODE::readable;
+		case RAMP_STAT::address:	return RAMP_STAT::readable;
+		case XLATCH::address:		return XLATCH::readable;
+		case ENCMODE::address:		return ENCMODE::readable;
+		case X_ENC::address:		return X_ENC::readable;
+		case ENC_STATUS::address:	return ENC_STATUS::readable;
+		case ENC_LATCH::address:	return ENC_LATCH::readable;
+		case MSCNT::address:		return MSCNT::readable;
+		case MSCURACT::address:		return MSCURACT::readable;
+		case CHOPCONF::address:		return CHOPCONF::readable;
+		case DRV_STATUS::address:	return DRV_STATUS::readable;
+		case PWM_SCALE::address:	return PWM_SCALE::readable;
+		case LOST_STEPS::address:	return LOST_STEPS::readable;
+		default:					return false;
+	}
+}
+
+uint32_t TMC5130Sim :: _read(uint8_t address) {
+
+	if (!_readable(address)) {
+		return 0;
+	}
+
+	switch (address) {
+
+		case GSTAT::address:
+		{
+			uint32_t value = GSTAT::reset::encode(_reset) |
+							 GSTAT::drv_err::encode((drvFaults & (DRV_STATUS::ot::mask | DRV_STATUS::s2ga::mask | DRV_STATUS::s2gb::mask)) != 0);
+			_reset = false;			// R+C
+			return value;
+		}
+
+		case IFCNT::address:		return _regs[IFCNT::address] & IFCNT::value::max;
+		case IOIN::address:			return IOIN::REFL_STEP::encode(stopL) | IOIN::REFR_DIR::encode(stopR) | IOIN::VERSION::of<0x11>();
+		case XACTUAL::address:		return (uint32_t)TMC5130Sim :: position();
+		case VACTUAL::address:		return VACTUAL::value::encode((uint32_t)(int32_t)lround(_v));
+		case RAMP_STAT::address:	return TMC5130Sim :: _rampStat();
+		case DRV_STATUS::address:	return TMC5130Sim :: _drvStatus();
+		case X_ENC::address:		return TMC5130Sim :: _xEnc();
+
+		case TSTEP::address:
+		{
+			double hz = fabs(_v) * V_UNIT;
+			double clocks = (hz > 0.0) ? (TMC5130_SIM_FCLK / hz) : (double)TSTEP::value::max;
+			return (clocks > TSTEP::value::max) ? TSTEP::value::max : (uint32_t)clocks;
+		}
+
+		default:					return _regs[address];
+	}
+}
+
+void TMC5130Sim :: _write(uint8_t address, uint32_t value) {
+
+	_regs[IFCNT::address]++;
+
+	switch (address) {
+
+		case GSTAT::address:
+			if (GSTAT::reset::get(value)) {
+				_reset = false;
+			}
+			return;
+
+		case RAMP_STAT::address:
+			_events &= ~value;			// R+WC
+			return;
+
+		case XACTUAL::address:
+			_x = (double)(int32_t)value;			// the rotor stays where it is
+			_regs[address] = value;
+			return;
+
+		case X_ENC::address:
+			_encBase = (int32_t)value;
+			_encCounts = TMC5130Sim :: _encoderCounts();
+			_regs[address] = value;
+			return;
+
+		case XTARGET::address:
+			_regs[address] = value;
+			_atTarget = false;
+			return;
+
+		default:
+			_regs[address] = value;
+			return;
+	}
+}
+
+uint32_t TMC5130Sim :: registerValue(uint8_t address) {
+
+	switch (address) {
+		case XACTUAL::address:		return (uint32_t)TMC5130Sim :: position();
+		case VACTUAL::address:		return VACTUAL::value::encode((uint32_t)(int32_t)lround(_v));
+		case RAMP_STAT::address:	return TMC5130Sim :: _rampStat();
+		case DRV_STATUS::address:	return TMC5130Sim :: _drvStatus();
+		case X_ENC::address:		return TMC5130Sim :: _xEnc();
+		default:					return _regs[address & 0x7F];
+	}
+}
+
+int32_t TMC5130Sim :: position() {
+	TMC5130Sim :: _update();
+	return (int32_t)lround(_x);
+}
+
+double TMC5130Sim :: velocity() {
+	TMC5130Sim :: _update();
+	return _v;
+}
+
+double TMC5130Sim :: rotor() {
+	TMC5130Sim :: _update();
+	return _rotor;
+}
+
+void TMC5130Sim :: slip(double usteps) {
+	TMC5130Sim :: _update();
+	_rotor += usteps;
+}
+
+//==============================================================
+//========================== ENCODER ===========================
+//==============================================================
+
+int32_t TMC5130Sim :: _encoderCounts() {
+	return (encoderResolution > 0.0) ? (int32_t)floor(_rotor / encoderResolution) : 0;
+}
+
+/* ======================================================================
+	X_ENC gains ENC_CONST, signed 16.16 binary, for each count since it
+	was last written (ENCMODE binary mode, the only one modelled).
+====================================================================== */
+
+uint32_t TMC5130Sim :: _xEnc() {
+
+	if (encoderResolution <= 0.0) {
+		return _regs[X_ENC::address];
+	}
+
+	double perCount = (int32_t)_regs[ENC_CONST::address] / 65536.0;
+	int32_t counts = TMC5130Sim :: _encoderCounts() - _encCounts;
+	return (uint32_t)(_encBase + (int32_t)floor(counts * perCount));
+}
+
+//==============================================================
+//========================== STATUS ============================
+//==============================================================
+
+bool TMC5130Sim :: _switchActive(bool left) {
+
+	uint32_t swMode = _regs[SW_MODE::address];
+
+	if (SW_MODE::swap_lr::get(swMode)) {
+		left = !left;
+	}
+
+	bool level = left ? stopL : stopR;
+
+	if (refFromPosition) {
+		int32_t x = (int32_t)lround(_x);
+		level = level || (left ? x <= refLPosition : x >= refRPosition);
+	}
+	bool activeLow = left ? SW_MODE::pol_stop_l::get(swMode) : SW_MODE::pol_stop_r::get(swMode);
+
+	return level != activeLow;
+}
+
+uint32_t TMC5130Sim :: _rampStat() {
+
+	uint32_t mode = RAMPMODE::value::get(_regs[RAMPMODE::address]);
+	double vmax = VMAX::value::get(_regs[VMAX::address]);
+	bool stallGuard = DRV_STATUS::stallGuard::get(TMC5130Sim :: _drvStatus());
+
+	bool velocityReached = (mode == MODE_HOLD) ||
+						   (fabs(fabs(_v) - vmax) < 0.5) ||
+						   (mode == MODE_POSITION && _atTarget);
+
+	bool positionReached = (mode == MODE_POSITION) &&
+						   (TMC5130Sim :: position() == (int32_t)_regs[XTARGET::address]);
+
+	return RAMP_STAT::status_stop_l::encode(TMC5130Sim :: _switchActive(true)) |
+		   RAMP_STAT::status_stop_r::encode(TMC5130Sim :: _switchActive(false)) |
+		   _events |
+		   RAMP_STAT::velocity_reached::encode(velocityReached) |
+		   RAMP_STAT::position_reached::encode(positionReached) |
+		   RAMP_STAT::vzero::encode(_v == 0.0) |
+		   RAMP_STAT::status_sg::encode(stallGuard);
+}
+
+uint32_t TMC5130Sim :: _drvStatus() {
+
+	bool stst = (micros() - _lastStep) >= STANDSTILL_US;
+	uint32_t current = stst ? IHOLD_IRUN::IHOLD::get(_regs[IHOLD_IRUN::address]) : _cs;
+	uint32_t sg = stst ? 0 : _sg;
+
+	return DRV_STATUS::SG_RESULT::encode(sg) |
+		   DRV_STATUS::CS_ACTUAL::encode(current) |
+		   DRV_STATUS::stallGuard::encode(_stallGuard) |
+		   DRV_STATUS::stst::encode(stst) |
+		   drvFaults;
+}
+
+/* ======================================================================
+	SG_RESULT for motion at v (usteps/s) with the rotor at x. Below
+	sgSpeed the back EMF, and with it SG_RESULT, falls with the speed
+	while the jitter grows. Against a hard stop the rotor stalls and
+	SG_RESULT is 0. The stallGuard flag only rises in the coolStep band,
+	see _coolBand.
+====================================================================== */
+
+void TMC5130Sim :: _stallGuardStep(double v, double x) {
+
+	double speed = fabs(v);
+	_noise = _noise * 1664525UL + 1013904223UL;
+	double jitter = ((_noise >> 8) / 8388608.0 - 1.0) * sgNoise;
+
+	double level = sgResult;
+	if (speed < sgSpeed) {
+		level = (speed > 0.0) ? sgResult * speed / sgSpeed : 0.0;
+		jitter = (speed > 0.0) ? jitter * sgSpeed / speed : 0.0;
+	}
+
+	int32_t sgt = COOLCONF::sgt::getSigned(_regs[COOLCONF::address]);
+	double sg = level + SG_PER_SGT * sgt - sgLoad + jitter;
+
+	bool blocked = hardStops && ((v > 0.0 && x >= hardStopR) || (v < 0.0 && x <= hardStopL));
+	if (blocked || sg < 0.0) {
+		sg = 0.0;
+	}
+	_sg = (sg > DRV_STATUS::SG_RESULT::max) ? DRV_STATUS::SG_RESULT::max : (uint16_t)sg;
+
+	_stallGuard = (speed > 0.0) && TMC5130Sim :: _coolBand(speed) && _sg == 0;
+}
+
+/* ======================================================================
+	The chopper by speed (usteps/s), as TSTEP against the thresholds:
+	stealthChop at TPWMTHRS and slower with en_pwm_mode, coolStep and
+	StallGuard2 from TCOOLTHRS up to THIGH in spreadCycle.
+====================================================================== */
+
+static double _tstep(double speed) {
+	return (speed > 0.0) ? TMC5130_SIM_FCLK / speed : (double)TSTEP::value::max;
+}
+
+bool TMC5130Sim :: _stealth(double speed) {
+	return GCONF::en_pwm_mode::get(_regs[GCONF::address]) &&
+		   _tstep(speed) >= TPWMTHRS::value::get(_regs[TPWMTHRS::address]);
+}
+
+bool TMC5130Sim :: _coolBand(double speed) {
+	double tstep = _tstep(speed);
+	return !TMC5130Sim :: _stealth(speed) &&
+		   tstep <= TCOOLTHRS::value::get(_regs[TCOOLTHRS::address]) &&
+		   tstep > THIGH::value::get(_regs[THIGH::address]);
+}
+
+bool TMC5130Sim :: stealthChop() {
+	TMC5130Sim :: _update();
+	return TMC5130Sim :: _stealth(fabs(_v * V_UNIT));
+}
+
+/* ======================================================================
+	coolStep, one SG_RESULT reading per full step travelled: below
+	SEMIN * 32 the current goes up 2^SEUP steps, above (SEMIN + SEMAX + 1)
+	* 32 down one step every 32, 8, 2 or 1 readings (SEDN), not below
+	half or a quarter (SEIMIN) of IRUN. Outside the band, or with SEMIN
+	0, it is IRUN.
+====================================================================== */
+
+void TMC5130Sim :: _coolStepStep(double speed, double distance) {
+
+	static const uint8_t downEvery[4] = {32, 8, 2, 1};
+
+	uint32_t coolConf = _regs[COOLCONF::address];
+	uint32_t irun = IHOLD_IRUN::IRUN::get(_regs[IHOLD_IRUN::address]);
+	uint32_t semin = COOLCONF::semin::get(coolConf);
+
+	if (semin == 0 || !TMC5130Sim :: _coolBand(speed)) {
+		_cs = irun;
+		_sePath = 0.0;
+		_seDown = 0;
+		return;
+	}
+
+	uint32_t lowest = (irun + 1) / (COOLCONF::seimin::get(coolConf) ? 4 : 2);
+	lowest = (lowest > 0) ? lowest - 1 : 0;
+	uint32_t upper = (semin + COOLCONF::semax::get(coolConf) + 1) * 32;
+
+	for (_sePath += distance; _sePath >= 256.0; _sePath -= 256.0) {
+		if (_sg < semin * 32) {
+			uint32_t raised = _cs + (1U << COOLCONF::seup::get(coolConf));
+			_cs = (raised > irun) ? irun : raised;
+			_seDown = 0;
+		}
+		else if (_sg > upper && ++_seDown >= downEvery[COOLCONF::sedn::get(coolConf)]) {
+			_seDown = 0;
+			if (_cs > lowest) {
+				_cs--;
+			}
+		}
+	}
+}
+
+uint8_t TMC5130Sim :: _spiStatus() {
+
+	uint32_t rampStat = TMC5130Sim :: _rampStat();
+	uint32_t drvStatus = TMC5130Sim :: _drvStatus();
+	bool driverError = (drvFaults & (DRV_STATUS::ot::mask | DRV_STATUS::s2ga::mask | DRV_STATUS::s2gb::mask)) != 0;
+
+	return (_reset ? STATUS_RESET : 0) |
+		   (driverError ? STATUS_DRIVER_ERROR : 0) |
+		   (DRV_STATUS::stallGuard::get(drvStatus) ? STATUS_SG2 : 0) |
+		   (DRV_STATUS::stst::get(drvStatus) ? STATUS_STANDSTILL : 0) |
+		   (RAMP_STAT::velocity_reached::get(rampStat) ? STATUS_VELOCITY_REACHED : 0) |
+		   (RAMP_STAT::position_reached::get(rampStat) ? STATUS_POSITION_REACHED : 0) |
+		   (RAMP_STAT::status_stop_l::get(rampStat) ? STATUS_STOP_L : 0) |
+		   (RAMP_STAT::status_stop_r::get(rampStat) ? STATUS_STOP_R : 0);
+}
+
+//==============================================================
+//======================= RAMP GENERATOR =======================
+//==============================================================
+
+/* ======================================================================
+	Brings the motion state up to the virtual clock in fixed steps.
+====================================================================== */
+
+void TMC5130Sim :: _update() {
+
+	unsigned long now = micros();
+
+	while (now - _lastUpdate >= TMC5130_SIM_STEP_US) {
+		TMC5130Sim :: _integrate(TMC5130_SIM_STEP_US / 1000000.0);
+		_lastUpdate += TMC5130_SIM_STEP_US;
+		if (_v != 0.0) {
+			_lastStep = _lastUpdate;
+		}
+	}
+}
+
+void TMC5130Sim :: _integrate(double dt) {
+
+	// A stall stop holds the motor until the event is cleared or sg_stop dropped
+	if ((_events & RAMP_STAT::event_stop_sg::mask) && SW_MODE::sg_stop::get(_regs[SW_MODE::address])) {
+		_v = 0.0;
+		TMC5130Sim :: _stallGuardStep(0.0, _x);
+		return;
+	}
+
+	uint32_t mode = RAMPMODE::value::get(_regs[RAMPMODE::address]);
+
+	double vmax = VMAX::value::get(_regs[VMAX::address]) * V_UNIT;
+	double vstart = VSTART::value::get(_regs[VSTART::address]) * V_UNIT;
+	double vstop = VSTOP::value::get(_regs[VSTOP::address]) * V_UNIT;
+	double v1 = V1::value::get(_regs[V1::address]) * V_UNIT;
+	double a1 = A1::value::get(_regs[A1::address]) * A_UNIT;
+	double amax = AMAX::value::get(_regs[AMAX::address]) * A_UNIT;
+	double dmax = DMAX::value::get(_regs[DMAX::address]) * A_UNIT;
+	double d1 = D1::value::get(_regs[D1::address]) * A_UNIT;
+
+	double v = _v * V_UNIT;
+	double x = _x;
+
+	if (mode == MODE_POSITION) {
+
+		double remaining = (double)(int32_t)_regs[XTARGET::address] - x;
+		double dir = (remaining >= 0.0) ? 1.0 : -1.0;
+		double speed = fabs(v);
+		bool low = (v1 > 0.0) && (speed <= v1);
+		double dec = (low && d1 > 0.0) ? d1 : dmax;
+
+		if (fabs(remaining) < 0.5 && speed <= vstop + dec * dt) {
+			x = (double)(int32_t)_regs[XTARGET::address];
+			v = 0.0;
+		}
+		else if (v * dir < 0.0) {
+			// Moving away from the target, brake first
+			speed = (speed > dec * dt) ? speed - dec * dt : 0.0;
+			v = -dir * speed;
+		}
+		else {
+			// DMAX down to V1, then D1 (V1 = 0 disables the D1 phase)
+			bool twoPhase = (v1 > 0.0) && (d1 > 0.0);
+			double knee = (twoPhase && speed > v1) ? v1 : speed;
+			double stopping = 0.0;
+			if (speed > vstop) {
+				stopping = (speed * speed - knee * knee) / (2.0 * dmax) +
+						   (knee * knee - vstop * vstop) / (2.0 * (twoPhase ? d1 : dmax));
+			}
+
+			if (stopping >= fabs(remaining)) {
+				speed -= dec * dt;
+				if (speed < vstop || speed < dec * dt) {
+					speed = (vstop > dec * dt) ? vstop : dec * dt;
+				}
+			}
+			else {
+				double acc = (v1 > 0.0 && speed < v1 && a1 > 0.0) ? a1 : amax;
+				if (speed < vstart) {
+					speed = vstart;
+				}
+				speed = (speed + acc * dt < vmax) ? speed + acc * dt : ((speed > vmax) ? speed - dec * dt : vmax);
+			}
+			v = dir * speed;
+		}
+
+		double step = v * dt;
+		if (fabs(step) >= fabs(remaining) && v * dir > 0.0) {
+			x = (double)(int32_t)_regs[XTARGET::address];
+			v = 0.0;
+		}
+		else {
+			x += step;
+		}
+
+		if (v == 0.0 && !_atTarget && lround(x) == (int32_t)_regs[XTARGET::address]) {
+			_atTarget = true;
+			_events |= RAMP_STAT::event_pos_reached::mask;
+		}
+	}
+	else if (mode != MODE_HOLD) {
+
+		// Velocity modes use AMAX both ways
+		double target = (mode == MODE_VELPOS) ? vmax : -vmax;
+
+		if (v < target) {
+			v = (v + amax * dt < target) ? v + amax * dt : target;
+		}
+		else if (v > target) {
+			v = (v - amax * dt > target) ? v - amax * dt : target;
+		}
+		x += v * dt;
+	}
+	else {
+		x += v * dt;
+	}
+
+	// Hard stop on an enabled, active stop switch in the direction of travel
+	uint32_t swMode = _regs[SW_MODE::address];
+
+	if (v < 0.0 && SW_MODE::stop_l_enable::get(swMode) && TMC5130Sim :: _switchActive(true)) {
+		v = 0.0;
+		_events |= RAMP_STAT::event_stop_l::mask;
+	}
+	if (v > 0.0 && SW_MODE::stop_r_enable::get(swMode) && TMC5130Sim :: _switchActive(false)) {
+		v = 0.0;
+		_events |= RAMP_STAT::event_stop_r::mask;
+	}
+
+	// Hard stop on a stall with sg_stop set, the step that stalled still counts
+	TMC5130Sim :: _stallGuardStep(v, x);
+	TMC5130Sim :: _coolStepStep(fabs(v), fabs(x - _x));
+	if (_stallGuard && SW_MODE::sg_stop::get(swMode)) {
+		v = 0.0;
+		_events |= RAMP_STAT::event_stop_sg::mask;
+	}
+
+	// DIAG1 position compare, a pulse for each microstep onto X_COMPARE
+	int32_t from = (int32_t)lround(_x);
+	int32_t to = (int32_t)lround(x);
+	int32_t compare = (int32_t)_regs[X_COMPARE::address];
+
+	if ((from < compare && compare <= to) || (to <= compare && compare < from)) {
+		comparePulses++;
+		comparePosition = compare;
+		compareSpeed = fabs(v);
+	}
+
+	// The rotor follows the steps, but not into a hard stop
+	_rotor += x - _x;
+	if (hardStops) {
+		_rotor = (_rotor > hardStopR) ? hardStopR : ((_rotor < hardStopL) ? hardStopL : _rotor);
+	}
+
+	_x = x;
+	_v = v / V_UNIT;
+
+	// SW_MODE latch, XACTUAL goes to XLATCH on the enabled switch edges
+	bool switchL = TMC5130Sim :: _switchActive(true);
+	bool switchR = TMC5130Sim :: _switchActive(false);
+
+	if ((switchL && !_switchL && SW_MODE::latch_l_active::get(swMode)) ||
+		(!switchL && _switchL && SW_MODE::latch_l_inactive::get(swMode))) {
+		_regs[XLATCH::address] = (uint32_t)(int32_t)lround(_x);
+		_events |= RAMP_STAT::status_latch_l::mask;
+	}
+	if ((switchR && !_switchR && SW_MODE::latch_r_active::get(swMode)) ||
+		(!switchR && _switchR && SW_MODE::latch_r_inactive::get(swMode))) {
+		_regs[XLATCH::address] = (uint32_t)(int32_t)lround(_x);
+		_events |= RAMP_STAT::status_latch_r::mask;
+	}
+
+	_switchL = switchL;
+	_switchR = switchR;
+}
@@ -0,0 +1,131 @@
+#ifndef TMC5130Sim_H
+
+/* ========================================================================
+   $File: TMC5130Sim.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Behavioural model of one TMC5130 for the native build. It speaks the
+	40 bit SPI protocol with the one-behind read pipeline, keeps the
+	register file with the datasheet access modes (write only registers
+	read 0, GSTAT clears on read, RAMP_STAT events clear on writing 1) and
+	runs the ramp generator, the SW_MODE switch latch and StallGuard2
+	against the virtual clock. SG_RESULT follows the speed, the load, SGT
+	and some noise, which grows as the speed falls; sg_stop stops the
+	ramp at once in the TCOOLTHRS..THIGH band, outside stealthChop.
+	coolStep moves CS_ACTUAL in that band by SEMIN/SEMAX once per full
+	step; the current does not feed back into SG_RESULT. The rotor is kept apart from
+	XACTUAL: it follows the steps except against a hard stop or when a
+	slip is injected, and an optional ABN encoder on it feeds X_ENC
+	through ENC_CONST. XACTUAL stepping onto X_COMPARE counts a DIAG1
+	pulse. Accuracy is what the motor stack can observe:
+	XACTUAL, VACTUAL, X_ENC, RAMP_STAT, DRV_STATUS and the SPI_STATUS
+	byte, not the chopper or the exact six point ramp timing.
+====================================================================== */
+
+#define TMC5130Sim_H
+#include "Arduino.h"
+#include "TMC5130_Registers.h"
+
+#define TMC5130_SIM_FCLK		12000000.0			// internal clock, Hz
+#define TMC5130_SIM_STEP_US		100					// ramp integration step
+
+class TMC5130Sim : public hal::SpiDevice {
+
+	public:
+
+		TMC5130Sim();
+
+		void powerOn();										// registers to reset values, GSTAT.reset set
+
+		// hal::SpiDevice
+		void select();
+		uint8_t transfer(uint8_t out);
+		void deselect();
+
+		// Board inputs
+		bool stopL;											// REFL input level
+		bool stopR;											// REFR input level
+		bool refFromPosition;								// also drive REFL/REFR from the position
+		int32_t refLPosition;								// REFL active at and below
+		int32_t refRPosition;								// REFR active at and above
+		uint16_t sgResult;									// SG_RESULT running free at sgSpeed and up, SGT 0
+		double sgSpeed;										// usteps/s, slower SG_RESULT falls with the speed
+		uint16_t sgNoise;									// SG_RESULT jitter at sgSpeed, grows as the speed falls
+		uint16_t sgLoad;									// load on the motor, in SG_RESULT counts
+		bool hardStops;										// mechanical end of travel, the rotor stalls there
+		int32_t hardStopL;
+		int32_t hardStopR;
+		double encoderResolution;							// usteps per encoder count, 0 = no encoder
+		uint32_t drvFaults;									// DRV_STATUS ot/otpw/s2g/ol bits to report
+
+		// Introspection, never goes over the bus. The model catches up with
+		// the virtual clock on every bus access and every call here.
+		uint32_t registerValue(uint8_t address);			// what the chip holds, even write only
+		int32_t position();
+		double velocity();									// usteps per t, signed
+		double rotor();										// where the rotor really is, usteps
+		void slip(double usteps);							// the rotor jumps, XACTUAL does not follow
+		bool stealthChop();									// the chopper the speed selects now
+
+		unsigned long comparePulses;						// DIAG1 pulses, XACTUAL ran onto X_COMPARE
+		int32_t comparePosition;							// XACTUAL of the last pulse
+		double compareSpeed;								// speed at the last pulse, usteps/s
+
+		unsigned long datagrams;
+		unsigned long reads;
+		unsigned long writes;
+		unsigned long partialDatagrams;						// CS released before 40 bits
+
+	private:
+
+		uint32_t _regs[0x80];
+
+		uint8_t _rx[5];
+		uint8_t _tx[5];
+		uint8_t _byteIndex;
+		bool _selected;
+		uint32_t _pendingReply;								// data for the next datagram's reply
+
+		double _x;											// usteps
+		double _v;											// usteps per t
+		double _rotor;										// usteps, XACTUAL less the steps lost
+		int32_t _encBase;									// X_ENC at the last write
+		int32_t _encCounts;									// encoder counts at the last write
+		uint32_t _events;									// latched RAMP_STAT event bits
+		bool _atTarget;										// position mode move finished
+		bool _reset;
+		bool _switchL;										// switch states at the last step, for latching
+		bool _switchR;
+		unsigned long _lastUpdate;
+		unsigned long _lastStep;							// micros() of the last full step change
+		uint16_t _sg;										// SG_RESULT of the last step
+		bool _stallGuard;									// SG_RESULT 0 above the TCOOLTHRS speed
+		uint32_t _noise;									// jitter generator state
+		uint8_t _cs;										// CS_ACTUAL while running
+		double _sePath;										// usteps towards the next coolStep reading
+		uint8_t _seDown;									// high readings since the last step down
+
+		void _update();
+		void _integrate(double dt);
+		bool _switchActive(bool left);
+		int32_t _encoderCounts();
+		uint32_t _xEnc();
+		void _stallGuardStep(double v, double x);
+		bool _stealth(double speed);
+		bool _coolBand(double speed);
+		void _coolStepStep(double speed, double distance);
+
+		uint32_t _rampStat();
+		uint32_t _drvStatus();
+		uint8_t _spiStatus();
+		uint32_t _read(uint8_t address);
+		void _write(uint8_t address, uint32_t value);
+};
+
+#endif
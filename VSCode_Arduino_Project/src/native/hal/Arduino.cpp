@@ -0,0 +1,202 @@
+#include "Arduino.h"
+
+Stream Serial;
+
+static unsigned long long _nowNs = 0;
+static uint8_t _pinState[NATIVE_PIN_COUNT];
+static int _analog[NATIVE_PIN_COUNT];
+static hal::SpiDevice * _spiDevice[NATIVE_PIN_COUNT];
+static hal::SpiDevice * _selected = nullptr;
+
+//==============================================================
+//============================ TIME ============================
+//==============================================================
+
+unsigned long millis() {
+	return (unsigned long)(_nowNs / 1000000ULL);
+}
+
+unsigned long micros() {
+	return (unsigned long)(_nowNs / 1000ULL);
+}
+
+void delay(unsigned long ms) {
+	_nowNs += (unsigned long long)ms * 1000000ULL;
+}
+
+void delayMicroseconds(unsigned int us) {
+	_nowNs += (unsigned long long)us * 1000ULL;
+}
+
+//==============================================================
+//============================ PINS ============================
+//==============================================================
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	if ((pin < NATIVE_PIN_COUNT) && (mode == INPUT_PULLUP)) {
+		_pinState[pin] = HIGH;
+	}
+}
+
+/* ======================================================================
+	A CS pin going LOW selects the SPI device attached to it, going HIGH
+	again latches the datagram it was sent.
+====================================================================== */
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+
+	if (pin >= NATIVE_PIN_COUNT) {
+		return;
+	}
+
+	uint8_t last = _pinState[pin];
+	_pinState[pin] = val ? HIGH : LOW;
+
+	if (_spiDevice[pin] == nullptr || last == _pinState[pin]) {
+		return;
+	}
+
+	if (_pinState[pin] == LOW) {
+		_selected = _spiDevice[pin];
+		_selected->select();
+	}
+	else {
+		_spiDevice[pin]->deselect();
+		if (_selected == _spiDevice[pin]) {
+			_selected = nullptr;
+		}
+	}
+}
+
+int digitalRead(uint8_t pin) {
+	return (pin < NATIVE_PIN_COUNT) ? _pinState[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+	return (pin < NATIVE_PIN_COUNT) ? _analog[pin] : 0;
+}
+
+//==============================================================
+//=========================== PRINT ============================
+//==============================================================
+
+size_t Print :: _write(const char * s) {
+
+	if (echo) {
+		fputs(s, stdout);
+	}
+	return strlen(s);
+}
+
+size_t Print :: _printNumber(unsigned long n, int base) {
+
+	char buf[8 * sizeof(long) + 1];
+	char * str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+
+	if (base < 2) {
+		base = 10;
+	}
+
+	do {
+		unsigned long digit = n % base;
+		n /= base;
+		*--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+	} while (n);
+
+	return _write(str);
+}
+
+size_t Print :: print(const __FlashStringHelper * s) {
+	return _write(reinterpret_cast<const char *>(s));
+}
+
+size_t Print :: print(const char * s) {
+	return _write(s);
+}
+
+size_t Print :: print(char c) {
+	char buf[2] = {c, '\0'};
+	return _write(buf);
+}
+
+size_t Print :: print(unsigned char n, int base) {
+	return _printNumber(n, base);
+}
+
+size_t Print :: print(int n, int base) {
+	return print((long)n, base);
+}
+
+size_t Print :: print(unsigned int n, int base) {
+	return _printNumber(n, base);
+}
+
+size_t Print :: print(long n, int base) {
+
+	if (base == DEC && n < 0) {
+		return _write("-") + _printNumber(-(unsigned long)n, DEC);
+	}
+	// Like the SAM core, other bases print the two's complement
+	return _printNumber((unsigned long)n, base);
+}
+
+size_t Print :: print(unsigned long n, int base) {
+	return _printNumber(n, base);
+}
+
+size_t Print :: print(double n, int digits) {
+
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return _write(buf);
+}
+
+size_t Print :: println() {
+	return _write("\r\n");
+}
+
+//==============================================================
+//========================= HAL HOOKS ==========================
+//==============================================================
+
+void hal :: attachSpiDevice(uint8_t csPin, SpiDevice * device) {
+
+	if (csPin < NATIVE_PIN_COUNT) {
+		_spiDevice[csPin] = device;
+	}
+}
+
+hal::SpiDevice * hal :: selectedSpiDevice() {
+	return _selected;
+}
+
+void hal :: advanceMicros(unsigned long us) {
+	_nowNs += (unsigned long long)us * 1000ULL;
+}
+
+void hal :: advanceNanos(unsigned long ns) {
+	_nowNs += ns;
+}
+
+uint32_t hal :: cycles() {
+	return (uint32_t)((_nowNs * (F_CPU / 1000000UL)) / 1000ULL);
+}
+
+void hal :: setAnalog(uint8_t pin, int value) {
+
+	if (pin < NATIVE_PIN_COUNT) {
+		_analog[pin] = value;
+	}
+}
+
+void hal :: reset() {
+
+	_nowNs = 0;
+	_selected = nullptr;
+
+	for (uint8_t pin = 0; pin < NATIVE_PIN_COUNT; pin++) {
+		_pinState[pin] = LOW;
+		_analog[pin] = 512;
+	}
+}
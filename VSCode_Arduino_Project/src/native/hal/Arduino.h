@@ -0,0 +1,143 @@
+#ifndef NATIVE_ARDUINO_H
+
+/* ========================================================================
+   $File: Arduino.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	Thin Arduino core for the native (host) build. Only what the motor
+	stack in src/JoystickMotorControl uses is provided. Time is virtual:
+	it only moves on delay(), delayMicroseconds(), SPI traffic (see SPI.h)
+	or hal::advanceMicros(), so runs are repeatable and bus latency can be
+	measured exactly.
+====================================================================== */
+
+#define NATIVE_ARDUINO_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 			0x1
+#define LOW  			0x0
+
+#define INPUT 			0x0
+#define OUTPUT 			0x1
+#define INPUT_PULLUP 	0x2
+
+// The Due's core clock
+#define F_CPU 			84000000UL
+
+#define DEC 			10
+#define HEX 			16
+#define OCT 			8
+#define BIN 			2
+
+// Due pin numbering of the analog inputs
+static const uint8_t A0 = 54;
+static const uint8_t A1 = 55;
+
+#define NATIVE_PIN_COUNT	80
+
+// Same macros as the SAM core (wiring_constants.h)
+#ifndef abs
+#define abs(x) ((x)>0?(x):-(x))
+#endif
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define DEG_TO_RAD 		0.017453292519943295769236907684886
+#define RAD_TO_DEG 		57.295779513082320876798154814105
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+static inline void noInterrupts() {}
+static inline void interrupts() {}
+
+class Print {
+
+	public:
+
+		bool echo = false;								// copy output to stdout
+
+		size_t print(const __FlashStringHelper * s);
+		size_t print(const char * s);
+		size_t print(char c);
+		size_t print(unsigned char n, int base = DEC);
+		size_t print(int n, int base = DEC);
+		size_t print(unsigned int n, int base = DEC);
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC);
+		size_t print(double n, int digits = 2);
+
+		template <class T> size_t println(T value) { size_t n = print(value); return n + println(); }
+		template <class T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+		size_t println();
+
+		void flush() {}
+
+	private:
+
+		size_t _write(const char * s);
+		size_t _printNumber(unsigned long n, int base);
+};
+
+class Stream : public Print {
+
+	public:
+
+		void begin(unsigned long) {}
+		int available() { return 0; }
+		int read() { return -1; }
+};
+
+extern Stream Serial;
+
+/* ======================================================================
+	Host side hooks the simulation and benchmark drive the "board" with.
+====================================================================== */
+
+namespace hal {
+
+// A chip on the SPI bus, selected while its CS pin is LOW
+class SpiDevice {
+	public:
+		virtual ~SpiDevice() {}
+		virtual void select() = 0;
+		virtual uint8_t transfer(uint8_t out) = 0;
+		virtual void deselect() = 0;
+};
+
+void attachSpiDevice(uint8_t csPin, SpiDevice * device);
+SpiDevice * selectedSpiDevice();
+
+void advanceMicros(unsigned long us);					// move the virtual clock
+void advanceNanos(unsigned long ns);
+uint32_t cycles();										// virtual clock in F_CPU cycles, wraps like DWT->CYCCNT
+void setAnalog(uint8_t pin, int value);					// 10 bit reading, 512 is centred
+void reset();											// clock to 0, pins to defaults
+
+}
+
+#endif
@@ -0,0 +1,28 @@
+#include "SPI.h"
+
+SPIClass SPI;
+
+void SPIClass :: beginTransaction(SPISettings settings) {
+	_clock = settings.clock;
+}
+
+void SPIClass :: setClockDivider(uint8_t divider) {
+	_clock = F_CPU / divider;
+}
+
+/* ======================================================================
+	Clocks one byte through the selected device, 0xFF comes back when no
+	device is selected (MISO pulled up).
+====================================================================== */
+
+uint8_t SPIClass :: transfer(uint8_t data) {
+
+	bytes++;
+	hal::advanceNanos((8UL * 1000000000UL) / _clock);
+
+	hal::SpiDevice * device = hal::selectedSpiDevice();
+	if (device == nullptr) {
+		return 0xFF;
+	}
+	return device->transfer(data);
+}
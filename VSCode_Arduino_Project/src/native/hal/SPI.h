@@ -0,0 +1,70 @@
+#ifndef NATIVE_SPI_H
+
+/* ========================================================================
+   $File: SPI.h$
+   $Date: $
+   $Revision: $
+   $Creator:  $
+   $Email:  $
+   $Notice: $
+   ======================================================================== */
+
+/* ======================================================================
+	SPI for the native build. Bytes go to the hal::SpiDevice whose CS pin
+	is LOW, every byte moves the virtual clock by 8 SCK periods of the
+	clock set in beginTransaction().
+====================================================================== */
+
+#define NATIVE_SPI_H
+#include "Arduino.h"
+
+#define LSBFIRST 			0
+#define MSBFIRST 			1
+
+#define SPI_MODE0 			0x02
+#define SPI_MODE1 			0x00
+#define SPI_MODE2 			0x03
+#define SPI_MODE3 			0x01
+
+#define SPI_CLOCK_DIV2 		2
+#define SPI_CLOCK_DIV4 		4
+#define SPI_CLOCK_DIV8 		8
+#define SPI_CLOCK_DIV16 	16
+
+class SPISettings {
+
+	public:
+
+		SPISettings() : clock(4000000), bitOrder(MSBFIRST), dataMode(SPI_MODE0) {}
+		SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) :
+			clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+
+		uint32_t clock;
+		uint8_t bitOrder;
+		uint8_t dataMode;
+};
+
+class SPIClass {
+
+	public:
+
+		void begin() {}
+		void end() {}
+		void beginTransaction(SPISettings settings);
+		void endTransaction() {}
+		uint8_t transfer(uint8_t data);
+
+		void setBitOrder(uint8_t) {}
+		void setDataMode(uint8_t) {}
+		void setClockDivider(uint8_t divider);
+
+		unsigned long bytes = 0;						// bytes clocked since start up
+
+	private:
+
+		uint32_t _clock = 4000000;
+};
+
+extern SPIClass SPI;
+
+#endif